@@ -1,338 +1,1631 @@
 #include "awssigv4.h"
-
-#include <cctype>
+#include "awssigv4_clock.h"
+#include "awssigv4_sha256.h"
+#include "awssigv4_stats.h"
+#include "awssigv4_text.h"
+#include "awssigv4_uri.h"
 
 namespace aws_sigv4 {
 
-    // Helper function for trim string
-    // trim from start
-    static inline std::string &ltrim(std::string &s) {
-        s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](int c) {
-            return !std::isspace(c);
-        }));
-        return s;
+    // trim a view from both ends, without copying
+    static inline std::string_view trimView(std::string_view s)
+    {
+        return TextKernels::best().trim(s);
     }
 
-    // trim from end
-    static inline std::string &rtrim(std::string &s) {
-        s.erase(std::find_if(s.rbegin(), s.rend(), [](int c) {
-            return !std::isspace(c);
-        }).base(), s.end());
-        return s;
+    // Header names are ASCII tokens; std::tolower goes through the locale
+    static inline unsigned char lowerAscii(unsigned char c)
+    {
+        return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
     }
 
-    // trim from both ends
-    static inline std::string &trim(std::string &s) {
-            return ltrim(rtrim(s));
+    // Compare as if both views were lowercased
+    static inline int compareLowercase(std::string_view a, std::string_view b)
+    {
+        size_t length = std::min(a.length(), b.length());
+        for (size_t i = 0; i < length; i++)
+        {
+            int ca = lowerAscii(a[i]);
+            int cb = lowerAscii(b[i]);
+            if (ca != cb)
+                return ca < cb ? -1 : 1;
+        }
+        if (a.length() == b.length())
+            return 0;
+        return a.length() < b.length() ? -1 : 1;
     }
 
-    Signature::Signature(
-        const std::string service,
-        const std::string host,
-        const std::string region,
-        const std::string secret_key,
-        const std::string access_key,
-        const time_t sig_time
-    )
+    static inline void hexEncode(const unsigned char *digest, size_t length, char *out)
     {
-        m_service = service;
-        m_host = host;
-        m_region = region;
-        m_secret_key = secret_key;
-        m_access_key = access_key;
-
-        //
-        // Create a date for headers and the credential string
-        struct tm  *tstruct = gmtime(&sig_time);
-        strftime(m_amzdate, sizeof(m_amzdate), "%Y%m%dT%H%M%SZ", tstruct);
-        strftime(m_datestamp, sizeof(m_datestamp), "%Y%m%d", tstruct);
-    };
+        TextKernels::best().hexEncode(digest, length, out);
+    }
 
-    void Signature::hashSha256(const std::string str, unsigned char outputBuffer[SHA256_DIGEST_LENGTH])
+    static void sha256UpdateLowercase(Sha256 &sha256, std::string_view s)
     {
-        char *c_string = new char [str.length()+1];
+        const TextKernels &text = TextKernels::best();
+        char lower[64];
+        while (!s.empty())
+        {
+            size_t length = std::min(s.length(), sizeof(lower));
+            text.lowercase(s.data(), length, lower);
+            sha256.update(lower, length);
+            s.remove_prefix(length);
+        }
+    }
 
-        std::strcpy(c_string, str.c_str());        
+    // Appends to a caller-owned buffer and remembers if it ran out of room
+    class FixedWriter
+    {
+        private:
+            char *m_out;
+            size_t m_capacity, m_length;
+            bool m_overflow;
 
-        unsigned char hash[SHA256_DIGEST_LENGTH];
-        SHA256_CTX sha256;
-        SHA256_Init(&sha256);
-        SHA256_Update(&sha256, c_string, std::strlen(c_string));
-        SHA256_Final(hash, &sha256);
+        public:
+            FixedWriter(char *out, size_t capacity) : m_out(out), m_capacity(capacity), m_length(0), m_overflow(false) {}
 
-        for (int i=0;i<SHA256_DIGEST_LENGTH;i++) {
-            outputBuffer[i] = hash[i];
-        }
-
-        delete[] c_string;
-    }
+            void append(std::string_view s)
+            {
+                if (s.length() > m_capacity - m_length)
+                {
+                    m_overflow = true;
+                    return;
+                }
+                memcpy(m_out + m_length, s.data(), s.length());
+                m_length += s.length();
+            }
 
-    const std::string Signature::hexlify(const unsigned char* digest) {
+            void appendLowercase(std::string_view s)
+            {
+                size_t start = m_length;
+                append(s);
+                if (!m_overflow)
+                    TextKernels::best().lowercase(m_out + start, m_length - start, m_out + start);
+            }
 
-        char outputBuffer[65];
+            bool overflowed() const { return m_overflow; }
+            size_t length() const { return m_length; }
+    };
 
-        for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-            sprintf(outputBuffer + (i * 2), "%02x", digest[i]);
-        }
-        outputBuffer[64] = 0;
+    struct ViewPair
+    {
+        std::string_view first, second;
+    };
 
-        return std::string(outputBuffer);
+    // Header order: lowercase name, then value, so that duplicates of a name
+    // end up next to each other with their values sorted
+    static bool headerLess(const ViewPair &a, const ViewPair &b)
+    {
+        int c = compareLowercase(a.first, b.first);
+        if (c != 0)
+            return c < 0;
+        return a.second < b.second;
+    }
 
+    static bool queryLess(const ViewPair &a, const ViewPair &b)
+    {
+        if (a.first != b.first)
+            return a.first < b.first;
+        return a.second < b.second;
     }
 
-    // equals to hashlib.sha256(str).hexdigest()
-    const std::string Signature::sha256Base16(const std::string str) {
-        unsigned char hashOut[SHA256_DIGEST_LENGTH];
-        this->hashSha256(str,hashOut);
+    // Canonical request output: hashed as it is produced ...
+    struct HashSink
+    {
+        Sha256 sha256;
 
-        return this->hexlify(hashOut);
-    }
+        void append(std::string_view s) { sha256.update(s); }
+        void appendLowercase(std::string_view s) { sha256UpdateLowercase(sha256, s); }
+    };
 
-    // equals to  hmac.new(key, msg.encode('utf-8'), hashlib.sha256).digest()
-    const std::string Signature::sign(const std::string key, const std::string msg)
+    // ... or collected in a string
+    struct StringSink
     {
-        unsigned char *c_key = new unsigned char[key.length() + 1];
-        memcpy(c_key, (unsigned char *)key.data(), key.length());
+        std::string &out;
 
-        unsigned char *c_msg = new unsigned char[msg.length() + 1];
-        memcpy(c_msg, (unsigned char *)msg.data(), msg.length());
+        void append(std::string_view s) { out.append(s.data(), s.length()); }
+        void appendLowercase(std::string_view s)
+        {
+            size_t start = out.length();
+            out.resize(start + s.length());
+            TextKernels::best().lowercase(s.data(), s.length(), &out[start]);
+        }
+    };
 
-        unsigned char * digest = HMAC(EVP_sha256(), (unsigned char*)c_key, key.length(), c_msg, msg.length(), NULL, NULL); 
+    // ... or fed to an HMAC
+    struct HmacSink
+    {
+        HmacSha256 &hmac;
 
-        delete[] c_key;
-        delete[] c_msg;
+        void append(std::string_view s) { hmac.update(s); }
+    };
 
-        std::string signed_str = std::string((char *)digest, 32);
-        
-        return signed_str;
-    }
+    // ... or thrown away
+    struct DiscardSink
+    {
+        void append(std::string_view) {}
+        void appendLowercase(std::string_view) {}
+    };
 
-    const std::string Signature::getSignatureKey()
+    // ... or hashed and collected, for debug output
+    struct TeeSink
     {
-        std::string kDate = sign("AWS4" + m_secret_key, m_datestamp);
-        std::string kRegion = sign(kDate, m_region);
-        std::string kService = sign(kRegion, m_service);
-        std::string kSigning = sign(kService, "aws4_request");
-        return kSigning;
-    }
+        HashSink &hash;
+        StringSink &text;
+
+        void append(std::string_view s) { hash.append(s); text.append(s); }
+        void appendLowercase(std::string_view s) { hash.appendLowercase(s); text.appendLowercase(s); }
+    };
 
-    std::map<std::string, std::vector<std::string> > Signature::mergeHeaders(
-        std::map<std::string, std::vector<std::string> > canonical_header_map)
+    // Trimmed header views of one request in a single contiguous array,
+    // stored in the object for typical requests and on the heap past
+    // kInlineHeaders. A value with a NULL data pointer stands for a header
+    // listed without any value.
+    class HeaderList
     {
-        std::map<std::string, std::vector<std::string> > merge_header_map;
-        std::map<std::string, std::vector<std::string> >::iterator search_it;
+        private:
+            static const size_t kInlineHeaders = 16;
 
-        for (std::map<std::string, std::vector<std::string> >::iterator it=canonical_header_map.begin(); it != canonical_header_map.end(); it++)
-        {
-            std::string header_key = it->first;
-            std::transform(header_key.begin(), header_key.end(), header_key.begin(), ::tolower);
-            header_key = trim(header_key);
+            ViewPair m_inline[kInlineHeaders];
+            std::vector<ViewPair> m_heap;
+            size_t m_count;
 
-            search_it = merge_header_map.find(header_key);
+            HeaderList(const HeaderList &);
+            HeaderList &operator=(const HeaderList &);
 
-            if (search_it == merge_header_map.end())
+        public:
+            HeaderList() : m_count(0) {}
+
+            void add(std::string_view name, std::string_view value)
             {
-                merge_header_map[header_key];
+                ViewPair header = {trimView(name), value.data() == NULL ? value : trimView(value)};
+                if (m_count < kInlineHeaders)
+                {
+                    m_inline[m_count++] = header;
+                    return;
+                }
+
+                if (m_count == kInlineHeaders)
+                    m_heap.assign(m_inline, m_inline + kInlineHeaders);
+                m_heap.push_back(header);
+                m_count++;
             }
-            for (std::vector<std::string>::iterator lit=it->second.begin(); lit != it->second.end(); lit++)
+
+            // Sort by lowercase name, then value, in place
+            void sort()
             {
-                std::string header_value = *lit;
-                header_value = trim(header_value);
-                merge_header_map[header_key].push_back(header_value);
+                std::sort(data(), data() + m_count, headerLess);
             }
-        }
 
-        for (std::map<std::string, std::vector<std::string> >::iterator it=merge_header_map.begin(); it != merge_header_map.end(); it++)
+            const ViewPair *data() const { return m_count <= kInlineHeaders ? m_inline : m_heap.data(); }
+            ViewPair *data() { return m_count <= kInlineHeaders ? m_inline : m_heap.data(); }
+            size_t size() const { return m_count; }
+    };
+
+    // Header values go into the canonical request with every run of
+    // whitespace, including folded lines, replaced by a single space
+    template <typename Sink>
+    static void appendCollapsed(Sink &sink, std::string_view value)
+    {
+        const TextKernels &text = TextKernels::best();
+        size_t clean = text.findCollapsible(value.data(), value.length());
+        if (clean == value.length())
         {
-            std::sort(it->second.begin(), it->second.end());  
+            sink.append(value);
+            return;
         }
 
-        return merge_header_map;
+        sink.append(value.substr(0, clean));
+        value.remove_prefix(clean);
+
+        char collapsed[256];
+        bool previous_space = false;
+        while (!value.empty())
+        {
+            size_t length = std::min(value.length(), sizeof(collapsed));
+            sink.append(std::string_view(collapsed, text.collapseWhitespace(value.data(), length, collapsed, previous_space)));
+            value.remove_prefix(length);
+        }
     }
 
-    std::string Signature::canonicalHeaderStr(
-        std::map<std::string, std::vector<std::string> > canonical_header_map)
+    // Steps 1.4 and 1.5 in one pass over headers sorted by headerLess:
+    // "name:value,value\n" lines to canonical and "name;name" to
+    // signed_headers, merging names that only differ in case
+    template <typename Sink, typename SignedSink>
+    static void writeHeaders(Sink &canonical, SignedSink &signed_headers, const ViewPair *headers, size_t count)
     {
-        std::string canonical_headers = "";
-        for (std::map<std::string, std::vector<std::string> >::iterator it=canonical_header_map.begin(); it != canonical_header_map.end(); it++)
+        bool has_value = false;
+        for (size_t i = 0; i < count; i++)
         {
-            canonical_headers += it->first + ":";
-            for(std::vector<std::string>::iterator yit=it->second.begin(); yit != it->second.end();)
+            if (i == 0 || compareLowercase(headers[i - 1].first, headers[i].first) != 0)
             {
-                canonical_headers += *yit;
-                
-                if(++yit != it->second.end())
-                    canonical_headers += ",";
+                if (i > 0)
+                {
+                    canonical.append("\n");
+                    signed_headers.append(";");
+                }
+                canonical.appendLowercase(headers[i].first);
+                canonical.append(":");
+                signed_headers.appendLowercase(headers[i].first);
+                has_value = false;
             }
-            canonical_headers += "\n";
-        }
 
-        return canonical_headers;
+            if (headers[i].second.data() == NULL)
+                continue;
+            if (has_value)
+                canonical.append(",");
+            appendCollapsed(canonical, headers[i].second);
+            has_value = true;
+        }
+        if (count > 0)
+            canonical.append("\n");
     }
-    
-    std::string Signature::signedHeaderStr(
-        std::map<std::string, std::vector<std::string> > canonical_header_map)
+
+    // 64-bit FNV-1a, used to spread scopes over cache slots
+    static inline uint64_t fnv1a(std::string_view s, uint64_t hash = 14695981039346656037ULL)
     {
-        std::string signed_header = ""; 
-        for (std::map<std::string, std::vector<std::string> >::iterator it=canonical_header_map.begin(); it != canonical_header_map.end();)
+        for (size_t i = 0; i < s.length(); i++)
         {
-            signed_header += it->first;
-
-            if(++it != canonical_header_map.end())
-                signed_header += ";";
+            hash ^= (unsigned char)s[i];
+            hash *= 1099511628211ULL;
         }
-        return signed_header;
+        return hash;
     }
 
-    std::string Signature::createCanonicalQueryString(std::string query_string)
+    void deriveSigningKey(
+        std::string_view secret_key,
+        std::string_view datestamp,
+        std::string_view region,
+        std::string_view service,
+        SigningKey &signing_key
+    )
     {
-        std::map<std::string, std::vector<std::string> > query_map;
-
-        std::stringstream qss(query_string);
-        std::string query_pair;
-
-        while(std::getline(qss, query_pair, '&'))
-        {
-            std::size_t epos = query_pair.find("=");
-            std::string query_key, query_val;
+        std::string date_key = "AWS4";
+        date_key.append(secret_key.data(), secret_key.length());
+
+        unsigned char k_date[kSha256DigestLength], k_region[kSha256DigestLength], k_service[kSha256DigestLength];
+        HmacSha256::digest(date_key.data(), date_key.length(), datestamp.data(), datestamp.length(), k_date);
+        HmacSha256::digest(k_date, sizeof(k_date), region.data(), region.length(), k_region);
+        HmacSha256::digest(k_region, sizeof(k_region), service.data(), service.length(), k_service);
+        HmacSha256::digest(k_service, sizeof(k_service), "aws4_request", 12, signing_key.key);
+
+        // Every request signed with this key starts from the same ipad and
+        // opad blocks, so hash them once here
+        signing_key.hmac.init(signing_key.key, sizeof(signing_key.key));
+    }
 
-            if (epos != std::string::npos)
-            {
-                query_key = query_pair.substr(0, epos);
-                query_val = query_pair.substr(epos+1);
-            }
+    // Entries tell secrets apart by their SHA-256, so that the cache keeps
+    // no copy of them and a secret chosen to collide with another tenant's
+    // cannot be found
+    struct SigningKeyCache::Entry
+    {
+        unsigned char secret_digest[kSha256DigestLength];
+        uint32_t scope_length;
+        char scope[SigningKeyCache::kMaxScopeLength];
+        SigningKey signing_key;
+    };
 
-            std::map<std::string, std::vector<std::string> >::iterator search_it = query_map.find(query_key);
+    // Request split into canonical URI and trimmed, sorted headers and query
+    // parameters, all views into the caller's request unless its path or
+    // query string needed encoding, in which case they point into uri and
+    // query
+    struct SortedRequest
+    {
+        std::string_view canonical_uri;
+        ViewPair params[Signature::kMaxQueryParameters];
+        size_t param_count;
+        ViewPair headers[Signature::kMaxHeaders];
+        size_t header_count;
+        std::string uri;
+        CanonicalQueryBuilder query_builder;
+        std::string query;
+    };
 
-            if (search_it == query_map.end())
+    // Splits querystring into sorted.params; false if a name or value is not
+    // in canonical encoding or there are too many parameters
+    static bool splitQuery(std::string_view querystring, SortedRequest &sorted, bool &encoded)
+    {
+        encoded = true;
+        sorted.param_count = 0;
+        while (!querystring.empty())
+        {
+            size_t amp = querystring.find('&');
+            std::string_view pair = querystring.substr(0, amp);
+            querystring.remove_prefix(amp == std::string_view::npos ? querystring.length() : amp + 1);
+            if (pair.empty())
+                continue;
+
+            if (sorted.param_count == Signature::kMaxQueryParameters)
+                return false;
+
+            size_t epos = pair.find('=');
+            ViewPair &param = sorted.params[sorted.param_count++];
+            param.first = pair.substr(0, epos);
+            param.second = epos == std::string_view::npos ? std::string_view() : pair.substr(epos + 1);
+            if (!isUriEncoded(param.first) || !isUriEncoded(param.second))
             {
-                query_map[query_key];
+                encoded = false;
+                return false;
             }
+        }
+        return true;
+    }
 
-            query_map[query_key].push_back(query_val);
+    // Step 1.3: split the query string into parameters and sort them. A
+    // query string that is not percent-encoded the canonical way is encoded
+    // into the request's own buffer first. Returns false if it has too many
+    // parameters.
+    static bool sortQuery(std::string_view querystring, SortedRequest &sorted)
+    {
+        bool encoded;
+        if (!splitQuery(querystring, sorted, encoded))
+        {
+            if (encoded)
+                return false;
+
+            sorted.query_builder.clear();
+            sorted.query_builder.parse(querystring);
+            sorted.query.clear();
+            sorted.query_builder.appendTo(sorted.query);
+            if (!splitQuery(sorted.query, sorted, encoded))
+                return false;
         }
+        std::sort(sorted.params, sorted.params + sorted.param_count, queryLess);
+        return true;
+    }
+
+    // Returns false if the request has too many headers or parameters
+    static bool sortRequest(const SignRequest &request, UriNormalization uri_normalization, SortedRequest &sorted)
+    {
+        if (request.header_count > Signature::kMaxHeaders)
+            return false;
 
-        for (std::map<std::string, std::vector<std::string> >::iterator it=query_map.begin(); it != query_map.end(); it++)
+        // Step 1.2: the path as it is if it is already canonical
+        sorted.canonical_uri = request.canonical_uri;
+        if (!isCanonicalUri(request.canonical_uri, uri_normalization))
         {
-            std::sort(it->second.begin(), it->second.end());  
+            sorted.uri.clear();
+            appendCanonicalUri(sorted.uri, request.canonical_uri, uri_normalization);
+            sorted.canonical_uri = sorted.uri;
         }
 
-        std::string canonical_query_string = "";
-        for (std::map<std::string, std::vector<std::string> >::iterator it=query_map.begin(); it != query_map.end();)
+        if (!sortQuery(request.querystring, sorted))
+            return false;
+
+        // Step 1.4: trim the headers and sort them by lowercase name and value
+        sorted.header_count = request.header_count;
+        for (size_t i = 0; i < request.header_count; i++)
         {
-            for(std::vector<std::string>::iterator yit=it->second.begin(); yit != it->second.end();)
-            {
-                canonical_query_string += it->first + "=" + *yit;
-                
-                if(++yit != it->second.end())
-                    canonical_query_string += "&";
-            }
-                
-            if(++it != query_map.end())
-                canonical_query_string += "&";
+            sorted.headers[i].first = trimView(request.headers[i].name);
+            sorted.headers[i].second = trimView(request.headers[i].value);
         }
+        std::sort(sorted.headers, sorted.headers + sorted.header_count, headerLess);
 
-        return canonical_query_string;
+        return true;
+    }
 
+    template <typename Sink>
+    static void writeCanonicalQuery(Sink &sink, const SortedRequest &sorted)
+    {
+        for (size_t i = 0; i < sorted.param_count; i++)
+        {
+            if (i > 0)
+                sink.append("&");
+            sink.append(sorted.params[i].first);
+            sink.append("=");
+            sink.append(sorted.params[i].second);
+        }
     }
 
-    std::string Signature::createCanonicalRequest(
-        const std::string method,
-        const std::string canonical_uri,
-        const std::string querystring, 
-        std::map<std::string, std::vector<std::string> > canonical_header_map,
-        const std::string payload
+    // Step 1 for a request given as a header map, written out piece by
+    // piece; the signed header list is also returned through signed_headers
+    template <typename Sink>
+    static void writeMapCanonicalRequest(
+        Sink &sink,
+        std::string_view method,
+        std::string_view canonical_uri,
+        std::string_view querystring,
+        const std::map<std::string, std::vector<std::string> > &canonical_header_map,
+        std::string_view payload_hash,
+        UriNormalization uri_normalization,
+        std::string &signed_headers
     )
     {
-
         // Step 1: create canonical request
         // http://docs.aws.amazon.com/general/latest/gr/sigv4-create-canonical-request.html
 
         // Step 1.1 define the verb (GET, POST, etc.)
-        // passed in as argument
+        sink.append(method);
+        sink.append("\n");
 
         // Step 1.2: Create canonical URI--the part of the URI from domain to query 
         // string (use '/' if no path)
-        // passed in as argument
+        if (isCanonicalUri(canonical_uri, uri_normalization))
+            sink.append(canonical_uri);
+        else
+        {
+            std::string canonical_path;
+            appendCanonicalUri(canonical_path, canonical_uri, uri_normalization);
+            sink.append(canonical_path);
+        }
+        sink.append("\n");
 
-        // Step 1.3: Create the canonical query string. In this example (a GET request),
-        // request parameters are in the query string. Query string values must
+        // Step 1.3: Create the canonical query string. Query string values must
         // be URL-encoded (space=%20). The parameters must be sorted by name.
-        // For this example, the query string is pre-formatted in the request_parameters variable.
-        // passed in as argument
+        // Sorted as views and streamed to the sink; the map API has no limit
+        // on parameters, so past kMaxQueryParameters it goes through a string
+        SortedRequest sorted;
+        if (sortQuery(querystring, sorted))
+            writeCanonicalQuery(sink, sorted);
+        else
+        {
+            CanonicalQueryBuilder query_builder;
+            query_builder.parse(querystring);
+            std::string canonical_querystring;
+            query_builder.appendTo(canonical_querystring);
+            sink.append(canonical_querystring);
+        }
+        sink.append("\n");
 
         // Step 1.4: Create the canonical headers and signed headers. Header names
         // and value must be trimmed and lowercase, and sorted in ASCII order.
         // Note that there is a trailing \n.
 
-        std::map<std::string, std::vector<std::string> > merged_headers = mergeHeaders(canonical_header_map);
-
-        std::string canonical_headers = canonicalHeaderStr(merged_headers);
-
         // Step 1.5: Create the list of signed headers. This lists the headers
         // in the canonical_headers list, delimited with ";" and in alpha order.
         // Note: The request can include any headers; canonical_headers and
         // signed_headers lists those that you want to be included in the 
         //hash of the request. "Host" and "x-amz-date" are always required.
-        m_signed_headers = signedHeaderStr(merged_headers);
 
+        // Both come out of one pass over a flat, sorted list of views into
+        // the map; values of names that only differ in case are merged
+        HeaderList headers;
+        for (std::map<std::string, std::vector<std::string> >::const_iterator it = canonical_header_map.begin(); it != canonical_header_map.end(); it++)
+        {
+            if (it->second.empty())
+                headers.add(it->first, std::string_view());
+            for (std::vector<std::string>::const_iterator vit = it->second.begin(); vit != it->second.end(); vit++)
+                headers.add(it->first, *vit);
+        }
+        headers.sort();
+
+        signed_headers.clear();
+        StringSink signed_sink = {signed_headers};
+        writeHeaders(sink, signed_sink, headers.data(), headers.size());
+        sink.append("\n");
+        sink.append(signed_headers);
+        sink.append("\n");
+
+        // Step 1.6: the payload hash (hash of the request body content) is
+        // computed by the caller, either from the whole payload or incrementally.
+        sink.append(payload_hash);
+    }
+
+    SigningKeyCache::SigningKeyCache(size_t slot_count)
+    {
+        size_t slots = 1;
+        while (slots < slot_count)
+            slots <<= 1;
+
+        m_slots = new SeqLock<Entry>[slots];
+        m_slot_mask = slots - 1;
+    }
+
+    SigningKeyCache::~SigningKeyCache()
+    {
+        delete[] m_slots;
+    }
+
+    SigningKeyCache &SigningKeyCache::shared()
+    {
+        static SigningKeyCache cache;
+        return cache;
+    }
+
+    bool SigningKeyCache::lookup(
+        std::string_view scope,
+        std::string_view secret_key,
+        SigningKey &signing_key) const
+    {
+        if (scope.length() > kMaxScopeLength)
+            return false;
+
+        Entry entry;
+        if (!m_slots[fnv1a(scope) & m_slot_mask].load(entry))
+            return false;
+
+        if (entry.scope_length != scope.length() ||
+            memcmp(entry.scope, scope.data(), scope.length()) != 0)
+            return false;
+
+        unsigned char secret_digest[kSha256DigestLength];
+        Sha256::digest(secret_key.data(), secret_key.length(), secret_digest);
+        if (memcmp(entry.secret_digest, secret_digest, sizeof(secret_digest)) != 0)
+            return false;
+
+        signing_key = entry.signing_key;
+        return true;
+    }
+
+    void SigningKeyCache::store(
+        std::string_view scope,
+        std::string_view secret_key,
+        const SigningKey &signing_key)
+    {
+        if (scope.length() > kMaxScopeLength)
+            return;
+
+        Entry entry;
+        memset(entry.scope, 0, sizeof(entry.scope));
+        Sha256::digest(secret_key.data(), secret_key.length(), entry.secret_digest);
+        entry.scope_length = scope.length();
+        memcpy(entry.scope, scope.data(), scope.length());
+        entry.signing_key = signing_key;
+
+        m_slots[fnv1a(scope) & m_slot_mask].store(entry);
+    }
+
+    PayloadHasher::PayloadHasher()
+    {
+        reset();
+    }
+
+    void PayloadHasher::reset()
+    {
+        m_sha256.reset();
+        m_finished = false;
+    }
+
+    void PayloadHasher::update(const void *data, size_t length)
+    {
+        if (!m_finished)
+            m_sha256.update(data, length);
+    }
+
+    void PayloadHasher::update(const std::string &data)
+    {
+        update(data.data(), data.length());
+    }
+
+    std::string PayloadHasher::hexDigest()
+    {
+        if (!m_finished)
+        {
+            m_sha256.final(m_digest);
+            m_finished = true;
+        }
+
+        char hex[2 * kSha256DigestLength];
+        hexEncode(m_digest, sizeof(m_digest), hex);
+
+        return std::string(hex, sizeof(hex));
+    }
+
+    const char PayloadHash::kUnsignedPayload[] = "UNSIGNED-PAYLOAD";
+    const char PayloadHash::kEmptyPayloadHash[] = "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+
+    PayloadHash::PayloadHash(Mode mode) : m_mode(mode), m_value_length(0)
+    {
+    }
+
+    PayloadHash PayloadHash::computed(std::string_view payload)
+    {
+        PayloadHash hash(kComputed);
+        hash.m_payload = payload;
+        return hash;
+    }
+
+    PayloadHash PayloadHash::fromHex(std::string_view hex)
+    {
+        PayloadHash hash(kPrecomputed);
+        if (hex.length() != sizeof(hash.m_value))
+            return hash;
+
+        for (size_t i = 0; i < hex.length(); i++)
+        {
+            unsigned char c = lowerAscii(hex[i]);
+            if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+                return PayloadHash(kPrecomputed);
+            hash.m_value[i] = c;
+        }
+        hash.m_value_length = sizeof(hash.m_value);
+        return hash;
+    }
+
+    PayloadHash PayloadHash::fromDigest(const unsigned char digest[kSha256DigestLength])
+    {
+        PayloadHash hash(kPrecomputed);
+        hexEncode(digest, kSha256DigestLength, hash.m_value);
+        hash.m_value_length = sizeof(hash.m_value);
+        return hash;
+    }
+
+    PayloadHash PayloadHash::unsignedPayload()
+    {
+        PayloadHash hash(kUnsigned);
+        hash.m_value_length = sizeof(kUnsignedPayload) - 1;
+        memcpy(hash.m_value, kUnsignedPayload, hash.m_value_length);
+        return hash;
+    }
+
+    PayloadHash PayloadHash::empty()
+    {
+        PayloadHash hash(kEmpty);
+        hash.m_value_length = sizeof(kEmptyPayloadHash) - 1;
+        memcpy(hash.m_value, kEmptyPayloadHash, hash.m_value_length);
+        return hash;
+    }
+
+    PayloadHash::Mode PayloadHash::mode() const
+    {
+        return m_mode;
+    }
+
+    bool PayloadHash::valid() const
+    {
+        return m_mode == kComputed || m_value_length > 0;
+    }
+
+    std::string_view PayloadHash::payload() const
+    {
+        return m_payload;
+    }
+
+    std::string_view PayloadHash::value() const
+    {
+        return std::string_view(m_value, m_value_length);
+    }
+
+    // Step 1.6: the last line of the canonical request, hashing the payload
+    // into hex for a computed hash. Empty for an invalid hash.
+    static std::string_view payloadHashLine(const PayloadHash &payload_hash, char hex[2 * kSha256DigestLength])
+    {
+        if (payload_hash.mode() != PayloadHash::kComputed)
+            return payload_hash.value();
+
+        AWSSIGV4_STAGE_BEGIN(kStagePayloadHash);
+        unsigned char digest[kSha256DigestLength];
+        std::string_view payload = payload_hash.payload();
+        Sha256::digest(payload.data(), payload.length(), digest);
+        hexEncode(digest, sizeof(digest), hex);
+        AWSSIGV4_STAGE_END(kStagePayloadHash, payload.length());
+
+        return std::string_view(hex, 2 * kSha256DigestLength);
+    }
+
+    Signature::Signature(
+        const std::string service,
+        const std::string host,
+        const std::string region,
+        const std::string secret_key,
+        const std::string access_key,
+        const time_t sig_time
+    )
+    {
+        m_service = service;
+        m_host = host;
+        m_region = region;
+        m_secret_key = secret_key;
+        m_access_key = access_key;
+        m_key_cache = &SigningKeyCache::shared();
+        m_uri_normalization = uriNormalizationFor(m_service);
+        m_timestamps = NULL;
+
+        //
+        // Create a date for headers and the credential string
+        formatRequestTime(sig_time, m_time);
+
+        m_scope_suffix = "/" + m_region + "/" + m_service + "/" + "aws4_request";
+        m_credential_prefix = std::string("AWS4-HMAC-SHA256") + " " + "Credential=" + m_access_key + "/";
+
+        m_credential_scope = std::string(m_time.datestamp) + m_scope_suffix;
+        m_string_to_sign_prefix = std::string("AWS4-HMAC-SHA256") + '\n' + m_time.amzdate + '\n' + m_credential_scope + '\n';
+        m_authorization_prefix = m_credential_prefix + m_credential_scope + ", " + "SignedHeaders=";
+    };
+
+    Signature::Signature(
+        const std::string service,
+        const std::string host,
+        const std::string region,
+        const std::string secret_key,
+        const std::string access_key,
+        const TimestampCache &timestamps
+    ) : Signature(service, host, region, secret_key, access_key, timestamps.clock().now())
+    {
+        m_timestamps = &timestamps;
+    }
+
+    void Signature::requestTime(RequestTime &time) const
+    {
+        if (m_timestamps != NULL)
+            m_timestamps->now(time);
+        else
+            time = m_time;
+    }
+
+    void Signature::setKeyCache(SigningKeyCache *key_cache)
+    {
+        m_key_cache = key_cache;
+    }
+
+    void Signature::setUriNormalization(UriNormalization mode)
+    {
+        m_uri_normalization = mode;
+    }
+
+    UriNormalization Signature::uriNormalization() const
+    {
+        return m_uri_normalization;
+    }
+
+    void Signature::hashSha256(std::string_view str, unsigned char outputBuffer[kSha256DigestLength]) const
+    {
+        Sha256::digest(str.data(), str.length(), outputBuffer);
+    }
+
+    const std::string Signature::hexlify(const unsigned char* digest) const {
+
+        char outputBuffer[2 * kSha256DigestLength];
+        hexEncode(digest, kSha256DigestLength, outputBuffer);
+
+        return std::string(outputBuffer, sizeof(outputBuffer));
+
+    }
+
+    // equals to hashlib.sha256(str).hexdigest()
+    const std::string Signature::sha256Base16(std::string_view str) const {
+        unsigned char hashOut[kSha256DigestLength];
+        this->hashSha256(str,hashOut);
+
+        return this->hexlify(hashOut);
+    }
+
+    // equals to  hmac.new(key, msg.encode('utf-8'), hashlib.sha256).digest()
+    void Signature::deriveSignatureKey(const char *datestamp, SigningKey &signing_key) const
+    {
+        deriveSigningKey(m_secret_key, datestamp, m_region, m_service, signing_key);
+    }
+
+    void Signature::signWithKey(const SigningKey &signing_key, std::string_view msg, unsigned char digest[kSha256DigestLength]) const
+    {
+        HmacSha256 hmac = signing_key.hmac;
+        hmac.update(msg);
+        hmac.final(digest);
+    }
+
+    void Signature::loadSigningKey(const RequestTime &time, SigningKey &signing_key) const
+    {
+        // The derived key only depends on the secret and the credential
+        // scope, so look in the per-signer copy first, then the shared cache.
+        // A live signer finds yesterday's key here at UTC midnight and
+        // replaces it.
+        DatedSigningKey dated;
+        if (m_signing_key.load(dated) && strcmp(dated.datestamp, time.datestamp) == 0)
+        {
+            AWSSIGV4_KEY_LOOKUP(true);
+            signing_key = dated.signing_key;
+            return;
+        }
+
+        std::string scope = m_access_key + "/" + time.datestamp + "/" + m_region + "/" + m_service;
+
+        if (m_key_cache == NULL || !m_key_cache->lookup(scope, m_secret_key, dated.signing_key))
+        {
+            AWSSIGV4_KEY_LOOKUP(false);
+            AWSSIGV4_STAGE_BEGIN(kStageKeyDerivation);
+            deriveSignatureKey(time.datestamp, dated.signing_key);
+            AWSSIGV4_STAGE_END(kStageKeyDerivation, 0);
+            if (m_key_cache != NULL)
+                m_key_cache->store(scope, m_secret_key, dated.signing_key);
+        }
+        else
+        {
+            AWSSIGV4_KEY_LOOKUP(true);
+        }
+
+        memcpy(dated.datestamp, time.datestamp, sizeof(dated.datestamp));
+        m_signing_key.store(dated);
+
+        signing_key = dated.signing_key;
+    }
+
+    std::string Signature::createCanonicalQueryString(const std::string &query_string) const
+    {
+        CanonicalQueryBuilder builder;
+        builder.parse(query_string);
+        return builder.str();
+    }
+
+    std::string Signature::createCanonicalRequest(
+        const std::string &method,
+        const std::string &canonical_uri,
+        const std::string &querystring,
+        const std::map<std::string, std::vector<std::string> > &canonical_header_map,
+        const std::string &payload
+    )
+    {
         // Step 1.6: Create payload hash (hash of the request body content). For GET
         // requests, the payload is an empty string ("").
-        std::string payload_hash = sha256Base16(payload);
+        return createCanonicalRequest(method, canonical_uri, querystring, canonical_header_map, PayloadHash::computed(payload));
+    }
 
-        // Step 1.7: Combine elements to create create canonical request
+    std::string Signature::createCanonicalRequest(
+        const std::string &method,
+        const std::string &canonical_uri,
+        const std::string &querystring,
+        const std::map<std::string, std::vector<std::string> > &canonical_header_map,
+        const PayloadHash &payload_hash
+    )
+    {
+        char hex[2 * kSha256DigestLength];
+        std::string_view payload_line = payloadHashLine(payload_hash, hex);
+        if (payload_line.empty())
+            return std::string();
 
-        // generate canonical query string
-        std::string canonical_querystring = createCanonicalQueryString(querystring);
+        return buildCanonicalRequest(method, canonical_uri, querystring, canonical_header_map, payload_line, m_signed_headers);
+    }
+
+    std::string Signature::createCanonicalRequest(
+        const std::string &method,
+        const std::string &canonical_uri,
+        const std::string &querystring,
+        const std::map<std::string, std::vector<std::string> > &canonical_header_map,
+        PayloadHasher &payload_hasher
+    )
+    {
+        return buildCanonicalRequest(method, canonical_uri, querystring, canonical_header_map, payload_hasher.hexDigest(), m_signed_headers);
+    }
+
+    std::string Signature::buildCanonicalRequest(
+        const std::string &method,
+        const std::string &canonical_uri,
+        const std::string &querystring,
+        const std::map<std::string, std::vector<std::string> > &canonical_header_map,
+        std::string_view payload_hash,
+        std::string &signed_headers
+    ) const
+    {
+        AWSSIGV4_STAGE_BEGIN(kStageCanonicalize);
+        std::string canonical_request;
+        StringSink sink = {canonical_request};
+        writeMapCanonicalRequest(sink, method, canonical_uri, querystring, canonical_header_map, payload_hash, m_uri_normalization, signed_headers);
+        AWSSIGV4_STAGE_END(kStageCanonicalize, 0);
 
-        std::string canonical_request = method + "\n" + canonical_uri + "\n" + canonical_querystring + "\n" + canonical_headers + "\n" + m_signed_headers + "\n" + payload_hash;
-    
         return canonical_request;
     }
 
-    
-    std::string Signature::createStringToSign(std::string canonical_request)
+    std::string Signature::createStringToSign(const std::string &canonical_request) const
     {
         // Step 2: CREATE THE STRING TO SIGN
         // http://docs.aws.amazon.com/general/latest/gr/sigv4-create-string-to-sign.html
         // Match the algorithm to the hashing algorithm you use, either SHA-1 or
         // SHA-256 (recommended)
 
-        std::string algorithm = "AWS4-HMAC-SHA256";
-        std::string credential_scope = std::string(m_datestamp) + "/" + m_region + "/" + m_service + "/" + "aws4_request";
-        std::string string_to_sign = algorithm + '\n' +  m_amzdate + '\n' +  credential_scope + '\n' +  sha256Base16(canonical_request);
+        // The algorithm, date and credential scope lines are prepared by
+        // the constructor
+        AWSSIGV4_STAGE_BEGIN(kStageCanonicalRequestHash);
+        std::string string_to_sign = m_string_to_sign_prefix + sha256Base16(canonical_request);
+        AWSSIGV4_STAGE_END(kStageCanonicalRequestHash, canonical_request.length());
 
         return string_to_sign;
     }
     
-    std::string Signature::createSignature(std::string string_to_sign)
+    std::string Signature::createSignature(const std::string &string_to_sign) const
     {
         // step 3: CALCULATE THE SIGNATURE
         // http://docs.aws.amazon.com/general/latest/gr/sigv4-calculate-signature.html
         // Create the signing key using the function defined above.
-        std::string signing_key = this->getSignatureKey();
+        SigningKey signing_key;
+        loadSigningKey(m_time, signing_key);
 
         // Sign the string_to_sign using the signing_key
-        std::string signature_str = sign(signing_key, string_to_sign);
-
-        unsigned char *signature_data = new unsigned char[signature_str.length() + 1];
-        memcpy(signature_data, (unsigned char *)signature_str.data(), signature_str.length());
+        unsigned char signature_data[kSha256DigestLength];
+        AWSSIGV4_STAGE_BEGIN(kStageSignature);
+        signWithKey(signing_key, string_to_sign, signature_data);
+        AWSSIGV4_STAGE_END(kStageSignature, 0);
 
-        std::string signature = hexlify(signature_data);
-
-        delete[] signature_data;
-        
-        return signature;
+        return hexlify(signature_data);
     }
     
     
-    std::string Signature::createAuthorizationHeader(std::string signature)
+    std::string Signature::createAuthorizationHeader(const std::string &signature)
+    {
+        return createAuthorizationHeader(m_signed_headers, signature);
+    }
+
+    std::string Signature::createAuthorizationHeader(const std::string &signed_headers, const std::string &signature) const
+    {
+        return m_authorization_prefix + signed_headers + ", " + "Signature=" + signature;
+    }
+
+    size_t Signature::signRequest(
+        std::string_view method,
+        std::string_view canonical_uri,
+        std::string_view querystring,
+        const HeaderField *headers,
+        size_t header_count,
+        std::string_view payload,
+        char *out,
+        size_t out_length,
+        std::string *canonical_request
+    ) const
+    {
+        RequestTime time;
+        requestTime(time);
+
+        return signRequest(time, method, canonical_uri, querystring, headers, header_count, PayloadHash::computed(payload), out, out_length, canonical_request);
+    }
+
+    size_t Signature::signRequest(
+        const RequestTime &time,
+        std::string_view method,
+        std::string_view canonical_uri,
+        std::string_view querystring,
+        const HeaderField *headers,
+        size_t header_count,
+        std::string_view payload,
+        char *out,
+        size_t out_length,
+        std::string *canonical_request
+    ) const
+    {
+        return signRequest(time, method, canonical_uri, querystring, headers, header_count, PayloadHash::computed(payload), out, out_length, canonical_request);
+    }
+
+    size_t Signature::signRequest(
+        std::string_view method,
+        std::string_view canonical_uri,
+        std::string_view querystring,
+        const HeaderField *headers,
+        size_t header_count,
+        const PayloadHash &payload_hash,
+        char *out,
+        size_t out_length,
+        std::string *canonical_request
+    ) const
+    {
+        RequestTime time;
+        requestTime(time);
+
+        return signRequest(time, method, canonical_uri, querystring, headers, header_count, payload_hash, out, out_length, canonical_request);
+    }
+
+    size_t Signature::signRequest(
+        const RequestTime &time,
+        std::string_view method,
+        std::string_view canonical_uri,
+        std::string_view querystring,
+        const HeaderField *headers,
+        size_t header_count,
+        const PayloadHash &payload_hash,
+        char *out,
+        size_t out_length,
+        std::string *canonical_request
+    ) const
+    {
+        if (!payload_hash.valid())
+            return 0;
+
+        AWSSIGV4_STAGE_BEGIN(kStageSignRequest);
+        SignRequest request = {method, canonical_uri, querystring, headers, header_count, payload_hash.payload()};
+
+        SigningKey signing_key;
+        loadSigningKey(time, signing_key);
+
+        char hex[2 * kSha256DigestLength];
+        std::string_view payload_line = payloadHashLine(payload_hash, hex);
+        size_t length = signWithPayloadHash(signing_key, time, request, payload_line, out, out_length, canonical_request);
+        AWSSIGV4_STAGE_END(kStageSignRequest, request.payload.length());
+        return length;
+    }
+
+    // Step 2 up to the canonical request hash:
+    // "AWS4-HMAC-SHA256\n<amzdate>\n<datestamp>/<region>/<service>/aws4_request\n"
+    template <typename Sink>
+    static void writeStringToSignPrefix(Sink &sink, const RequestTime &time, std::string_view scope_suffix)
+    {
+        sink.append("AWS4-HMAC-SHA256\n");
+        sink.append(time.amzdate);
+        sink.append("\n");
+        sink.append(time.datestamp);
+        sink.append(scope_suffix);
+        sink.append("\n");
+    }
+
+    // Step 4 up to the signed headers:
+    // "AWS4-HMAC-SHA256 Credential=<access key>/<datestamp>/<region>/<service>/aws4_request, SignedHeaders="
+    template <typename Sink>
+    static void writeAuthorizationPrefix(Sink &sink, std::string_view credential_prefix, const RequestTime &time, std::string_view scope_suffix)
+    {
+        sink.append(credential_prefix);
+        sink.append(time.datestamp);
+        sink.append(scope_suffix);
+        sink.append(", SignedHeaders=");
+    }
+
+    template <typename Sink>
+    static void writeSignedHeaders(Sink &sink, std::string_view signed_headers)
+    {
+        sink.append(signed_headers);
+    }
+
+    template <typename Sink>
+    static void writeSignedHeaders(Sink &sink, const SortedRequest &sorted)
     {
-            
-        std::string algorithm = "AWS4-HMAC-SHA256";
-        std::string credential_scope = std::string(m_datestamp) + "/" + m_region + "/" + m_service + "/" + "aws4_request";
+        for (size_t i = 0; i < sorted.header_count; i++)
+        {
+            if (i == 0 || compareLowercase(sorted.headers[i - 1].first, sorted.headers[i].first) != 0)
+            {
+                if (i > 0)
+                    sink.append(";");
+                sink.appendLowercase(sorted.headers[i].first);
+            }
+        }
+    }
+
+    template <typename Sink>
+    static void writeCanonicalRequest(Sink &sink, const SignRequest &request, const SortedRequest &sorted, std::string_view payload_hash)
+    {
+        sink.append(request.method);
+        sink.append("\n");
+        sink.append(sorted.canonical_uri);
+        sink.append("\n");
+        writeCanonicalQuery(sink, sorted);
+        sink.append("\n");
+        DiscardSink discard;
+        writeHeaders(sink, discard, sorted.headers, sorted.header_count);
+        sink.append("\n");
+        writeSignedHeaders(sink, sorted);
+        sink.append("\n");
+        sink.append(payload_hash);
+    }
+
+    template <typename Writer, typename SignedHeaders>
+    void Signature::writeSignedAuthorization(
+        const SigningKey &signing_key,
+        const RequestTime &time,
+        const unsigned char request_digest[kSha256DigestLength],
+        const SignedHeaders &signed_headers,
+        Writer &header
+    ) const
+    {
+        char hex[2 * kSha256DigestLength];
+        hexEncode(request_digest, kSha256DigestLength, hex);
+
+        // Steps 2 and 3: feed the string to sign straight into the HMAC
+        AWSSIGV4_STAGE_BEGIN(kStageSignature);
+        unsigned char digest[kSha256DigestLength];
+        HmacSha256 hmac = signing_key.hmac;
+        HmacSink string_to_sign = {hmac};
+        writeStringToSignPrefix(string_to_sign, time, m_scope_suffix);
+        hmac.update(std::string_view(hex, sizeof(hex)));
+        hmac.final(digest);
+        AWSSIGV4_STAGE_END(kStageSignature, 0);
+
+        // Step 4: Authorization header
+        hexEncode(digest, sizeof(digest), hex);
+        writeAuthorizationPrefix(header, m_credential_prefix, time, m_scope_suffix);
+        writeSignedHeaders(header, signed_headers);
+        header.append(", Signature=");
+        header.append(std::string_view(hex, sizeof(hex)));
+    }
+
+    std::string Signature::signRequest(
+        const std::string &method,
+        const std::string &canonical_uri,
+        const std::string &querystring,
+        const std::map<std::string, std::vector<std::string> > &canonical_header_map,
+        std::string_view payload,
+        std::string *canonical_request
+    ) const
+    {
+        return signRequest(method, canonical_uri, querystring, canonical_header_map, PayloadHash::computed(payload), canonical_request);
+    }
 
-        return algorithm + " " + "Credential=" + m_access_key + "/" + credential_scope + ", " +  "SignedHeaders=" + m_signed_headers + ", " + "Signature=" + signature;
+    std::string Signature::signRequest(
+        const std::string &method,
+        const std::string &canonical_uri,
+        const std::string &querystring,
+        const std::map<std::string, std::vector<std::string> > &canonical_header_map,
+        const PayloadHash &payload_hash,
+        std::string *canonical_request
+    ) const
+    {
+        if (!payload_hash.valid())
+            return std::string();
+
+        AWSSIGV4_STAGE_BEGIN(kStageSignRequest);
+        RequestTime time;
+        requestTime(time);
+
+        char hex[2 * kSha256DigestLength];
+        std::string_view payload_line = payloadHashLine(payload_hash, hex);
+
+        // Step 1.7: hash the canonical request as it is produced
+        AWSSIGV4_STAGE_BEGIN(kStageCanonicalRequestHash);
+        std::string signed_headers;
+        HashSink sink;
+        if (canonical_request != NULL)
+        {
+            canonical_request->clear();
+            StringSink text = {*canonical_request};
+            TeeSink tee = {sink, text};
+            writeMapCanonicalRequest(tee, method, canonical_uri, querystring, canonical_header_map, payload_line, m_uri_normalization, signed_headers);
+        }
+        else
+            writeMapCanonicalRequest(sink, method, canonical_uri, querystring, canonical_header_map, payload_line, m_uri_normalization, signed_headers);
+        AWSSIGV4_STAGE_END(kStageCanonicalRequestHash, sink.sha256.length());
+        unsigned char digest[kSha256DigestLength];
+        sink.sha256.final(digest);
+
+        // Steps 2 to 4 as createStringToSign, createSignature and
+        // createAuthorizationHeader, at the request time
+        SigningKey signing_key;
+        loadSigningKey(time, signing_key);
+
+        std::string authorization;
+        StringSink header = {authorization};
+        writeSignedAuthorization(signing_key, time, digest, std::string_view(signed_headers), header);
+
+        AWSSIGV4_STAGE_END(kStageSignRequest, payload_hash.payload().length());
+        return authorization;
+    }
+
+    static inline uint64_t payloadBytes(const SignRequest *requests, size_t count)
+    {
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < count; i++)
+            bytes += requests[i].payload.length();
+        return bytes;
+    }
+
+    size_t Signature::signBatch(
+        const SignRequest *requests,
+        size_t count,
+        std::string *authorization_headers
+    ) const
+    {
+        RequestTime time;
+        requestTime(time);
+
+        return signBatch(time, requests, count, authorization_headers);
+    }
+
+    size_t Signature::signBatch(
+        const RequestTime &time,
+        const SignRequest *requests,
+        size_t count,
+        std::string *authorization_headers
+    ) const
+    {
+        static const MultiBufferSha256 hasher;
+
+        return signBatch(time, requests, count, authorization_headers, hasher);
+    }
+
+    size_t Signature::signBatch(
+        const RequestTime &time,
+        const SignRequest *requests,
+        size_t count,
+        std::string *authorization_headers,
+        const MultiBufferSha256 &hasher
+    ) const
+    {
+        // Everything but the request itself is shared by the batch: the
+        // timestamp is taken and the key is looked up once
+        AWSSIGV4_STAGE_BEGIN(kStageSignBatch);
+        SigningKey signing_key;
+        loadSigningKey(time, signing_key);
+
+        size_t signed_count = 0;
+
+        if (hasher.lanes() == 1)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                if (signOne(signing_key, time, requests[i], authorization_headers[i]))
+                    signed_count++;
+            }
+            AWSSIGV4_STAGE_END(kStageSignBatch, payloadBytes(requests, count));
+            return signed_count;
+        }
+
+        // With SIMD lanes available, run each hashing step of the requests
+        // side by side: payloads, canonical requests, then both HMAC passes
+        const size_t kWindow = 64;
+        Sha256Midstate inner = signing_key.hmac.inner().midstate();
+        Sha256Midstate outer = signing_key.hmac.outer().midstate();
+
+        std::string_view messages[kWindow];
+        unsigned char digests[kWindow][kSha256DigestLength];
+        std::vector<std::string> canonical_requests(std::min(count, kWindow));
+        std::vector<std::string> signed_headers(std::min(count, kWindow));
+        bool sorted_ok[kWindow];
+        SortedRequest sorted;
+        char hex[2 * kSha256DigestLength];
+
+        for (size_t start = 0; start < count; start += kWindow)
+        {
+            size_t window = std::min(count - start, kWindow);
+            const SignRequest *batch = requests + start;
+
+            // Step 1.6: payload hashes
+            for (size_t i = 0; i < window; i++)
+                messages[i] = batch[i].payload;
+            hasher.hash(messages, window, digests);
+
+            // Steps 1.1 to 1.7: canonical requests
+            for (size_t i = 0; i < window; i++)
+            {
+                canonical_requests[i].clear();
+                signed_headers[i].clear();
+                sorted_ok[i] = sortRequest(batch[i], m_uri_normalization, sorted);
+                if (!sorted_ok[i])
+                    continue;
+
+                hexEncode(digests[i], kSha256DigestLength, hex);
+                StringSink request_sink = {canonical_requests[i]};
+                writeCanonicalRequest(request_sink, batch[i], sorted, std::string_view(hex, sizeof(hex)));
+                StringSink headers_sink = {signed_headers[i]};
+                writeSignedHeaders(headers_sink, sorted);
+            }
+            for (size_t i = 0; i < window; i++)
+                messages[i] = canonical_requests[i];
+            hasher.hash(messages, window, digests);
+
+            // Step 2: the strings to sign replace the canonical requests
+            for (size_t i = 0; i < window; i++)
+            {
+                hexEncode(digests[i], kSha256DigestLength, hex);
+                canonical_requests[i].clear();
+                StringSink string_to_sign = {canonical_requests[i]};
+                writeStringToSignPrefix(string_to_sign, time, m_scope_suffix);
+                string_to_sign.append(std::string_view(hex, sizeof(hex)));
+                messages[i] = canonical_requests[i];
+            }
+
+            // Step 3: HMAC from the key's inner and outer midstates
+            hasher.hash(inner, messages, window, digests);
+            for (size_t i = 0; i < window; i++)
+                messages[i] = std::string_view((const char *)digests[i], kSha256DigestLength);
+            unsigned char signatures[kWindow][kSha256DigestLength];
+            hasher.hash(outer, messages, window, signatures);
+
+            // Step 4: Authorization headers
+            for (size_t i = 0; i < window; i++)
+            {
+                std::string &header = authorization_headers[start + i];
+                if (!sorted_ok[i])
+                {
+                    header.clear();
+                    continue;
+                }
+
+                hexEncode(signatures[i], kSha256DigestLength, hex);
+                header.clear();
+                StringSink header_sink = {header};
+                writeAuthorizationPrefix(header_sink, m_credential_prefix, time, m_scope_suffix);
+                header.append(signed_headers[i]);
+                header.append(", Signature=");
+                header.append(hex, sizeof(hex));
+                signed_count++;
+            }
+        }
+
+        AWSSIGV4_STAGE_END(kStageSignBatch, payloadBytes(requests, count));
+        return signed_count;
+    }
+
+    bool hashCanonicalRequest(
+        const SignRequest &request,
+        std::string_view payload_hash,
+        UriNormalization uri_normalization,
+        unsigned char digest[kSha256DigestLength],
+        std::string *signed_headers)
+    {
+        SortedRequest sorted;
+        if (!sortRequest(request, uri_normalization, sorted))
+            return false;
+
+        HashSink sink;
+        writeCanonicalRequest(sink, request, sorted, payload_hash);
+        sink.sha256.final(digest);
+
+        if (signed_headers != NULL)
+        {
+            StringSink headers_sink = {*signed_headers};
+            writeSignedHeaders(headers_sink, sorted);
+        }
+        return true;
+    }
+
+    size_t Signature::signOne(
+        const SigningKey &signing_key,
+        const RequestTime &time,
+        const SignRequest &request,
+        char *out,
+        size_t out_length,
+        std::string *canonical_request
+    ) const
+    {
+        char hex[2 * kSha256DigestLength];
+        std::string_view payload_line = payloadHashLine(PayloadHash::computed(request.payload), hex);
+
+        return signWithPayloadHash(signing_key, time, request, payload_line, out, out_length, canonical_request);
+    }
+
+    template <typename Writer>
+    bool Signature::writeAuthorization(
+        const SigningKey &signing_key,
+        const RequestTime &time,
+        const SignRequest &request,
+        std::string_view payload_hash,
+        Writer &header,
+        std::string *canonical_request
+    ) const
+    {
+        AWSSIGV4_STAGE_BEGIN(kStageCanonicalize);
+        SortedRequest sorted;
+        bool sorted_ok = sortRequest(request, m_uri_normalization, sorted);
+        AWSSIGV4_STAGE_END(kStageCanonicalize, 0);
+        if (!sorted_ok)
+            return false;
+
+        // Step 1.7: hash the canonical request as it is produced
+        unsigned char digest[kSha256DigestLength];
+        AWSSIGV4_STAGE_BEGIN(kStageCanonicalRequestHash);
+        HashSink sink;
+        if (canonical_request != NULL)
+        {
+            canonical_request->clear();
+            StringSink text = {*canonical_request};
+            TeeSink tee = {sink, text};
+            writeCanonicalRequest(tee, request, sorted, payload_hash);
+        }
+        else
+            writeCanonicalRequest(sink, request, sorted, payload_hash);
+        AWSSIGV4_STAGE_END(kStageCanonicalRequestHash, sink.sha256.length());
+        sink.sha256.final(digest);
+
+        writeSignedAuthorization(signing_key, time, digest, sorted, header);
+        return true;
+    }
+
+    size_t Signature::signWithPayloadHash(
+        const SigningKey &signing_key,
+        const RequestTime &time,
+        const SignRequest &request,
+        std::string_view payload_hash,
+        char *out,
+        size_t out_length,
+        std::string *canonical_request
+    ) const
+    {
+        FixedWriter writer(out, out_length);
+        if (!writeAuthorization(signing_key, time, request, payload_hash, writer, canonical_request))
+            return 0;
+        return writer.overflowed() ? 0 : writer.length();
+    }
+
+    bool Signature::signOne(
+        const SigningKey &signing_key,
+        const RequestTime &time,
+        const SignRequest &request,
+        std::string &authorization
+    ) const
+    {
+        char hex[2 * kSha256DigestLength];
+        std::string_view payload_line = payloadHashLine(PayloadHash::computed(request.payload), hex);
+
+        return signWithPayloadHash(signing_key, time, request, payload_line, authorization);
+    }
+
+    bool Signature::signWithPayloadHash(
+        const SigningKey &signing_key,
+        const RequestTime &time,
+        const SignRequest &request,
+        std::string_view payload_hash,
+        std::string &authorization
+    ) const
+    {
+        authorization.clear();
+        StringSink header = {authorization};
+        if (writeAuthorization(signing_key, time, request, payload_hash, header, NULL))
+            return true;
+        authorization.clear();
+        return false;
+    }
+
+    // A header of a prepared request, with the index of its value among the
+    // variable ones, or kFixedHeader
+    struct PreparedHeader
+    {
+        ViewPair header;
+        size_t value_index;
+    };
+
+    static const size_t kFixedHeader = (size_t)-1;
+
+    static bool preparedHeaderLess(const PreparedHeader &a, const PreparedHeader &b)
+    {
+        return headerLess(a.header, b.header);
+    }
+
+    PreparedRequest::PreparedRequest(
+        const Signature &signature,
+        std::string_view method,
+        std::string_view canonical_uri,
+        const HeaderField *fixed_headers,
+        size_t fixed_count,
+        const std::string_view *variable_names,
+        size_t variable_count
+    ) :
+        m_signature(signature),
+        m_valid(true),
+        m_variable_count(variable_count),
+        m_method(method)
+    {
+        appendCanonicalUri(m_canonical_uri, canonical_uri, signature.m_uri_normalization);
+
+        // Every header in signing order, the variable ones as placeholders
+        std::vector<PreparedHeader> headers;
+        for (size_t i = 0; i < fixed_count; i++)
+        {
+            PreparedHeader header = {{trimView(fixed_headers[i].name), trimView(fixed_headers[i].value)}, kFixedHeader};
+            headers.push_back(header);
+        }
+        for (size_t i = 0; i < variable_count; i++)
+        {
+            PreparedHeader header = {{trimView(variable_names[i]), std::string_view()}, i};
+            headers.push_back(header);
+        }
+        std::stable_sort(headers.begin(), headers.end(), preparedHeaderLess);
+
+        // Runs of fixed headers become text as signRequest would write them;
+        // a variable header must be alone under its name
+        std::string fixed_lines;
+        StringSink fixed_sink = {fixed_lines};
+        StringSink signed_sink = {m_signed_headers};
+        DiscardSink discard;
+        for (size_t start = 0, end; start < headers.size(); start = end)
+        {
+            bool variable = false;
+            for (end = start; end < headers.size() && compareLowercase(headers[start].header.first, headers[end].header.first) == 0; end++)
+                variable = variable || headers[end].value_index != kFixedHeader;
+
+            if (start > 0)
+                signed_sink.append(";");
+            signed_sink.appendLowercase(headers[start].header.first);
+
+            if (!variable)
+            {
+                std::vector<ViewPair> group;
+                for (size_t i = start; i < end; i++)
+                    group.push_back(headers[i].header);
+                writeHeaders(fixed_sink, discard, group.data(), group.size());
+                continue;
+            }
+            if (end - start > 1)
+                m_valid = false;
+
+            Slot slot;
+            slot.fixed_lines.swap(fixed_lines);
+            StringSink name_sink = {slot.name};
+            name_sink.appendLowercase(headers[start].header.first);
+            name_sink.append(":");
+            slot.value_index = headers[start].value_index;
+            m_slots.push_back(slot);
+        }
+
+        m_headers_suffix = fixed_lines + "\n" + m_signed_headers + "\n";
+    }
+
+    bool PreparedRequest::valid() const
+    {
+        return m_valid;
+    }
+
+    const std::string &PreparedRequest::signedHeaders() const
+    {
+        return m_signed_headers;
+    }
+
+    size_t PreparedRequest::sign(
+        const std::string_view *variable_values,
+        std::string_view querystring,
+        std::string_view payload,
+        char *out,
+        size_t out_length
+    ) const
+    {
+        RequestTime time;
+        m_signature.requestTime(time);
+
+        return sign(time, variable_values, querystring, PayloadHash::computed(payload), out, out_length);
+    }
+
+    size_t PreparedRequest::sign(
+        const RequestTime &time,
+        const std::string_view *variable_values,
+        std::string_view querystring,
+        std::string_view payload,
+        char *out,
+        size_t out_length
+    ) const
+    {
+        return sign(time, variable_values, querystring, PayloadHash::computed(payload), out, out_length);
+    }
+
+    size_t PreparedRequest::sign(
+        const std::string_view *variable_values,
+        std::string_view querystring,
+        const PayloadHash &payload_hash,
+        char *out,
+        size_t out_length
+    ) const
+    {
+        RequestTime time;
+        m_signature.requestTime(time);
+
+        return sign(time, variable_values, querystring, payload_hash, out, out_length);
+    }
+
+    size_t PreparedRequest::sign(
+        const RequestTime &time,
+        const std::string_view *variable_values,
+        std::string_view querystring,
+        const PayloadHash &payload_hash,
+        char *out,
+        size_t out_length
+    ) const
+    {
+        if (!m_valid || !payload_hash.valid())
+            return 0;
+
+        AWSSIGV4_STAGE_BEGIN(kStageSignRequest);
+        AWSSIGV4_STAGE_BEGIN(kStageCanonicalize);
+        SortedRequest sorted;
+        bool sorted_ok = sortQuery(querystring, sorted);
+        AWSSIGV4_STAGE_END(kStageCanonicalize, 0);
+        if (!sorted_ok)
+            return 0;
+
+        SigningKey signing_key;
+        m_signature.loadSigningKey(time, signing_key);
+
+        char hex[2 * kSha256DigestLength];
+        std::string_view payload_line = payloadHashLine(payload_hash, hex);
+
+        // Step 1.7: the prepared text with the query and variable values
+        // spliced in
+        AWSSIGV4_STAGE_BEGIN(kStageCanonicalRequestHash);
+        HashSink sink;
+        sink.append(m_method);
+        sink.append("\n");
+        sink.append(m_canonical_uri);
+        sink.append("\n");
+        writeCanonicalQuery(sink, sorted);
+        sink.append("\n");
+        for (size_t i = 0; i < m_slots.size(); i++)
+        {
+            const Slot &slot = m_slots[i];
+            sink.append(slot.fixed_lines);
+            sink.append(slot.name);
+            appendCollapsed(sink, trimView(variable_values[slot.value_index]));
+            sink.append("\n");
+        }
+        sink.append(m_headers_suffix);
+        sink.append(payload_line);
+        AWSSIGV4_STAGE_END(kStageCanonicalRequestHash, sink.sha256.length());
+        unsigned char digest[kSha256DigestLength];
+        sink.sha256.final(digest);
+
+        // Steps 2 to 4 as in signOne
+        FixedWriter writer(out, out_length);
+        m_signature.writeSignedAuthorization(signing_key, time, digest, std::string_view(m_signed_headers), writer);
+
+        AWSSIGV4_STAGE_END(kStageSignRequest, payload_hash.payload().length());
+        return writer.overflowed() ? 0 : writer.length();
     }
 
 }
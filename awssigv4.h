@@ -1,6 +1,9 @@
 // SIgn aws request with v4 signature
 // http://docs.aws.amazon.com/general/latest/gr/sigv4_signing.html
 
+#ifndef AWSSIGV4_H
+#define AWSSIGV4_H
+
 #include <iostream>
 #include <string.h>
 #include <sstream> 
@@ -11,39 +14,420 @@
 #include <map>
 #include <vector>
 #include <algorithm>
-#include "openssl/sha.h"
-#include "openssl/hmac.h"
+#include <atomic>
+#include <string_view>
+#include <stdint.h>
+#include "awssigv4_crypto.h"
+#include "awssigv4_uri.h"
 
 namespace aws_sigv4 {
 
+    // Holder for a small trivially copyable value that many threads read
+    // and that is rarely written (a sequence lock). Readers never block: a
+    // read that races with a write, or happens before the first write,
+    // reports failure and the caller falls back to computing the value.
+    template <typename T>
+    class SeqLock
+    {
+        private:
+            static const size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+            std::atomic<uint64_t> m_sequence;
+            std::atomic<uint64_t> m_words[kWords];
+
+        public:
+            SeqLock() : m_sequence(0)
+            {
+                for (size_t i = 0; i < kWords; i++)
+                    m_words[i].store(0, std::memory_order_relaxed);
+            }
+
+            SeqLock(const SeqLock &other) : m_sequence(0)
+            {
+                for (size_t i = 0; i < kWords; i++)
+                    m_words[i].store(0, std::memory_order_relaxed);
+
+                T value;
+                if (other.load(value))
+                    store(value);
+            }
+
+            // Like the copy constructor, other's value or none; must not race
+            // with any other access to this holder
+            SeqLock &operator=(const SeqLock &other)
+            {
+                if (this == &other)
+                    return *this;
+
+                T value;
+                if (other.load(value))
+                    store(value);
+                else
+                {
+                    for (size_t i = 0; i < kWords; i++)
+                        m_words[i].store(0, std::memory_order_relaxed);
+                    m_sequence.store(0, std::memory_order_release);
+                }
+                return *this;
+            }
+
+            bool load(T &value) const
+            {
+                uint64_t before = m_sequence.load(std::memory_order_acquire);
+                if (before == 0 || (before & 1))
+                    return false;
+
+                uint64_t words[kWords];
+                for (size_t i = 0; i < kWords; i++)
+                    words[i] = m_words[i].load(std::memory_order_relaxed);
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (m_sequence.load(std::memory_order_relaxed) != before)
+                    return false;
+
+                memcpy(&value, words, sizeof(T));
+                return true;
+            }
+
+            // Returns false without writing when another writer holds the slot
+            bool store(const T &value)
+            {
+                uint64_t current = m_sequence.load(std::memory_order_relaxed);
+                if ((current & 1) || !m_sequence.compare_exchange_strong(current, current + 1, std::memory_order_acquire, std::memory_order_relaxed))
+                    return false;
+                std::atomic_thread_fence(std::memory_order_release);
+
+                uint64_t words[kWords] = {0};
+                memcpy(words, &value, sizeof(T));
+                for (size_t i = 0; i < kWords; i++)
+                    m_words[i].store(words[i], std::memory_order_relaxed);
+
+                m_sequence.store(current + 2, std::memory_order_release);
+                return true;
+            }
+    };
+
+    // One request header for the allocation-free signing API
+    struct HeaderField
+    {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    // One request of a batch signed by Signature::signBatch. The views and
+    // the header array must stay valid for the duration of the call.
+    struct SignRequest
+    {
+        std::string_view method;
+        std::string_view canonical_uri;
+        std::string_view querystring;
+        const HeaderField *headers;
+        size_t header_count;
+        std::string_view payload;
+    };
+
+    // Steps 1.1 to 1.7 of request through the same canonicalisation as
+    // Signature::signRequest, with payload_hash as the last line: digest is
+    // the SHA-256 of the canonical request, and if signed_headers is given
+    // the signed header list is appended to it. Returns false if the request
+    // has more than Signature::kMaxHeaders headers or
+    // Signature::kMaxQueryParameters parameters. request.payload is unused.
+    bool hashCanonicalRequest(
+        const SignRequest &request,
+        std::string_view payload_hash,
+        UriNormalization uri_normalization,
+        unsigned char digest[kSha256DigestLength],
+        std::string *signed_headers=NULL
+    );
+
+    // The second a request is signed at, formatted for the x-amz-date header
+    // and the credential scope
+    struct RequestTime
+    {
+        time_t time;
+        char amzdate[17];       // 20110909T233600Z
+        char datestamp[9];      // 20110909
+    };
+
+    void formatRequestTime(time_t time, RequestTime &request_time);
+
+    class TimestampCache;
+    class MultiBufferSha256;
+
+    // The final signing key derived from a secret key and credential scope
+    struct SigningKey
+    {
+        unsigned char key[kSha256DigestLength];
+
+        // HMAC with the key pads already hashed, so that signing with this
+        // key only hashes the message and one outer block
+        HmacSha256 hmac;
+    };
+
+    // kSigning = HMAC(HMAC(HMAC(HMAC("AWS4" + secret, date), region), service), "aws4_request")
+    void deriveSigningKey(
+        std::string_view secret_key,
+        std::string_view datestamp,
+        std::string_view region,
+        std::string_view service,
+        SigningKey &signing_key
+    );
+
+    // Cache of derived signing keys keyed on access key and credential scope
+    // (access_key/datestamp/region/service), and matched against the SHA-256
+    // of the secret on lookup. The key only changes once a day, so entries
+    // for yesterday's datestamp simply stop matching at UTC midnight and
+    // are overwritten. Lookups are lock free and may be issued
+    // from any number of threads; a lookup that races with a store is a miss.
+    class SigningKeyCache
+    {
+        public:
+            // Scopes longer than this bypass the cache
+            static const size_t kMaxScopeLength = 96;
+
+            explicit SigningKeyCache(size_t slot_count = 64);
+            ~SigningKeyCache();
+
+            // Process-wide cache used by every Signature unless told otherwise
+            static SigningKeyCache &shared();
+
+            bool lookup(
+                std::string_view scope,
+                std::string_view secret_key,
+                SigningKey &signing_key
+            ) const;
+
+            void store(
+                std::string_view scope,
+                std::string_view secret_key,
+                const SigningKey &signing_key
+            );
+
+        private:
+            struct Entry;
+
+            SigningKeyCache(const SigningKeyCache &);
+            SigningKeyCache &operator=(const SigningKeyCache &);
+
+            SeqLock<Entry> *m_slots;
+            size_t m_slot_mask;
+    };
+
+    // Incremental SHA-256 of a request body. Feed it the payload in chunks
+    // as they are read and pass it to createCanonicalRequest, so the body
+    // never has to be held in memory as a whole.
+    class PayloadHasher
+    {
+        private:
+            Sha256 m_sha256;
+            unsigned char m_digest[kSha256DigestLength];
+            bool m_finished;
+
+        public:
+            PayloadHasher();
+
+            // Start over with an empty payload
+            void reset();
+
+            void update(const void *data, size_t length);
+            void update(const std::string &data);
+
+            // Finish hashing and return the lowercase hex digest. Calling it
+            // again returns the same digest; update() after it is ignored.
+            std::string hexDigest();
+    };
+
+    // What the last line of the canonical request says about the payload.
+    // S3 wants the same value in the x-amz-content-sha256 header, which the
+    // caller sends and signs like any other. Only computed() hashes the
+    // payload; in every other mode the body is never read, so signing takes
+    // the same time whatever its size.
+    class PayloadHash
+    {
+        public:
+            enum Mode
+            {
+                // SHA-256 of the payload, hashed when the request is signed
+                kComputed,
+                // A SHA-256 the caller already has
+                kPrecomputed,
+                // UNSIGNED-PAYLOAD: the body is not covered by the signature
+                kUnsigned,
+                // SHA-256 of an empty body
+                kEmpty
+            };
+
+            static const char kUnsignedPayload[];
+            static const char kEmptyPayloadHash[];
+
+            // payload must stay valid until the request is signed
+            static PayloadHash computed(std::string_view payload);
+            // 64 hex digits, in either case; anything else makes an invalid
+            // hash, which every signing call rejects
+            static PayloadHash fromHex(std::string_view hex);
+            static PayloadHash fromDigest(const unsigned char digest[kSha256DigestLength]);
+            static PayloadHash unsignedPayload();
+            static PayloadHash empty();
+
+            Mode mode() const;
+            bool valid() const;
+
+            // The payload of a computed hash, empty otherwise
+            std::string_view payload() const;
+
+            // The line signed: lowercase hex or UNSIGNED-PAYLOAD. Empty for
+            // a computed hash, which is only known once signing hashes it.
+            std::string_view value() const;
+
+        private:
+            Mode m_mode;
+            std::string_view m_payload;
+            char m_value[2 * kSha256DigestLength];
+            size_t m_value_length;
+
+            explicit PayloadHash(Mode mode);
+    };
+
+    // Signs requests for one set of credentials, region and service, either
+    // at a fixed time or, when built on a TimestampCache, at the time of each
+    // signRequest/signBatch call. Apart from the createCanonicalRequest and
+    // createAuthorizationHeader(signature) pair, which passes the signed
+    // headers between calls, every signing call is const and keeps no
+    // per-request state, so one Signature may be shared by any number of
+    // threads. setKeyCache and setUriNormalization must not race with
+    // signing.
     class Signature
     {
+        friend class AsyncSigner;
+        friend class ChunkedSigner;
+        friend class MultipartSigner;
+        friend class Presigner;
+        friend class PreparedRequest;
+
         private:
             std::string m_secret_key, m_access_key, m_service, m_host, m_region, m_signed_headers;
-            
-            char m_amzdate[20];
-            char m_datestamp[20];
 
-            const std::string getSignatureKey();
+            // Time of the step by step API: the construction time
+            RequestTime m_time;
+
+            // datestamp/region/service/aws4_request, and the parts of the
+            // string to sign and Authorization header that only depend on it
+            std::string m_credential_scope, m_string_to_sign_prefix, m_authorization_prefix;
 
-            void hashSha256(const std::string str, unsigned char outputBuffer[SHA256_DIGEST_LENGTH]);
+            // The same split around the datestamp, for signing at any time:
+            // "AWS4-HMAC-SHA256 Credential=<access key>/" and
+            // "/<region>/<service>/aws4_request"
+            std::string m_credential_prefix, m_scope_suffix;
+
+            // Source of the current time, or NULL to always sign at m_time
+            const TimestampCache *m_timestamps;
+
+            // Per-signer copy of the derived key, tagged with its datestamp
+            struct DatedSigningKey
+            {
+                char datestamp[9];
+                SigningKey signing_key;
+            };
+            mutable SeqLock<DatedSigningKey> m_signing_key;
+            SigningKeyCache *m_key_cache;
+            UriNormalization m_uri_normalization;
+
+            void deriveSignatureKey(const char *datestamp, SigningKey &signing_key) const;
+
+            void hashSha256(std::string_view str, unsigned char outputBuffer[kSha256DigestLength]) const;
 
             // digest to hexdiges
-            const std::string hexlify(const unsigned char* digest);
+            const std::string hexlify(const unsigned char* digest) const;
 
             // equals to hashlib.sha256(str).hexdigest()
-            const std::string sha256Base16(const std::string str);
+            const std::string sha256Base16(std::string_view str) const;
 
-            // equals to  hmac.new(key, msg, hashlib.sha256).digest()
-            const std::string sign(const std::string key, const std::string msg);
+            // Same as sign() with the final signing key, starting from its
+            // precomputed midstates
+            void signWithKey(const SigningKey &signing_key, std::string_view msg, unsigned char digest[kSha256DigestLength]) const;
 
-            std::map<std::string, std::vector<std::string> > mergeHeaders(
-                std::map<std::string, std::vector<std::string> > canonical_header_map        
-            );
-            std::string canonicalHeaderStr(std::map<std::string, std::vector<std::string> > canonical_header_map);
-            std::string signedHeaderStr(std::map<std::string, std::vector<std::string> > canonical_header_map);
+            // Step 1.3: names and values percent-encoded per RFC 3986 (escapes
+            // already in the query are decoded first, so none is encoded
+            // twice), sorted by name and then value
+            std::string createCanonicalQueryString(const std::string &query_string) const;
+
+            // Fills signing_key without allocating once the per-signer key
+            // for the datestamp of time is in place
+            void loadSigningKey(const RequestTime &time, SigningKey &signing_key) const;
+
+            size_t signOne(
+                const SigningKey &signing_key,
+                const RequestTime &time,
+                const SignRequest &request,
+                char *out,
+                size_t out_length,
+                std::string *canonical_request=NULL
+            ) const;
+
+            // signOne for a payload already hashed: request.payload is unused
+            // and payload_hash is the last line of the canonical request
+            size_t signWithPayloadHash(
+                const SigningKey &signing_key,
+                const RequestTime &time,
+                const SignRequest &request,
+                std::string_view payload_hash,
+                char *out,
+                size_t out_length,
+                std::string *canonical_request=NULL
+            ) const;
 
-            std::string createCanonicalQueryString(std::string query_string);
+            // Both of the above into a string, with no limit on the length of
+            // the header. False, with authorization empty, if the request
+            // exceeds the limits of signRequest.
+            bool signOne(
+                const SigningKey &signing_key,
+                const RequestTime &time,
+                const SignRequest &request,
+                std::string &authorization
+            ) const;
+
+            bool signWithPayloadHash(
+                const SigningKey &signing_key,
+                const RequestTime &time,
+                const SignRequest &request,
+                std::string_view payload_hash,
+                std::string &authorization
+            ) const;
+
+            // Steps 1 to 4 with the Authorization header appended to header
+            template <typename Writer>
+            bool writeAuthorization(
+                const SigningKey &signing_key,
+                const RequestTime &time,
+                const SignRequest &request,
+                std::string_view payload_hash,
+                Writer &header,
+                std::string *canonical_request
+            ) const;
+
+            // Steps 2 to 4 for a canonical request hashed to request_digest:
+            // the string to sign is fed straight into the HMAC from the key's
+            // midstates, and the Authorization header appended to header.
+            // signed_headers is the list as a string, or the sorted request
+            // it is written from.
+            template <typename Writer, typename SignedHeaders>
+            void writeSignedAuthorization(
+                const SigningKey &signing_key,
+                const RequestTime &time,
+                const unsigned char request_digest[kSha256DigestLength],
+                const SignedHeaders &signed_headers,
+                Writer &header
+            ) const;
+
+            // Also returns the signed header list through signed_headers
+            std::string buildCanonicalRequest(
+                const std::string &method,
+                const std::string &canonical_uri,
+                const std::string &querystring,
+                const std::map<std::string, std::vector<std::string> > &canonical_header_map,
+                std::string_view payload_hash,
+                std::string &signed_headers
+            ) const;
 
         public:
             Signature(
@@ -55,25 +439,305 @@ namespace aws_sigv4 {
                 const time_t sig_time=time(0)
             );
 
-            // Step 1: creaate a canonical request
+            // Signer for long-lived use: signRequest and signBatch sign at
+            // the current time of timestamps, which must outlive the signer
+            // (TimestampCache::system() does). The step by step API below
+            // keeps using the construction time.
+            Signature(
+                const std::string service,
+                const std::string host,
+                const std::string region,
+                const std::string secret_key,
+                const std::string access_key,
+                const TimestampCache &timestamps
+            );
+
+            // The time signRequest and signBatch would sign at if called now.
+            // Take it before building the request when it carries an
+            // x-amz-date header, and pass it to the overloads that take a
+            // RequestTime so the header and the signature agree even across
+            // a second boundary.
+            void requestTime(RequestTime &time) const;
+
+            // Share derived keys through the given cache (the process-wide
+            // one by default). Pass NULL to only keep the per-signer key.
+            void setKeyCache(SigningKeyCache *key_cache);
+
+            // How request paths become canonical URIs: by default
+            // uriNormalizationFor(service), so S3 object keys are only
+            // encoded and every other service's paths are normalised too.
+            // Paths that are already canonical are signed as they are.
+            void setUriNormalization(UriNormalization mode);
+            UriNormalization uriNormalization() const;
+
+            // Step 1: creaate a canonical request. The step by step API
+            // builds the whole canonical request as a string, which is what
+            // it is for; signRequest only hashes it as it is produced.
             std::string createCanonicalRequest(
-                const std::string method,
-                const std::string canonical_uri,
-                const std::string querystring, 
-                std::map<std::string, std::vector<std::string> > canonical_header_map,
-                const std::string payload
+                const std::string &method,
+                const std::string &canonical_uri,
+                const std::string &querystring,
+                const std::map<std::string, std::vector<std::string> > &canonical_header_map,
+                const std::string &payload
+            );
+
+            // Same as above for a payload hashed incrementally by the caller
+            std::string createCanonicalRequest(
+                const std::string &method,
+                const std::string &canonical_uri,
+                const std::string &querystring,
+                const std::map<std::string, std::vector<std::string> > &canonical_header_map,
+                PayloadHasher &payload_hasher
+            );
+
+            // Same with the payload hash given in any mode. Returns an empty
+            // string for an invalid hash.
+            std::string createCanonicalRequest(
+                const std::string &method,
+                const std::string &canonical_uri,
+                const std::string &querystring,
+                const std::map<std::string, std::vector<std::string> > &canonical_header_map,
+                const PayloadHash &payload_hash
             );
 
             // Step 2: CREATE THE STRING TO SIGN
-            std::string createStringToSign(std::string canonical_request);
+            std::string createStringToSign(const std::string &canonical_request) const;
 
             // step 3: CALCULATE THE SIGNATURE
-            std::string createSignature(std::string string_to_sign);
+            std::string createSignature(const std::string &string_to_sign) const;
 
             // Step 4.1: CREATE Authorization header
             // This method assuemd to be called after previous step
             // So It can get credential scope and signed headers
-            std::string createAuthorizationHeader(std::string signature);
+            std::string createAuthorizationHeader(const std::string &signature);
+
+            // Same for the signed header list of any request
+            std::string createAuthorizationHeader(const std::string &signed_headers, const std::string &signature) const;
+
+            // Steps 1 to 4 in one call: returns the Authorization header for
+            // the request. Unlike createCanonicalRequest followed by
+            // createAuthorizationHeader, nothing is kept in the signer, and
+            // the canonical request is fed to SHA-256 piece by piece as it is
+            // produced rather than built as a string. For debugging, the
+            // string is also written to canonical_request when given.
+            std::string signRequest(
+                const std::string &method,
+                const std::string &canonical_uri,
+                const std::string &querystring,
+                const std::map<std::string, std::vector<std::string> > &canonical_header_map,
+                std::string_view payload,
+                std::string *canonical_request=NULL
+            ) const;
+
+            // Same with the payload hash given in any mode. Returns an empty
+            // string for an invalid hash.
+            std::string signRequest(
+                const std::string &method,
+                const std::string &canonical_uri,
+                const std::string &querystring,
+                const std::map<std::string, std::vector<std::string> > &canonical_header_map,
+                const PayloadHash &payload_hash,
+                std::string *canonical_request=NULL
+            ) const;
+
+            // Limits of the allocation-free signing API
+            static const size_t kMaxHeaders = 64;
+            static const size_t kMaxQueryParameters = 256;
+
+            // Steps 1 to 4 in one call, reading the request through views and
+            // writing the Authorization header value into out. Nothing is
+            // copied to the heap: the canonical request is hashed as it is
+            // produced and sorting happens in fixed-size stack arrays. A path
+            // or query string that is not already canonical is canonicalised
+            // as by createCanonicalRequest, which does allocate.
+            // Returns the length written (out is not NUL terminated), or 0 if
+            // out is too small or the request has more than kMaxHeaders
+            // headers or kMaxQueryParameters parameters. canonical_request,
+            // when given, receives the canonical request for debugging, at
+            // the cost of building it.
+            size_t signRequest(
+                std::string_view method,
+                std::string_view canonical_uri,
+                std::string_view querystring,
+                const HeaderField *headers,
+                size_t header_count,
+                std::string_view payload,
+                char *out,
+                size_t out_length,
+                std::string *canonical_request=NULL
+            ) const;
+
+            // Same, signed at the given time
+            size_t signRequest(
+                const RequestTime &time,
+                std::string_view method,
+                std::string_view canonical_uri,
+                std::string_view querystring,
+                const HeaderField *headers,
+                size_t header_count,
+                std::string_view payload,
+                char *out,
+                size_t out_length,
+                std::string *canonical_request=NULL
+            ) const;
+
+            // Both of the above with the payload hash given in any mode. An
+            // invalid hash is rejected (0 is returned).
+            size_t signRequest(
+                std::string_view method,
+                std::string_view canonical_uri,
+                std::string_view querystring,
+                const HeaderField *headers,
+                size_t header_count,
+                const PayloadHash &payload_hash,
+                char *out,
+                size_t out_length,
+                std::string *canonical_request=NULL
+            ) const;
+
+            size_t signRequest(
+                const RequestTime &time,
+                std::string_view method,
+                std::string_view canonical_uri,
+                std::string_view querystring,
+                const HeaderField *headers,
+                size_t header_count,
+                const PayloadHash &payload_hash,
+                char *out,
+                size_t out_length,
+                std::string *canonical_request=NULL
+            ) const;
+
+            // Sign count requests that share this signer's credentials,
+            // region and service, all at one requestTime(). The signing key
+            // and the timestamp are prepared once for the whole batch, and on
+            // CPUs with AVX2 or AVX-512 the SHA-256 work of up to 16 requests
+            // of similar length runs side by side (see MultiBufferSha256).
+            // authorization_headers[i] receives the header of requests[i], or
+            // an empty string if that request exceeds the limits of
+            // signRequest. Returns the number of requests signed.
+            size_t signBatch(
+                const SignRequest *requests,
+                size_t count,
+                std::string *authorization_headers
+            ) const;
+
+            // Same, every request signed at the given time
+            size_t signBatch(
+                const RequestTime &time,
+                const SignRequest *requests,
+                size_t count,
+                std::string *authorization_headers
+            ) const;
+
+            // Same, hashing with hasher rather than on the widest kernel the
+            // CPU has
+            size_t signBatch(
+                const RequestTime &time,
+                const SignRequest *requests,
+                size_t count,
+                std::string *authorization_headers,
+                const MultiBufferSha256 &hasher
+            ) const;
+    };
+
+    // A recurring request shape, canonicalised once: the method, path, the
+    // headers whose values never change, the names of those that do, and
+    // with them the signed header list. Signing then only hashes the
+    // payload, the query string and the variable header values around the
+    // prepared text, and produces exactly the header Signature::signRequest
+    // gives for the same request. Immutable once built, so it may be shared
+    // by any number of threads; the signer must outlive it.
+    class PreparedRequest
+    {
+        public:
+            // Header names are matched without regard to case. A variable
+            // name listed twice, or also among the fixed headers, makes the
+            // template invalid. x-amz-date is usually a variable header.
+            PreparedRequest(
+                const Signature &signature,
+                std::string_view method,
+                std::string_view canonical_uri,
+                const HeaderField *fixed_headers,
+                size_t fixed_count,
+                const std::string_view *variable_names,
+                size_t variable_count
+            );
+
+            bool valid() const;
+
+            // "host;x-amz-date;..." of every request signed from here
+            const std::string &signedHeaders() const;
+
+            // Signs the prepared request with variable_values given in the
+            // order of the variable names, at signature.requestTime(). The
+            // query string is canonicalised per request as by signRequest.
+            // Returns the Authorization header length written to out, or 0
+            // if out is too small, the query has more than
+            // Signature::kMaxQueryParameters parameters or the template is
+            // invalid. Does not allocate once the signing key is loaded,
+            // unless the query string needs encoding.
+            size_t sign(
+                const std::string_view *variable_values,
+                std::string_view querystring,
+                std::string_view payload,
+                char *out,
+                size_t out_length
+            ) const;
+
+            // Same, signed at the given time
+            size_t sign(
+                const RequestTime &time,
+                const std::string_view *variable_values,
+                std::string_view querystring,
+                std::string_view payload,
+                char *out,
+                size_t out_length
+            ) const;
+
+            // Both of the above with the payload hash given in any mode. An
+            // invalid hash is rejected (0 is returned).
+            size_t sign(
+                const std::string_view *variable_values,
+                std::string_view querystring,
+                const PayloadHash &payload_hash,
+                char *out,
+                size_t out_length
+            ) const;
+
+            size_t sign(
+                const RequestTime &time,
+                const std::string_view *variable_values,
+                std::string_view querystring,
+                const PayloadHash &payload_hash,
+                char *out,
+                size_t out_length
+            ) const;
+
+        private:
+            // One variable header line, between two runs of fixed lines
+            struct Slot
+            {
+                // Fixed canonical header lines before this variable header
+                std::string fixed_lines;
+                // "name:", lowercase
+                std::string name;
+                // Index into the caller's variable values
+                size_t value_index;
+            };
+
+            const Signature &m_signature;
+            bool m_valid;
+            size_t m_variable_count;
+            std::string m_method;
+            std::string m_canonical_uri;
+            std::vector<Slot> m_slots;
+            // Fixed lines after the last variable header, the blank line and
+            // the signed header list
+            std::string m_headers_suffix;
+            std::string m_signed_headers;
     };
 
 }
+
+#endif
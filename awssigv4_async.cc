@@ -0,0 +1,198 @@
+#include "awssigv4_async.h"
+
+namespace aws_sigv4 {
+
+    struct AsyncSigner::Job
+    {
+        RequestTime time;
+        SignRequest request;
+        Completion done;
+        // Payload hashed so far
+        Sha256 sha256;
+        size_t hashed;
+        std::string authorization;
+    };
+
+    AsyncSigner::AsyncSigner(
+        const Signature &signature,
+        size_t thread_count,
+        size_t queue_capacity
+    ) : m_signature(signature), m_capacity(std::max<size_t>(1, queue_capacity)), m_pending(0), m_stopping(false), m_queued(0), m_next_worker(0)
+    {
+        if (thread_count == 0)
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+        m_workers = std::vector<Worker>(thread_count);
+        for (size_t w = 0; w < m_workers.size(); w++)
+            m_workers[w].thread = std::thread(&AsyncSigner::run, this, w);
+    }
+
+    AsyncSigner::~AsyncSigner()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_work_ready.notify_all();
+
+        for (size_t w = 0; w < m_workers.size(); w++)
+            m_workers[w].thread.join();
+    }
+
+    size_t AsyncSigner::threadCount() const
+    {
+        return m_workers.size();
+    }
+
+    size_t AsyncSigner::pending() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_pending;
+    }
+
+    bool AsyncSigner::trySubmit(const RequestTime &time, const SignRequest &request, const Completion &done)
+    {
+        return accept(time, request, done, false);
+    }
+
+    void AsyncSigner::submit(const RequestTime &time, const SignRequest &request, const Completion &done)
+    {
+        accept(time, request, done, true);
+    }
+
+    std::future<std::string> AsyncSigner::submit(const RequestTime &time, const SignRequest &request)
+    {
+        std::shared_ptr<std::promise<std::string> > promise = std::make_shared<std::promise<std::string> >();
+        std::future<std::string> result = promise->get_future();
+        accept(time, request, [promise](const std::string &authorization) {
+            promise->set_value(authorization);
+        }, true);
+        return result;
+    }
+
+    bool AsyncSigner::accept(const RequestTime &time, const SignRequest &request, const Completion &done, bool wait)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (wait)
+                m_space_ready.wait(lock, [this]() { return m_pending < m_capacity; });
+            else if (m_pending >= m_capacity)
+                return false;
+            m_pending++;
+        }
+
+        Job *job = new Job;
+        job->time = time;
+        job->request = request;
+        job->done = done;
+        job->hashed = 0;
+
+        enqueue(m_next_worker.fetch_add(1, std::memory_order_relaxed) % m_workers.size(), job);
+        return true;
+    }
+
+    void AsyncSigner::enqueue(size_t worker, Job *job)
+    {
+        // Counted under the queue's lock too, so that take() never finds a
+        // job before it is counted
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::lock_guard<std::mutex> queue_lock(m_workers[worker].mutex);
+            m_workers[worker].jobs.push_back(job);
+            m_queued++;
+        }
+        m_work_ready.notify_one();
+    }
+
+    AsyncSigner::Job *AsyncSigner::take(size_t worker)
+    {
+        // Own queue first, oldest job first
+        {
+            Worker &own = m_workers[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.jobs.empty())
+            {
+                Job *job = own.jobs.front();
+                own.jobs.pop_front();
+                m_queued--;
+                return job;
+            }
+        }
+
+        // Then the newest job of another worker
+        for (size_t i = 1; i < m_workers.size(); i++)
+        {
+            Worker &victim = m_workers[(worker + i) % m_workers.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs.empty())
+            {
+                Job *job = victim.jobs.back();
+                victim.jobs.pop_back();
+                m_queued--;
+                return job;
+            }
+        }
+        return NULL;
+    }
+
+    bool AsyncSigner::runSlice(Job *job)
+    {
+        std::string_view payload = job->request.payload;
+        size_t length = payload.length() - job->hashed;
+        if (length > kSliceBytes)
+            length = kSliceBytes;
+        job->sha256.update(payload.data() + job->hashed, length);
+        job->hashed += length;
+        if (job->hashed < payload.length())
+            return false;
+
+        unsigned char digest[kSha256DigestLength];
+        job->sha256.final(digest);
+        PayloadHash payload_hash = PayloadHash::fromDigest(digest);
+
+        SigningKey signing_key;
+        m_signature.loadSigningKey(job->time, signing_key);
+        m_signature.signWithPayloadHash(signing_key, job->time, job->request, payload_hash.value(), job->authorization);
+        return true;
+    }
+
+    void AsyncSigner::complete(Job *job)
+    {
+        job->done(job->authorization);
+        delete job;
+
+        bool drained;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending--;
+            drained = m_stopping && m_pending == 0;
+        }
+        m_space_ready.notify_one();
+        if (drained)
+            m_work_ready.notify_all();
+    }
+
+    void AsyncSigner::run(size_t worker)
+    {
+        for (;;)
+        {
+            Job *job = take(worker);
+            if (job != NULL)
+            {
+                if (runSlice(job))
+                    complete(job);
+                else
+                    enqueue(worker, job);
+                continue;
+            }
+
+            // Jobs being hashed elsewhere may still come back to a queue,
+            // so only stop once every accepted job has completed
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_work_ready.wait(lock, [this]() { return m_queued > 0 || (m_stopping && m_pending == 0); });
+            if (m_queued == 0)
+                return;
+        }
+    }
+
+}
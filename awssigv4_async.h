@@ -0,0 +1,106 @@
+// Signing off the caller's thread, for event loops that cannot hash large
+// bodies inline
+
+#ifndef AWSSIGV4_ASYNC_H
+#define AWSSIGV4_ASYNC_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "awssigv4.h"
+
+namespace aws_sigv4 {
+
+    // Signs requests on a pool of worker threads sharing one Signature.
+    //
+    // Each worker has its own queue; submissions are spread over them in
+    // turn and an idle worker steals from the back of the others' queues.
+    // Payloads are hashed kSliceBytes at a time, and a job with more left
+    // to hash goes back to the end of its worker's queue after each slice:
+    // a large body delays the jobs queued behind it by one slice at a time
+    // instead of its whole hash, so header-only signatures keep a short
+    // tail latency even on a single worker.
+    //
+    // At most queue_capacity jobs are accepted and not yet completed.
+    // Beyond that submit() blocks until one completes and trySubmit()
+    // returns false, so that the producer slows down instead of the queues
+    // growing without bound.
+    //
+    // Completions run on a worker thread, once per job, and must not block
+    // for long or throw. They may call trySubmit() but not the blocking
+    // submit(), which could wait on the worker it runs on. The destructor
+    // finishes every accepted job before joining the workers.
+    class AsyncSigner
+    {
+        public:
+            static const size_t kDefaultQueueCapacity = 1024;
+            static const size_t kSliceBytes = 256 * 1024;
+
+            // Receives the Authorization header, or an empty string if the
+            // request exceeds the limits of Signature::signRequest
+            typedef std::function<void(const std::string &authorization)> Completion;
+
+            // thread_count 0 runs one worker per core. The signer must
+            // outlive the AsyncSigner.
+            explicit AsyncSigner(
+                const Signature &signature,
+                size_t thread_count=0,
+                size_t queue_capacity=kDefaultQueueCapacity
+            );
+            ~AsyncSigner();
+
+            // Sign request at time, as Signature::signRequest would. The
+            // views, the header array and the payload must stay valid until
+            // the job completes.
+            bool trySubmit(const RequestTime &time, const SignRequest &request, const Completion &done);
+            void submit(const RequestTime &time, const SignRequest &request, const Completion &done);
+            std::future<std::string> submit(const RequestTime &time, const SignRequest &request);
+
+            size_t threadCount() const;
+
+            // Jobs accepted and not completed
+            size_t pending() const;
+
+        private:
+            struct Job;
+
+            struct Worker
+            {
+                std::mutex mutex;
+                std::deque<Job *> jobs;
+                std::thread thread;
+            };
+
+            const Signature &m_signature;
+            size_t m_capacity;
+            std::vector<Worker> m_workers;
+
+            // Guards m_pending and m_stopping, and is held while m_queued
+            // goes up so that sleeping workers cannot miss a job
+            mutable std::mutex m_mutex;
+            std::condition_variable m_work_ready;
+            std::condition_variable m_space_ready;
+            size_t m_pending;
+            bool m_stopping;
+            std::atomic<size_t> m_queued;
+            std::atomic<size_t> m_next_worker;
+
+            AsyncSigner(const AsyncSigner &);
+            AsyncSigner &operator=(const AsyncSigner &);
+
+            bool accept(const RequestTime &time, const SignRequest &request, const Completion &done, bool wait);
+            void enqueue(size_t worker, Job *job);
+            Job *take(size_t worker);
+            bool runSlice(Job *job);
+            void complete(Job *job);
+            void run(size_t worker);
+    };
+
+}
+
+#endif
@@ -0,0 +1,195 @@
+#include "awssigv4_chunked.h"
+
+namespace aws_sigv4 {
+
+    static const char kStreamingPayload[] = "STREAMING-AWS4-HMAC-SHA256-PAYLOAD";
+    static const char kChunkSignatureAlgorithm[] = "AWS4-HMAC-SHA256-PAYLOAD";
+
+    // "<hex size>;chunk-signature=" + 64 hex digits + "\r\n"
+    static uint64_t chunkHeaderLength(uint64_t chunk_length)
+    {
+        uint64_t hex_digits = 1;
+        while (chunk_length >>= 4)
+            hex_digits++;
+
+        return hex_digits + 17 + 64 + 2;
+    }
+
+    ChunkedSigner::ChunkedSigner(
+        const Signature &signature,
+        const RequestTime &time,
+        uint64_t decoded_length,
+        size_t chunk_size
+    ) : m_signature(signature), m_time(time), m_decoded_length(decoded_length), m_chunk_size(effectiveChunkSize(chunk_size)), m_buffered(0), m_written(0)
+    {
+        m_signature.loadSigningKey(m_time, m_signing_key);
+        m_credential_scope = m_time.datestamp + m_signature.m_scope_suffix;
+    }
+
+    size_t ChunkedSigner::effectiveChunkSize(size_t chunk_size)
+    {
+        if (chunk_size == 0)
+            return kDefaultChunkSize;
+        if (chunk_size < kMinChunkSize)
+            return kMinChunkSize;
+        return chunk_size;
+    }
+
+    size_t ChunkedSigner::chunkSize() const
+    {
+        return m_chunk_size;
+    }
+
+    uint64_t ChunkedSigner::encodedLength(uint64_t decoded_length, size_t chunk_size)
+    {
+        chunk_size = effectiveChunkSize(chunk_size);
+
+        uint64_t full_chunks = decoded_length / chunk_size;
+        uint64_t remainder = decoded_length % chunk_size;
+
+        uint64_t length = full_chunks * (chunkHeaderLength(chunk_size) + chunk_size + 2);
+        if (remainder > 0)
+            length += chunkHeaderLength(remainder) + remainder + 2;
+
+        return length + chunkHeaderLength(0) + 2;
+    }
+
+    void ChunkedSigner::addStreamingHeaders(std::map<std::string, std::vector<std::string> > &canonical_header_map) const
+    {
+        std::stringstream encoded_length, decoded_length;
+        encoded_length << encodedLength(m_decoded_length, m_chunk_size);
+        decoded_length << m_decoded_length;
+
+        canonical_header_map["content-encoding"].push_back("aws-chunked");
+        canonical_header_map["content-length"].push_back(encoded_length.str());
+        canonical_header_map["x-amz-content-sha256"].push_back(kStreamingPayload);
+        canonical_header_map["x-amz-decoded-content-length"].push_back(decoded_length.str());
+    }
+
+    std::string ChunkedSigner::createCanonicalRequest(
+        const std::string &method,
+        const std::string &canonical_uri,
+        const std::string &querystring,
+        const std::map<std::string, std::vector<std::string> > &canonical_header_map)
+    {
+        return m_signature.buildCanonicalRequest(method, canonical_uri, querystring, canonical_header_map, kStreamingPayload, m_signed_headers);
+    }
+
+    std::string ChunkedSigner::signString(const std::string &string_to_sign) const
+    {
+        unsigned char digest[kSha256DigestLength];
+        m_signature.signWithKey(m_signing_key, string_to_sign, digest);
+        return m_signature.hexlify(digest);
+    }
+
+    std::string ChunkedSigner::signSeed(const std::string &canonical_request)
+    {
+        std::string string_to_sign = std::string("AWS4-HMAC-SHA256\n") + m_time.amzdate + '\n' + m_credential_scope + '\n' +
+            m_signature.sha256Base16(canonical_request);
+
+        m_previous_signature = signString(string_to_sign);
+        return m_previous_signature;
+    }
+
+    std::string ChunkedSigner::createAuthorizationHeader(const std::string &seed_signature) const
+    {
+        return m_signature.m_credential_prefix + m_credential_scope + ", SignedHeaders=" + m_signed_headers + ", Signature=" + seed_signature;
+    }
+
+    void ChunkedSigner::setSeedSignature(const std::string &seed_signature)
+    {
+        m_previous_signature = seed_signature;
+    }
+
+    std::string ChunkedSigner::chainSignature(const std::string &chunk_hash)
+    {
+        // The string to sign of a chunk chains it to the previous signature
+        std::string string_to_sign = std::string(kChunkSignatureAlgorithm) + '\n' + m_time.amzdate + '\n' + m_credential_scope + '\n' +
+            m_previous_signature + '\n' + PayloadHash::kEmptyPayloadHash + '\n' + chunk_hash;
+
+        m_previous_signature = signString(string_to_sign);
+        return m_previous_signature;
+    }
+
+    std::string ChunkedSigner::signChunk(const void *data, size_t length)
+    {
+        unsigned char digest[kSha256DigestLength];
+        Sha256::digest(data, length, digest);
+
+        std::string signature = chainSignature(m_signature.hexlify(digest));
+
+        char size_hex[17];
+        snprintf(size_hex, sizeof(size_hex), "%lx", (unsigned long)length);
+
+        return std::string(size_hex) + ";chunk-signature=" + signature + "\r\n";
+    }
+
+    void ChunkedSigner::setSink(const Sink &sink)
+    {
+        m_sink = sink;
+    }
+
+    void ChunkedSigner::flushChunk()
+    {
+        unsigned char digest[kSha256DigestLength];
+        m_chunk_sha256.final(digest);
+        m_chunk_sha256.reset();
+
+        std::string signature = chainSignature(m_signature.hexlify(digest));
+
+        char header[17 + 17 + 64 + 2 + 1];
+        int header_length = snprintf(header, sizeof(header), "%lx;chunk-signature=%s\r\n", (unsigned long)m_buffered, signature.c_str());
+
+        if (m_sink)
+        {
+            m_sink(header, header_length);
+            if (m_buffered > 0)
+                m_sink(&m_buffer[0], m_buffered);
+            m_sink("\r\n", 2);
+        }
+
+        m_buffered = 0;
+    }
+
+    bool ChunkedSigner::write(const void *data, size_t length)
+    {
+        if (length > m_decoded_length - m_written)
+            return false;
+        m_written += length;
+
+        if (m_buffer.size() != m_chunk_size)
+            m_buffer.resize(m_chunk_size);
+
+        const char *bytes = (const char *)data;
+        while (length > 0)
+        {
+            size_t take = std::min(length, m_chunk_size - m_buffered);
+
+            // Hash as the data streams in, so a full chunk only needs its
+            // digest finalised before it can be sent
+            m_chunk_sha256.update(bytes, take);
+            memcpy(&m_buffer[m_buffered], bytes, take);
+
+            m_buffered += take;
+            bytes += take;
+            length -= take;
+
+            if (m_buffered == m_chunk_size)
+                flushChunk();
+        }
+        return true;
+    }
+
+    bool ChunkedSigner::finish()
+    {
+        if (m_written != m_decoded_length)
+            return false;
+
+        if (m_buffered > 0)
+            flushChunk();
+
+        flushChunk();
+        return true;
+    }
+
+}
@@ -0,0 +1,121 @@
+// Sign an aws-chunked streaming upload (STREAMING-AWS4-HMAC-SHA256-PAYLOAD)
+// http://docs.aws.amazon.com/AmazonS3/latest/API/sigv4-streaming.html
+
+#ifndef AWSSIGV4_CHUNKED_H
+#define AWSSIGV4_CHUNKED_H
+
+#include <functional>
+#include "awssigv4.h"
+
+namespace aws_sigv4 {
+
+    // Signs the chunks of an aws-chunked upload, each chained to the
+    // previous one starting from the seed signature of the request headers.
+    //
+    // Usage:
+    //   RequestTime time;
+    //   signature.requestTime(time);
+    //   ChunkedSigner chunked(signature, time, object_size);
+    //   chunked.addStreamingHeaders(header_map);
+    //   header_map["x-amz-date"].push_back(time.amzdate);
+    //   creq = chunked.createCanonicalRequest("PUT", uri, "", header_map);
+    //   authorization = chunked.createAuthorizationHeader(chunked.signSeed(creq));
+    //   chunked.write(...) as data arrives, then chunked.finish()
+    //
+    // The seed and every chunk are signed at the time given, so a shared,
+    // long-lived signer can stream any number of uploads at once; the signer
+    // must outlive the ChunkedSigner. write() only ever holds one chunk, so
+    // memory use is fixed by the chunk size no matter how large the object
+    // is.
+    class ChunkedSigner
+    {
+        public:
+            typedef std::function<void(const char *data, size_t length)> Sink;
+
+            static const size_t kDefaultChunkSize = 64 * 1024;
+            // Smallest chunk S3 accepts, except for the last one
+            static const size_t kMinChunkSize = 8 * 1024;
+
+            // chunk_size 0 is kDefaultChunkSize, and a chunk_size below
+            // kMinChunkSize is raised to it
+            ChunkedSigner(
+                const Signature &signature,
+                const RequestTime &time,
+                uint64_t decoded_length,
+                size_t chunk_size=kDefaultChunkSize
+            );
+
+            // Length of the aws-chunked body for a payload of decoded_length
+            // bytes, including chunk headers and the final empty chunk, with
+            // chunk_size taken as the constructor does
+            static uint64_t encodedLength(uint64_t decoded_length, size_t chunk_size=kDefaultChunkSize);
+
+            // Add content-encoding, content-length, x-amz-content-sha256 and
+            // x-amz-decoded-content-length; they must be sent and signed
+            void addStreamingHeaders(std::map<std::string, std::vector<std::string> > &canonical_header_map) const;
+
+            // Canonical request of the seed, with the streaming payload marker
+            // in place of the payload hash. Also keeps its signed header list
+            // for createAuthorizationHeader.
+            std::string createCanonicalRequest(
+                const std::string &method,
+                const std::string &canonical_uri,
+                const std::string &querystring,
+                const std::map<std::string, std::vector<std::string> > &canonical_header_map
+            );
+
+            // Signature of the seed canonical request at the time given to
+            // the constructor, which the first chunk is chained to
+            std::string signSeed(const std::string &canonical_request);
+
+            // Authorization header of the seed request
+            std::string createAuthorizationHeader(const std::string &seed_signature) const;
+
+            // Chain the chunks to a seed signed some other way instead
+            void setSeedSignature(const std::string &seed_signature);
+
+            // Sign one chunk and return its header line,
+            // "<hex size>;chunk-signature=<signature>\r\n". The last call must
+            // be for an empty chunk.
+            std::string signChunk(const void *data, size_t length);
+
+            size_t chunkSize() const;
+
+            // Buffered mode: framed chunks are passed to the sink as soon as
+            // chunk_size bytes have been written. The payload written must
+            // add up to the decoded_length already signed into the headers:
+            // write() takes nothing and returns false if data would go past
+            // it.
+            void setSink(const Sink &sink);
+            bool write(const void *data, size_t length);
+            // Flush the last partial chunk and the final empty chunk. Returns
+            // false, flushing nothing, if fewer than decoded_length bytes
+            // were written.
+            bool finish();
+
+        private:
+            const Signature &m_signature;
+            RequestTime m_time;
+            SigningKey m_signing_key;
+            // <datestamp>/<region>/<service>/aws4_request
+            std::string m_credential_scope;
+            std::string m_signed_headers;
+            uint64_t m_decoded_length;
+            size_t m_chunk_size;
+            std::string m_previous_signature;
+
+            Sink m_sink;
+            std::vector<char> m_buffer;
+            size_t m_buffered;
+            uint64_t m_written;
+            Sha256 m_chunk_sha256;
+
+            static size_t effectiveChunkSize(size_t chunk_size);
+            std::string signString(const std::string &string_to_sign) const;
+            std::string chainSignature(const std::string &chunk_hash);
+            void flushChunk();
+    };
+
+}
+
+#endif
@@ -0,0 +1,78 @@
+#include "awssigv4_clock.h"
+
+namespace aws_sigv4 {
+
+    void formatRequestTime(time_t time, RequestTime &request_time)
+    {
+        struct tm tstruct;
+        gmtime_r(&time, &tstruct);
+
+        memset(&request_time, 0, sizeof(request_time));
+        request_time.time = time;
+        strftime(request_time.amzdate, sizeof(request_time.amzdate), "%Y%m%dT%H%M%SZ", &tstruct);
+        strftime(request_time.datestamp, sizeof(request_time.datestamp), "%Y%m%d", &tstruct);
+    }
+
+    class SystemClock : public Clock
+    {
+        public:
+            time_t now() const
+            {
+                return time(NULL);
+            }
+    };
+
+    const Clock &Clock::system()
+    {
+        static const SystemClock clock;
+        return clock;
+    }
+
+    FixedClock::FixedClock(time_t time) : m_time(time)
+    {
+    }
+
+    time_t FixedClock::now() const
+    {
+        return m_time.load(std::memory_order_relaxed);
+    }
+
+    void FixedClock::set(time_t time)
+    {
+        m_time.store(time, std::memory_order_relaxed);
+    }
+
+    void FixedClock::advance(time_t seconds)
+    {
+        m_time.fetch_add(seconds, std::memory_order_relaxed);
+    }
+
+    TimestampCache::TimestampCache(const Clock &clock) : m_clock(clock)
+    {
+    }
+
+    const TimestampCache &TimestampCache::system()
+    {
+        static const TimestampCache timestamps(Clock::system());
+        return timestamps;
+    }
+
+    const Clock &TimestampCache::clock() const
+    {
+        return m_clock;
+    }
+
+    void TimestampCache::now(RequestTime &time) const
+    {
+        time_t now = m_clock.now();
+        if (m_current.load(time) && time.time == now)
+            return;
+
+        // A new second (or a lost race with a writer): format it here. A
+        // failed store just means another thread is publishing the same
+        // second.
+        formatRequestTime(now, time);
+        m_current.store(time);
+    }
+
+}
@@ -0,0 +1,66 @@
+// Clocks, and the per-second timestamp cache that lets one long-lived
+// Signature sign every request at the current time
+
+#ifndef AWSSIGV4_CLOCK_H
+#define AWSSIGV4_CLOCK_H
+
+#include "awssigv4.h"
+
+namespace aws_sigv4 {
+
+    // Source of the current time, in whole seconds since the epoch
+    class Clock
+    {
+        public:
+            virtual ~Clock() {}
+
+            virtual time_t now() const = 0;
+
+            // time(), shared by the whole process
+            static const Clock &system();
+    };
+
+    // Clock that only moves when told to, for tests and for re-signing
+    // requests at a known time. May be moved while other threads read it.
+    class FixedClock : public Clock
+    {
+        private:
+            std::atomic<time_t> m_time;
+
+        public:
+            explicit FixedClock(time_t time);
+
+            time_t now() const;
+
+            void set(time_t time);
+            void advance(time_t seconds);
+    };
+
+    // Keeps the x-amz-date and datestamp strings of the current second.
+    // The first caller to see a new second formats it and publishes the
+    // result; every other call is a clock read and a copy of the cached
+    // strings. Lookups are lock free and may come from any number of threads.
+    class TimestampCache
+    {
+        private:
+            const Clock &m_clock;
+            mutable SeqLock<RequestTime> m_current;
+
+            TimestampCache(const TimestampCache &);
+            TimestampCache &operator=(const TimestampCache &);
+
+        public:
+            // The clock must outlive the cache
+            explicit TimestampCache(const Clock &clock = Clock::system());
+
+            // Cache on the system clock, shared by the whole process
+            static const TimestampCache &system();
+
+            const Clock &clock() const;
+
+            void now(RequestTime &time) const;
+    };
+
+}
+
+#endif
@@ -0,0 +1,416 @@
+#include "awssigv4_crypto.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AWSSIGV4_SHA_NI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#ifndef AWSSIGV4_NO_OPENSSL
+#include "openssl/evp.h"
+#endif
+
+namespace aws_sigv4 {
+
+    const uint32_t kSha256InitialState[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    const uint32_t kSha256RoundConstants[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    static inline uint32_t loadBigEndian32(const unsigned char *p)
+    {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+    }
+
+    static inline void storeBigEndian32(unsigned char *p, uint32_t v)
+    {
+        p[0] = v >> 24;
+        p[1] = v >> 16;
+        p[2] = v >> 8;
+        p[3] = v;
+    }
+
+    static inline uint32_t rotr32(uint32_t x, int n)
+    {
+        return (x >> n) | (x << (32 - n));
+    }
+
+    void CryptoBackend::sha256(const void *data, size_t length, unsigned char digest[kSha256DigestLength]) const
+    {
+        uint32_t h[8];
+        memcpy(h, kSha256InitialState, sizeof(h));
+
+        const unsigned char *bytes = (const unsigned char *)data;
+        size_t full_blocks = length / kSha256BlockLength;
+        compress(h, bytes, full_blocks);
+
+        unsigned char tail[2 * kSha256BlockLength];
+        size_t remainder = length % kSha256BlockLength;
+        size_t tail_length = remainder + 9 <= kSha256BlockLength ? kSha256BlockLength : 2 * kSha256BlockLength;
+        memset(tail, 0, tail_length);
+        memcpy(tail, bytes + full_blocks * kSha256BlockLength, remainder);
+        tail[remainder] = 0x80;
+
+        uint64_t bits = (uint64_t)length * 8;
+        for (int i = 0; i < 8; i++)
+            tail[tail_length - 1 - i] = (unsigned char)(bits >> (8 * i));
+        compress(h, tail, tail_length / kSha256BlockLength);
+
+        for (int i = 0; i < 8; i++)
+            storeBigEndian32(digest + 4 * i, h[i]);
+    }
+
+    // Portable C++, one block at a time
+    class BuiltinBackend : public CryptoBackend
+    {
+        public:
+            const char *name() const { return "builtin"; }
+
+            void compress(uint32_t h[8], const unsigned char *blocks, size_t block_count) const
+            {
+                for (size_t block = 0; block < block_count; block++, blocks += kSha256BlockLength)
+                {
+                    uint32_t w[64];
+                    for (int t = 0; t < 16; t++)
+                        w[t] = loadBigEndian32(blocks + 4 * t);
+                    for (int t = 16; t < 64; t++)
+                    {
+                        uint32_t s0 = rotr32(w[t - 15], 7) ^ rotr32(w[t - 15], 18) ^ (w[t - 15] >> 3);
+                        uint32_t s1 = rotr32(w[t - 2], 17) ^ rotr32(w[t - 2], 19) ^ (w[t - 2] >> 10);
+                        w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+                    }
+
+                    uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+                    uint32_t e = h[4], f = h[5], g = h[6], hh = h[7];
+
+                    for (int t = 0; t < 64; t++)
+                    {
+                        uint32_t t1 = hh + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + kSha256RoundConstants[t] + w[t];
+                        uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+                        hh = g;
+                        g = f;
+                        f = e;
+                        e = d + t1;
+                        d = c;
+                        c = b;
+                        b = a;
+                        a = t1 + t2;
+                    }
+
+                    h[0] += a;
+                    h[1] += b;
+                    h[2] += c;
+                    h[3] += d;
+                    h[4] += e;
+                    h[5] += f;
+                    h[6] += g;
+                    h[7] += hh;
+                }
+            }
+    };
+
+#ifdef AWSSIGV4_SHA_NI
+    // x86 SHA extensions: sha256rnds2 runs two rounds on the state held as
+    // ABEF/CDGH, sha256msg1/msg2 extend the message schedule four words at
+    // a time
+    __attribute__((target("sha,sse4.1")))
+    static void compressShaNi(uint32_t h[8], const unsigned char *blocks, size_t block_count)
+    {
+        const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+        __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[0]), 0xb1);
+        __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[4]), 0x1b);
+        __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+        state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+        for (size_t block = 0; block < block_count; block++, blocks += kSha256BlockLength)
+        {
+            __m128i abef = state0;
+            __m128i cdgh = state1;
+            __m128i w[4];
+
+            for (int i = 0; i < 4; i++)
+                w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(blocks + 16 * i)), byte_swap);
+
+#pragma GCC unroll 16
+            for (int i = 0; i < 16; i++)
+            {
+                __m128i message = _mm_add_epi32(w[i & 3], _mm_loadu_si128((const __m128i *)&kSha256RoundConstants[4 * i]));
+                state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+                if (i >= 3 && i <= 14)
+                {
+                    __m128i next = _mm_add_epi32(w[(i + 1) & 3], _mm_alignr_epi8(w[i & 3], w[(i + 3) & 3], 4));
+                    w[(i + 1) & 3] = _mm_sha256msg2_epu32(next, w[i & 3]);
+                }
+                state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(message, 0x0e));
+                if (i >= 1 && i <= 12)
+                    w[(i + 3) & 3] = _mm_sha256msg1_epu32(w[(i + 3) & 3], w[i & 3]);
+            }
+
+            state0 = _mm_add_epi32(state0, abef);
+            state1 = _mm_add_epi32(state1, cdgh);
+        }
+
+        tmp = _mm_shuffle_epi32(state0, 0x1b);
+        state1 = _mm_shuffle_epi32(state1, 0xb1);
+        _mm_storeu_si128((__m128i *)&h[0], _mm_blend_epi16(tmp, state1, 0xf0));
+        _mm_storeu_si128((__m128i *)&h[4], _mm_alignr_epi8(state1, tmp, 8));
+    }
+
+    static bool cpuHasShaNi()
+    {
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1))
+            return false;
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+            return false;
+        return (ebx & bit_SHA) != 0;
+    }
+
+    class ShaNiBackend : public CryptoBackend
+    {
+        public:
+            const char *name() const { return "sha-ni"; }
+
+            void compress(uint32_t h[8], const unsigned char *blocks, size_t block_count) const
+            {
+                compressShaNi(h, blocks, block_count);
+            }
+    };
+#endif
+
+#ifndef AWSSIGV4_NO_OPENSSL
+    // libcrypto through EVP, for whole messages. EVP cannot resume a hash
+    // from a raw chaining value, and the block function that could is
+    // deprecated, so incremental hashing uses the fastest built-in
+    // compression function instead.
+    class OpensslBackend : public CryptoBackend
+    {
+        public:
+            explicit OpensslBackend(const CryptoBackend &compressor) : m_compressor(compressor) {}
+
+            const char *name() const { return "openssl"; }
+
+            void compress(uint32_t h[8], const unsigned char *blocks, size_t block_count) const
+            {
+                m_compressor.compress(h, blocks, block_count);
+            }
+
+            void sha256(const void *data, size_t length, unsigned char digest[kSha256DigestLength]) const
+            {
+                unsigned int digest_length = 0;
+                if (EVP_Digest(data, length, digest, &digest_length, EVP_sha256(), NULL) != 1 || digest_length != kSha256DigestLength)
+                    CryptoBackend::sha256(data, length, digest);
+            }
+
+        private:
+            const CryptoBackend &m_compressor;
+    };
+#endif
+
+    // Backends usable in this process, in order of preference
+    struct BackendList
+    {
+        const CryptoBackend *backends[4];
+
+        BackendList()
+        {
+            static BuiltinBackend builtin;
+#ifdef AWSSIGV4_SHA_NI
+            static ShaNiBackend sha_ni;
+#endif
+
+            size_t count = 0;
+#ifdef AWSSIGV4_SHA_NI
+            if (cpuHasShaNi())
+                backends[count++] = &sha_ni;
+#endif
+#ifndef AWSSIGV4_NO_OPENSSL
+            static OpensslBackend openssl(count > 0 ? *backends[0] : builtin);
+            backends[count++] = &openssl;
+#endif
+            backends[count++] = &builtin;
+            backends[count] = NULL;
+        }
+    };
+
+    static const BackendList &backendList()
+    {
+        static const BackendList list;
+        return list;
+    }
+
+    const CryptoBackend *CryptoBackend::available(size_t index)
+    {
+        const BackendList &list = backendList();
+        for (size_t i = 0; list.backends[i] != NULL; i++)
+            if (i == index)
+                return list.backends[i];
+        return NULL;
+    }
+
+    const CryptoBackend *CryptoBackend::find(std::string_view name)
+    {
+        for (size_t i = 0; available(i) != NULL; i++)
+            if (name == available(i)->name())
+                return available(i);
+        return NULL;
+    }
+
+    static std::atomic<const CryptoBackend *> &activeBackend()
+    {
+        static std::atomic<const CryptoBackend *> active([] {
+            const char *name = getenv("AWSSIGV4_CRYPTO_BACKEND");
+            const CryptoBackend *backend = name != NULL ? CryptoBackend::find(name) : NULL;
+            return backend != NULL ? backend : CryptoBackend::available(0);
+        }());
+        return active;
+    }
+
+    const CryptoBackend &CryptoBackend::active()
+    {
+        return *activeBackend().load(std::memory_order_acquire);
+    }
+
+    void CryptoBackend::setActive(const CryptoBackend &backend)
+    {
+        activeBackend().store(&backend, std::memory_order_release);
+    }
+
+    Sha256::Sha256()
+    {
+        reset();
+    }
+
+    Sha256::Sha256(const Sha256Midstate &midstate)
+    {
+        memcpy(m_h, midstate.h, sizeof(m_h));
+        m_length = midstate.length;
+    }
+
+    void Sha256::reset()
+    {
+        memcpy(m_h, kSha256InitialState, sizeof(m_h));
+        m_length = 0;
+    }
+
+    void Sha256::update(const void *data, size_t length)
+    {
+        // data may be NULL for an empty payload, which memcpy must not see
+        if (length == 0)
+            return;
+
+        const unsigned char *bytes = (const unsigned char *)data;
+        size_t buffered = m_length % kSha256BlockLength;
+        m_length += length;
+
+        const CryptoBackend &backend = CryptoBackend::active();
+        if (buffered > 0)
+        {
+            size_t take = std::min(length, kSha256BlockLength - buffered);
+            memcpy(m_buffer + buffered, bytes, take);
+            bytes += take;
+            length -= take;
+            if (buffered + take < kSha256BlockLength)
+                return;
+            backend.compress(m_h, m_buffer, 1);
+        }
+
+        size_t full_blocks = length / kSha256BlockLength;
+        if (full_blocks > 0)
+            backend.compress(m_h, bytes, full_blocks);
+        memcpy(m_buffer, bytes + full_blocks * kSha256BlockLength, length % kSha256BlockLength);
+    }
+
+    void Sha256::final(unsigned char digest[kSha256DigestLength])
+    {
+        size_t buffered = m_length % kSha256BlockLength;
+        uint64_t bits = m_length * 8;
+
+        unsigned char tail[2 * kSha256BlockLength];
+        size_t tail_length = buffered + 9 <= kSha256BlockLength ? kSha256BlockLength : 2 * kSha256BlockLength;
+        memset(tail, 0, tail_length);
+        memcpy(tail, m_buffer, buffered);
+        tail[buffered] = 0x80;
+        for (int i = 0; i < 8; i++)
+            tail[tail_length - 1 - i] = (unsigned char)(bits >> (8 * i));
+
+        CryptoBackend::active().compress(m_h, tail, tail_length / kSha256BlockLength);
+
+        for (int i = 0; i < 8; i++)
+            storeBigEndian32(digest + 4 * i, m_h[i]);
+    }
+
+    Sha256Midstate Sha256::midstate() const
+    {
+        Sha256Midstate midstate;
+        memcpy(midstate.h, m_h, sizeof(midstate.h));
+        midstate.length = m_length;
+        return midstate;
+    }
+
+    void Sha256::digest(const void *data, size_t length, unsigned char digest[kSha256DigestLength])
+    {
+        CryptoBackend::active().sha256(data, length, digest);
+    }
+
+    void HmacSha256::init(const void *key, size_t key_length)
+    {
+        unsigned char block[kSha256BlockLength];
+        memset(block, 0, sizeof(block));
+        if (key_length > sizeof(block))
+            Sha256::digest(key, key_length, block);
+        else
+            memcpy(block, key, key_length);
+
+        unsigned char pad[kSha256BlockLength];
+        for (size_t i = 0; i < sizeof(pad); i++)
+            pad[i] = block[i] ^ 0x36;
+        m_inner.reset();
+        m_inner.update(pad, sizeof(pad));
+
+        for (size_t i = 0; i < sizeof(pad); i++)
+            pad[i] = block[i] ^ 0x5c;
+        m_outer.reset();
+        m_outer.update(pad, sizeof(pad));
+    }
+
+    void HmacSha256::final(unsigned char digest[kSha256DigestLength])
+    {
+        unsigned char inner_digest[kSha256DigestLength];
+        m_inner.final(inner_digest);
+
+        Sha256 outer = m_outer;
+        outer.update(inner_digest, sizeof(inner_digest));
+        outer.final(digest);
+    }
+
+    void HmacSha256::digest(
+        const void *key,
+        size_t key_length,
+        const void *data,
+        size_t length,
+        unsigned char digest[kSha256DigestLength])
+    {
+        HmacSha256 hmac;
+        hmac.init(key, key_length);
+        hmac.update(data, length);
+        hmac.final(digest);
+    }
+
+}
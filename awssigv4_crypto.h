@@ -0,0 +1,124 @@
+// SHA-256 and HMAC-SHA256 used by the signers, on top of a swappable backend
+
+#ifndef AWSSIGV4_CRYPTO_H
+#define AWSSIGV4_CRYPTO_H
+
+#include <string_view>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace aws_sigv4 {
+
+    static const size_t kSha256DigestLength = 32;
+    static const size_t kSha256BlockLength = 64;
+
+    // FIPS 180-4 constants, shared with the multi-buffer kernels
+    extern const uint32_t kSha256InitialState[8];
+    extern const uint32_t kSha256RoundConstants[64];
+
+    // A SHA-256 state that has absorbed a whole number of blocks, such as
+    // an HMAC ipad or opad midstate
+    struct Sha256Midstate
+    {
+        uint32_t h[8];
+        // bytes absorbed so far, a multiple of 64
+        uint64_t length;
+    };
+
+    // Source of the SHA-256 compression function. Every hash the library
+    // computes goes through the active backend. Compiled in are:
+    //   "openssl"  libcrypto EVP for whole messages, the fastest built-in
+    //              compression function otherwise (left out when built
+    //              with AWSSIGV4_NO_OPENSSL)
+    //   "sha-ni"   built in, x86 SHA extensions, on CPUs that have them
+    //   "builtin"  built in, portable C++
+    // All of them produce the same digests, so the backend may be switched
+    // at any time, even while other threads are signing.
+    class CryptoBackend
+    {
+        public:
+            virtual ~CryptoBackend() {}
+
+            virtual const char *name() const = 0;
+
+            // Absorb block_count 64-byte blocks into the chaining value h
+            virtual void compress(uint32_t h[8], const unsigned char *blocks, size_t block_count) const = 0;
+
+            // Digest of a whole message. The default runs compress(); a
+            // backend may have a faster one-shot path.
+            virtual void sha256(const void *data, size_t length, unsigned char digest[kSha256DigestLength]) const;
+
+            // Backends this build and CPU can run, fastest first, and NULL
+            // past the end
+            static const CryptoBackend *available(size_t index);
+
+            // NULL if no backend of that name can run here
+            static const CryptoBackend *find(std::string_view name);
+
+            // The first available backend unless the AWSSIGV4_CRYPTO_BACKEND
+            // environment variable names another one
+            static const CryptoBackend &active();
+            static void setActive(const CryptoBackend &backend);
+    };
+
+    // Incremental SHA-256. It is plain data: a copy carries on from where
+    // the original was, which is how HMAC key midstates are kept.
+    class Sha256
+    {
+        private:
+            uint32_t m_h[8];
+            uint64_t m_length;
+            unsigned char m_buffer[kSha256BlockLength];
+
+        public:
+            Sha256();
+            explicit Sha256(const Sha256Midstate &midstate);
+
+            void reset();
+
+            void update(const void *data, size_t length);
+            void update(std::string_view data) { update(data.data(), data.length()); }
+
+            void final(unsigned char digest[kSha256DigestLength]);
+
+            // Bytes hashed so far, including those of a starting midstate
+            uint64_t length() const { return m_length; }
+
+            // Only meaningful after a whole number of blocks
+            Sha256Midstate midstate() const;
+
+            // One-shot digest with the active backend
+            static void digest(const void *data, size_t length, unsigned char digest[kSha256DigestLength]);
+    };
+
+    // HMAC-SHA256 (RFC 2104). A copy made right after init() signs further
+    // messages with the same key without hashing the key pads again.
+    class HmacSha256
+    {
+        private:
+            Sha256 m_inner, m_outer;
+
+        public:
+            void init(const void *key, size_t key_length);
+
+            void update(const void *data, size_t length) { m_inner.update(data, length); }
+            void update(std::string_view data) { m_inner.update(data); }
+
+            void final(unsigned char digest[kSha256DigestLength]);
+
+            // States after absorbing key ^ ipad and key ^ opad
+            const Sha256 &inner() const { return m_inner; }
+            const Sha256 &outer() const { return m_outer; }
+
+            static void digest(
+                const void *key,
+                size_t key_length,
+                const void *data,
+                size_t length,
+                unsigned char digest[kSha256DigestLength]
+            );
+    };
+
+}
+
+#endif
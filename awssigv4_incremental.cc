@@ -0,0 +1,39 @@
+#include "awssigv4_incremental.h"
+
+namespace aws_sigv4 {
+
+    IncrementalSigner::IncrementalSigner(
+        const Signature &signature,
+        const RequestTime &time,
+        const SignRequest &request,
+        size_t slice_bytes
+    ) : m_signature(signature), m_time(time), m_request(request), m_slice_bytes(slice_bytes), m_hashed(0), m_done(false), m_authorization_length(0)
+    {
+        if (m_slice_bytes == 0)
+            m_slice_bytes = request.payload.length();
+    }
+
+    bool IncrementalSigner::hashSlice()
+    {
+        if (m_done)
+            return true;
+
+        std::string_view payload = m_request.payload;
+        size_t length = payload.length() - m_hashed;
+        if (length > m_slice_bytes)
+            length = m_slice_bytes;
+        m_sha256.update(payload.data() + m_hashed, length);
+        m_hashed += length;
+        if (m_hashed < payload.length())
+            return false;
+
+        unsigned char digest[kSha256DigestLength];
+        m_sha256.final(digest);
+        m_authorization_length = m_signature.signRequest(m_time, m_request.method, m_request.canonical_uri, m_request.querystring,
+                                                         m_request.headers, m_request.header_count, PayloadHash::fromDigest(digest),
+                                                         m_authorization, sizeof(m_authorization));
+        m_done = true;
+        return true;
+    }
+
+}
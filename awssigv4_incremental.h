@@ -0,0 +1,115 @@
+// Signing in bounded slices, for coroutine servers that cannot hash a large
+// body in one go without starving everything else on the thread
+
+#ifndef AWSSIGV4_INCREMENTAL_H
+#define AWSSIGV4_INCREMENTAL_H
+
+#ifdef __cpp_impl_coroutine
+#include <coroutine>
+#endif
+
+#include "awssigv4.h"
+
+namespace aws_sigv4 {
+
+    // Signs one request, hashing its payload at most slice_bytes per call
+    // to hashSlice(), so that the caller can hand control back to its
+    // scheduler between slices:
+    //
+    //     IncrementalSigner signer(signature, time, request);
+    //     while (!signer.hashSlice())
+    //         co_await scheduler.yield();
+    //     send(signer.authorization());
+    //
+    // The hash state and the header are kept in the object itself, so once
+    // the signing key of the day is derived nothing is allocated, per slice
+    // or otherwise. The views, the header array and the payload of request
+    // must stay valid until the signer is done.
+    class IncrementalSigner
+    {
+        public:
+            static const size_t kDefaultSliceBytes = 64 * 1024;
+            static const size_t kMaxAuthorizationLength = 4096;
+
+            // The signer must outlive the IncrementalSigner. slice_bytes 0
+            // hashes the whole payload in one slice.
+            IncrementalSigner(
+                const Signature &signature,
+                const RequestTime &time,
+                const SignRequest &request,
+                size_t slice_bytes=kDefaultSliceBytes
+            );
+
+            // Hashes the next slice of the payload, and signs once it is all
+            // hashed. Returns true when done; further calls do nothing.
+            // A request without payload is done after the first call.
+            bool hashSlice();
+
+            bool done() const { return m_done; }
+
+            // Payload bytes hashed so far
+            size_t hashed() const { return m_hashed; }
+
+            // The Authorization header once done, or an empty view if the
+            // request exceeds the limits of Signature::signRequest or
+            // kMaxAuthorizationLength
+            std::string_view authorization() const { return std::string_view(m_authorization, m_authorization_length); }
+
+#ifdef __cpp_impl_coroutine
+            // Awaitable form of hashSlice(), for a scheduler with a member
+            // schedule(std::coroutine_handle<>) that queues a handle to be
+            // resumed later:
+            //
+            //     while (!signer.done())
+            //         co_await signer.step(scheduler);
+            //
+            // Each co_await hashes one slice. While payload remains, the
+            // coroutine is suspended and handed to the scheduler, so that
+            // everything queued there before it runs ahead of the next slice.
+            // The last slice completes without suspending, and evaluates to
+            // true. Keep the co_await out of loop and if conditions, which
+            // GCC 12 resumes with a corrupt frame.
+            template <typename Scheduler>
+            class Step
+            {
+                public:
+                    Step(IncrementalSigner &signer, Scheduler &scheduler) : m_signer(signer), m_scheduler(scheduler), m_done(false) {}
+
+                    bool await_ready()
+                    {
+                        m_done = m_signer.hashSlice();
+                        return m_done;
+                    }
+
+                    void await_suspend(std::coroutine_handle<> handle) { m_scheduler.schedule(handle); }
+
+                    bool await_resume() const { return m_done; }
+
+                private:
+                    IncrementalSigner &m_signer;
+                    Scheduler &m_scheduler;
+                    bool m_done;
+            };
+
+            template <typename Scheduler>
+            Step<Scheduler> step(Scheduler &scheduler) { return Step<Scheduler>(*this, scheduler); }
+#endif
+
+        private:
+            const Signature &m_signature;
+            RequestTime m_time;
+            SignRequest m_request;
+            size_t m_slice_bytes;
+            Sha256 m_sha256;
+            size_t m_hashed;
+            bool m_done;
+            char m_authorization[kMaxAuthorizationLength];
+            size_t m_authorization_length;
+
+            IncrementalSigner(const IncrementalSigner &);
+            IncrementalSigner &operator=(const IncrementalSigner &);
+    };
+
+}
+
+#endif
@@ -0,0 +1,214 @@
+#include "awssigv4_multipart.h"
+#include "awssigv4_stats.h"
+#include "awssigv4_text.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace aws_sigv4 {
+
+    MultipartSigner::MultipartSigner(
+        const Signature &signature,
+        size_t part_size,
+        size_t thread_count
+    ) : m_signature(signature), m_part_size(effectivePartSize(part_size)), m_thread_count(thread_count)
+    {
+        if (m_thread_count == 0)
+            m_thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    size_t MultipartSigner::effectivePartSize(size_t part_size)
+    {
+        if (part_size == 0)
+            return kDefaultPartSize;
+        if (part_size < kMinPartSize)
+            return kMinPartSize;
+        return part_size;
+    }
+
+    uint64_t MultipartSigner::partCount(uint64_t object_size, size_t part_size)
+    {
+        part_size = effectivePartSize(part_size);
+        if (object_size == 0)
+            return 1;
+
+        return (object_size + part_size - 1) / part_size;
+    }
+
+    size_t MultipartSigner::partSize() const
+    {
+        return m_part_size;
+    }
+
+    size_t MultipartSigner::threadCount() const
+    {
+        return m_thread_count;
+    }
+
+    bool MultipartSigner::signParts(
+        const RequestTime &time,
+        std::string_view canonical_uri,
+        std::string_view upload_id,
+        const HeaderField *headers,
+        size_t header_count,
+        std::string_view data,
+        std::vector<Part> &parts
+    ) const
+    {
+        PartReader read_part = [data](uint64_t offset, uint64_t length, Sha256 &sha256, std::vector<char> &) {
+            sha256.update(data.data() + offset, length);
+            return true;
+        };
+        return signAll(time, canonical_uri, upload_id, headers, header_count, data.size(), read_part, parts);
+    }
+
+    bool MultipartSigner::signFile(
+        const RequestTime &time,
+        std::string_view canonical_uri,
+        std::string_view upload_id,
+        const HeaderField *headers,
+        size_t header_count,
+        const char *path,
+        std::vector<Part> &parts
+    ) const
+    {
+        parts.clear();
+
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0)
+        {
+            close(fd);
+            return false;
+        }
+
+        // Workers read their parts with pread, which leaves the shared file
+        // offset alone
+        PartReader read_part = [fd](uint64_t offset, uint64_t length, Sha256 &sha256, std::vector<char> &buffer) {
+            buffer.resize(kReadSize);
+            while (length > 0)
+            {
+                ssize_t read_length = pread(fd, buffer.data(), std::min<uint64_t>(length, buffer.size()), offset);
+                if (read_length < 0 && errno == EINTR)
+                    continue;
+                if (read_length <= 0)
+                    return false;
+
+                sha256.update(buffer.data(), read_length);
+                offset += read_length;
+                length -= read_length;
+            }
+            return true;
+        };
+
+        bool signed_all = signAll(time, canonical_uri, upload_id, headers, header_count, file_stat.st_size, read_part, parts);
+        close(fd);
+        return signed_all;
+    }
+
+    bool MultipartSigner::signAll(
+        const RequestTime &time,
+        std::string_view canonical_uri,
+        std::string_view upload_id,
+        const HeaderField *headers,
+        size_t header_count,
+        uint64_t object_size,
+        const PartReader &read_part,
+        std::vector<Part> &parts
+    ) const
+    {
+        parts.clear();
+
+        uint64_t part_count = partCount(object_size, m_part_size);
+        if (part_count > kMaxParts)
+            return false;
+
+        parts.resize(part_count);
+        for (size_t i = 0; i < parts.size(); i++)
+        {
+            Part &part = parts[i];
+            part.part_number = i + 1;
+            part.offset = (uint64_t)i * m_part_size;
+            part.length = std::min<uint64_t>(m_part_size, object_size - part.offset);
+        }
+
+        // The key is derived once for every part and thread
+        SigningKey signing_key;
+        m_signature.loadSigningKey(time, signing_key);
+
+        std::atomic<size_t> next_part(0);
+        std::atomic<bool> failed(false);
+
+        auto worker = [&]() {
+            std::vector<char> buffer;
+            std::vector<HeaderField> part_headers(headers, headers + header_count);
+            part_headers.resize(header_count + 2);
+            part_headers[header_count + 1].name = "x-amz-date";
+            part_headers[header_count + 1].value = std::string_view(time.amzdate, sizeof(time.amzdate) - 1);
+
+            std::string query;
+
+            while (!failed.load(std::memory_order_relaxed))
+            {
+                size_t i = next_part.fetch_add(1, std::memory_order_relaxed);
+                if (i >= parts.size())
+                    return;
+                Part &part = parts[i];
+
+                // Step 1.6: payload hash of the part
+                AWSSIGV4_STAGE_BEGIN(kStagePayloadHash);
+                Sha256 sha256;
+                if (!read_part(part.offset, part.length, sha256, buffer))
+                {
+                    failed = true;
+                    return;
+                }
+                unsigned char digest[kSha256DigestLength];
+                sha256.final(digest);
+                part.payload_hash.resize(2 * kSha256DigestLength);
+                TextKernels::best().hexEncode(digest, sizeof(digest), &part.payload_hash[0]);
+                AWSSIGV4_STAGE_END(kStagePayloadHash, part.length);
+
+                part_headers[header_count].name = "x-amz-content-sha256";
+                part_headers[header_count].value = part.payload_hash;
+
+                query = "partNumber=";
+                query += std::to_string(part.part_number);
+                query += "&uploadId=";
+                query += upload_id;
+
+                SignRequest request = {"PUT", canonical_uri, query, part_headers.data(), part_headers.size(), std::string_view()};
+                if (!m_signature.signWithPayloadHash(signing_key, time, request, part.payload_hash, part.authorization))
+                {
+                    failed = true;
+                    return;
+                }
+            }
+        };
+
+        // The calling thread is one of the workers
+        size_t thread_count = std::min<uint64_t>(m_thread_count, part_count);
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < thread_count; t++)
+            threads.push_back(std::thread(worker));
+        worker();
+        for (size_t t = 0; t < threads.size(); t++)
+            threads[t].join();
+
+        if (failed)
+        {
+            parts.clear();
+            return false;
+        }
+        return true;
+    }
+
+}
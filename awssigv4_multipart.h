@@ -0,0 +1,124 @@
+// Sign the parts of an S3 multipart upload (UploadPart), each with its own
+// payload hash
+// http://docs.aws.amazon.com/AmazonS3/latest/API/mpUploadUploadPart.html
+
+#ifndef AWSSIGV4_MULTIPART_H
+#define AWSSIGV4_MULTIPART_H
+
+#include <functional>
+#include "awssigv4.h"
+
+namespace aws_sigv4 {
+
+    // Splits an object into parts of part_size bytes (the last one shorter)
+    // and hashes and signs them on a pool of up to thread_count threads, the
+    // calling thread included. Workers take the next part as they become
+    // free, so one slow part does not hold the others back; results land in
+    // part order whatever order they finish in.
+    //
+    // Usage:
+    //   RequestTime time;
+    //   signature.requestTime(time);
+    //   MultipartSigner multipart(signature);
+    //   multipart.signFile(time, "/bucket/key", upload_id, headers, 1, path, parts);
+    //   then for each part, PUT /bucket/key?partNumber=<part_number>&uploadId=<upload_id>
+    //   with the headers given, x-amz-content-sha256: <payload_hash>,
+    //   x-amz-date: <time.amzdate> and Authorization: <authorization>
+    //
+    // Signing a file holds one read buffer of kReadSize bytes per thread,
+    // whatever the part size. Immutable once built, so one MultipartSigner
+    // may sign any number of uploads at once; the signer must outlive it.
+    class MultipartSigner
+    {
+        public:
+            static const size_t kDefaultPartSize = 8 * 1024 * 1024;
+            // Smallest part S3 accepts, except for the last one
+            static const size_t kMinPartSize = 5 * 1024 * 1024;
+            static const size_t kMaxParts = 10000;
+            // Bytes a worker reads from a file at a time
+            static const size_t kReadSize = 1024 * 1024;
+
+            struct Part
+            {
+                // From 1, as in the partNumber parameter
+                size_t part_number;
+                uint64_t offset;
+                uint64_t length;
+                // Lowercase hex SHA-256 of the part, for x-amz-content-sha256
+                std::string payload_hash;
+                std::string authorization;
+            };
+
+            // part_size 0 is kDefaultPartSize, and a part_size below
+            // kMinPartSize is raised to it. thread_count 0 runs one thread
+            // per core.
+            explicit MultipartSigner(
+                const Signature &signature,
+                size_t part_size=kDefaultPartSize,
+                size_t thread_count=0
+            );
+
+            // Number of parts of an object, 1 for an empty one, with
+            // part_size taken as the constructor does
+            static uint64_t partCount(uint64_t object_size, size_t part_size=kDefaultPartSize);
+
+            size_t partSize() const;
+            size_t threadCount() const;
+
+            // Sign every part of data, as PUT requests for canonical_uri with
+            // the headers given (Host at least) plus x-amz-content-sha256 and
+            // x-amz-date, which the caller must not pass. upload_id goes into
+            // the query string as is, and is encoded as signRequest would.
+            // Returns false with parts empty if data needs more than
+            // kMaxParts parts or a part exceeds the limits of signRequest.
+            bool signParts(
+                const RequestTime &time,
+                std::string_view canonical_uri,
+                std::string_view upload_id,
+                const HeaderField *headers,
+                size_t header_count,
+                std::string_view data,
+                std::vector<Part> &parts
+            ) const;
+
+            // Same for the contents of a file, read by the workers. Also
+            // returns false if the file cannot be opened or read.
+            bool signFile(
+                const RequestTime &time,
+                std::string_view canonical_uri,
+                std::string_view upload_id,
+                const HeaderField *headers,
+                size_t header_count,
+                const char *path,
+                std::vector<Part> &parts
+            ) const;
+
+        private:
+            const Signature &m_signature;
+            size_t m_part_size;
+            size_t m_thread_count;
+
+            MultipartSigner(const MultipartSigner &);
+            MultipartSigner &operator=(const MultipartSigner &);
+
+            static size_t effectivePartSize(size_t part_size);
+
+            // Feeds the length bytes at offset into sha256, using buffer as
+            // it likes; false on a read error. Called from every worker.
+            typedef std::function<bool(uint64_t offset, uint64_t length, Sha256 &sha256, std::vector<char> &buffer)> PartReader;
+
+            bool signAll(
+                const RequestTime &time,
+                std::string_view canonical_uri,
+                std::string_view upload_id,
+                const HeaderField *headers,
+                size_t header_count,
+                uint64_t object_size,
+                const PartReader &read_part,
+                std::vector<Part> &parts
+            ) const;
+    };
+
+}
+
+#endif
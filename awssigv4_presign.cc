@@ -0,0 +1,137 @@
+#include "awssigv4_presign.h"
+#include "awssigv4_uri.h"
+
+namespace aws_sigv4 {
+
+    Presigner::Presigner(const Signature &signature, unsigned expires)
+        : m_signature(signature), m_expires(expires)
+    {
+        if (m_expires == 0 || m_expires > kMaxExpires)
+            m_expires = kMaxExpires;
+
+        m_credential_prefix = "X-Amz-Algorithm=AWS4-HMAC-SHA256&X-Amz-Credential=";
+        appendUriEncoded(m_credential_prefix, m_signature.m_access_key + "/", true);
+        appendUriEncoded(m_date_prefix, m_signature.m_scope_suffix, true);
+        m_date_prefix += "&X-Amz-Date=";
+        m_query_suffix = "&X-Amz-Expires=" + std::to_string(m_expires) + "&X-Amz-SignedHeaders=host";
+    }
+
+    std::string Presigner::queryPrefix(const RequestTime &time) const
+    {
+        // The datestamp and amzdate are digits and a T, which need no encoding
+        return m_credential_prefix + time.datestamp + m_date_prefix + time.amzdate + m_query_suffix;
+    }
+
+    std::string Presigner::signCanonicalRequest(const RequestTime &time, const SigningKey &signing_key, Sha256 &sha256) const
+    {
+        unsigned char digest[kSha256DigestLength];
+        sha256.final(digest);
+
+        std::string string_to_sign = std::string("AWS4-HMAC-SHA256\n") + time.amzdate + "\n" + time.datestamp + m_signature.m_scope_suffix + "\n" +
+            m_signature.hexlify(digest);
+        m_signature.signWithKey(signing_key, string_to_sign, digest);
+
+        return m_signature.hexlify(digest);
+    }
+
+    std::string Presigner::presign(
+        const std::string &method,
+        const std::string &canonical_uri,
+        const std::string &querystring) const
+    {
+        RequestTime time;
+        m_signature.requestTime(time);
+        return presign(time, method, canonical_uri, querystring);
+    }
+
+    std::string Presigner::presign(
+        const RequestTime &time,
+        const std::string &method,
+        const std::string &canonical_uri,
+        const std::string &querystring) const
+    {
+        std::string full_query = queryPrefix(time);
+        if (!querystring.empty())
+            full_query += "&" + querystring;
+
+        // The URL carries the path encoded once even where the signature
+        // covers it encoded twice
+        UriNormalization uri_normalization = m_signature.m_uri_normalization;
+        std::string url_path, canonical_path;
+        appendCanonicalUri(url_path, canonical_uri, uri_normalization == kUriNormalizeDoubleEncode ? kUriNormalize : uri_normalization);
+        appendCanonicalUri(canonical_path, canonical_uri, uri_normalization);
+        std::string canonical_querystring = m_signature.createCanonicalQueryString(full_query);
+        std::string canonical_request = method + "\n" + canonical_path + "\n" + canonical_querystring + "\n" +
+            "host:" + m_signature.m_host + "\n\nhost\nUNSIGNED-PAYLOAD";
+
+        Sha256 sha256;
+        sha256.update(canonical_request);
+
+        SigningKey signing_key;
+        m_signature.loadSigningKey(time, signing_key);
+
+        return "https://" + m_signature.m_host + url_path + "?" + canonical_querystring + "&X-Amz-Signature=" + signCanonicalRequest(time, signing_key, sha256);
+    }
+
+    std::vector<std::string> Presigner::presignGetObjects(
+        const std::string &bucket,
+        const std::vector<std::string> &object_keys) const
+    {
+        RequestTime time;
+        m_signature.requestTime(time);
+        return presignGetObjects(time, bucket, object_keys);
+    }
+
+    std::vector<std::string> Presigner::presignGetObjects(
+        const RequestTime &time,
+        const std::string &bucket,
+        const std::vector<std::string> &object_keys) const
+    {
+        // Every URL of the batch shares the date, the key and everything in
+        // the canonical request after the canonical URI
+        std::string query_prefix = queryPrefix(time);
+        std::string canonical_suffix = "\n" + query_prefix + "\nhost:" + m_signature.m_host + "\n\nhost\nUNSIGNED-PAYLOAD";
+        SigningKey signing_key;
+        m_signature.loadSigningKey(time, signing_key);
+
+        std::vector<std::string> urls;
+        urls.reserve(object_keys.size());
+
+        std::string uri_prefix = "/";
+        if (!bucket.empty())
+        {
+            appendUriEncoded(uri_prefix, bucket, true);
+            uri_prefix += "/";
+        }
+
+        std::string url_prefix = "https://" + m_signature.m_host;
+        std::string encoded_uri;
+
+        for (std::vector<std::string>::const_iterator it = object_keys.begin(); it != object_keys.end(); it++)
+        {
+            encoded_uri = uri_prefix;
+            appendUriEncoded(encoded_uri, *it, false);
+
+            // The canonical request only differs by its URI, so hash the
+            // pieces instead of assembling it
+            Sha256 sha256;
+            sha256.update("GET\n", 4);
+            sha256.update(encoded_uri);
+            sha256.update(canonical_suffix);
+
+            std::string url;
+            url.reserve(url_prefix.length() + encoded_uri.length() + query_prefix.length() + 18 + 64);
+            url += url_prefix;
+            url += encoded_uri;
+            url += '?';
+            url += query_prefix;
+            url += "&X-Amz-Signature=";
+            url += signCanonicalRequest(time, signing_key, sha256);
+
+            urls.push_back(url);
+        }
+
+        return urls;
+    }
+
+}
@@ -0,0 +1,78 @@
+// Presigned URLs (query string authentication)
+// http://docs.aws.amazon.com/AmazonS3/latest/API/sigv4-query-string-auth.html
+
+#ifndef AWSSIGV4_PRESIGN_H
+#define AWSSIGV4_PRESIGN_H
+
+#include "awssigv4.h"
+
+namespace aws_sigv4 {
+
+    // Builds presigned URLs carrying X-Amz-Algorithm, X-Amz-Credential,
+    // X-Amz-Date, X-Amz-Expires, X-Amz-SignedHeaders and X-Amz-Signature in
+    // the query string. Only the host header is signed and the payload is
+    // UNSIGNED-PAYLOAD. URLs are dated at the RequestTime given, or at the
+    // signer's requestTime() for the overloads without one, so a long-lived
+    // Presigner on a signer with a TimestampCache keeps issuing current
+    // URLs. The encoded parts of the query that do not depend on the time
+    // are computed once. Immutable once built; the signer must outlive it.
+    class Presigner
+    {
+        public:
+            static const unsigned kMaxExpires = 7 * 24 * 60 * 60;
+
+            Presigner(const Signature &signature, unsigned expires=86400);
+
+            // https://<host><uri>?<query with X-Amz-*>. canonical_uri and
+            // querystring are encoded as the signer's createCanonicalRequest
+            // would, so they may be given encoded or not.
+            std::string presign(
+                const RequestTime &time,
+                const std::string &method,
+                const std::string &canonical_uri,
+                const std::string &querystring=""
+            ) const;
+
+            std::string presign(
+                const std::string &method,
+                const std::string &canonical_uri,
+                const std::string &querystring=""
+            ) const;
+
+            // GET URLs for many objects of one bucket, all dated at time. The
+            // objects are addressed as /<bucket>/<key>, or as /<key> when
+            // bucket is empty and the signer's host is the bucket's virtual
+            // host. Keys are raw and URI-encoded here.
+            std::vector<std::string> presignGetObjects(
+                const RequestTime &time,
+                const std::string &bucket,
+                const std::vector<std::string> &object_keys
+            ) const;
+
+            std::vector<std::string> presignGetObjects(
+                const std::string &bucket,
+                const std::vector<std::string> &object_keys
+            ) const;
+
+        private:
+            const Signature &m_signature;
+            unsigned m_expires;
+
+            // X-Amz-* parameters before X-Amz-Signature, already encoded,
+            // split around the datestamp and the amzdate:
+            // "X-Amz-Algorithm=AWS4-HMAC-SHA256&X-Amz-Credential=<access key>%2F",
+            // "%2F<region>%2F<service>%2Faws4_request&X-Amz-Date=" and
+            // "&X-Amz-Expires=<expires>&X-Amz-SignedHeaders=host"
+            std::string m_credential_prefix, m_date_prefix, m_query_suffix;
+
+            Presigner(const Presigner &);
+            Presigner &operator=(const Presigner &);
+
+            std::string queryPrefix(const RequestTime &time) const;
+
+            std::string signCanonicalRequest(const RequestTime &time, const SigningKey &signing_key, Sha256 &sha256) const;
+    };
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+#include "awssigv4_replay.h"
+
+namespace aws_sigv4 {
+
+    // Buckets per window: finer buckets expire signatures closer to their
+    // deadline, at the cost of more, smaller tables
+    static const time_t kBucketsPerWindow = 8;
+
+    static size_t roundUpPowerOfTwo(size_t n)
+    {
+        size_t power = 1;
+        while (power < n)
+            power <<= 1;
+        return power;
+    }
+
+    ReplayCache::ReplayCache(time_t window, size_t capacity, size_t shard_count)
+    {
+        m_window = window > 0 ? window : 1;
+        m_bucket_seconds = std::max<time_t>(1, m_window / kBucketsPerWindow);
+
+        // A signature dated t can be replayed until now passes t + window,
+        // and until then requests dated up to t + 2 * window are accepted:
+        // their buckets must not wrap around onto t's
+        m_bucket_count = 2 * m_window / m_bucket_seconds + 2;
+
+        shard_count = roundUpPowerOfTwo(std::max<size_t>(1, shard_count));
+        m_shard_mask = shard_count - 1;
+
+        // Open addressing at no more than three quarters full
+        size_t live_buckets = shard_count * (m_bucket_count - 1);
+        size_t per_bucket = std::max<size_t>(1, (capacity + live_buckets - 1) / live_buckets);
+        size_t table_size = roundUpPowerOfTwo(per_bucket + per_bucket / 3 + 1);
+        m_table_mask = table_size - 1;
+        m_max_load = table_size * 3 / 4;
+
+        m_shards = std::vector<Shard>(shard_count);
+        Bucket empty = {INT64_MIN, 0};
+        m_buckets.assign(shard_count * m_bucket_count, empty);
+        Fingerprint zero = {0, 0};
+        m_fingerprints.assign(m_buckets.size() * table_size, zero);
+    }
+
+    time_t ReplayCache::window() const
+    {
+        return m_window;
+    }
+
+    size_t ReplayCache::memoryBytes() const
+    {
+        return m_fingerprints.size() * sizeof(Fingerprint) + m_buckets.size() * sizeof(Bucket) + m_shards.size() * sizeof(Shard);
+    }
+
+    ReplayCache::Fingerprint ReplayCache::fingerprint(const unsigned char signature[kSha256DigestLength])
+    {
+        Fingerprint key;
+        memcpy(&key.low, signature, sizeof(key.low));
+        memcpy(&key.high, signature + sizeof(key.low), sizeof(key.high));
+        if (key.low == 0 && key.high == 0)
+            key.low = 1;
+        return key;
+    }
+
+    size_t ReplayCache::locate(const Fingerprint &key, time_t request_time, int64_t &time_slot, size_t &shard) const
+    {
+        // Floored, so that times before 1970 get slots of their own and a
+        // bucket index in range
+        time_slot = request_time / m_bucket_seconds;
+        if (request_time % m_bucket_seconds < 0)
+            time_slot--;
+        int64_t bucket = time_slot % (int64_t)m_bucket_count;
+        if (bucket < 0)
+            bucket += m_bucket_count;
+        shard = key.high & m_shard_mask;
+        return shard * m_bucket_count + (size_t)bucket;
+    }
+
+    ReplayCache::Result ReplayCache::insert(const unsigned char signature[kSha256DigestLength], time_t request_time)
+    {
+        Fingerprint key = fingerprint(signature);
+        int64_t time_slot;
+        size_t shard;
+        size_t bucket_index = locate(key, request_time, time_slot, shard);
+
+        std::lock_guard<std::mutex> lock(m_shards[shard].mutex);
+        Bucket &bucket = m_buckets[bucket_index];
+        Fingerprint *table = &m_fingerprints[bucket_index * (m_table_mask + 1)];
+
+        if (bucket.time_slot != time_slot)
+        {
+            if (bucket.time_slot > time_slot)
+                return kNotRecorded;
+
+            // Everything in it is from at least window * 2 seconds earlier
+            memset(table, 0, (m_table_mask + 1) * sizeof(Fingerprint));
+            bucket.time_slot = time_slot;
+            bucket.count = 0;
+        }
+
+        for (size_t probe = key.low & m_table_mask; ; probe = (probe + 1) & m_table_mask)
+        {
+            Fingerprint &entry = table[probe];
+            if (entry.low == key.low && entry.high == key.high)
+                return kReplayed;
+            if (entry.low == 0 && entry.high == 0)
+            {
+                if (bucket.count == m_max_load)
+                    return kNotRecorded;
+                entry = key;
+                bucket.count++;
+                return kFirstSeen;
+            }
+        }
+    }
+
+    bool ReplayCache::contains(const unsigned char signature[kSha256DigestLength], time_t request_time) const
+    {
+        Fingerprint key = fingerprint(signature);
+        int64_t time_slot;
+        size_t shard;
+        size_t bucket_index = locate(key, request_time, time_slot, shard);
+
+        std::lock_guard<std::mutex> lock(m_shards[shard].mutex);
+        if (m_buckets[bucket_index].time_slot != time_slot)
+            return false;
+
+        const Fingerprint *table = &m_fingerprints[bucket_index * (m_table_mask + 1)];
+        for (size_t probe = key.low & m_table_mask; ; probe = (probe + 1) & m_table_mask)
+        {
+            const Fingerprint &entry = table[probe];
+            if (entry.low == key.low && entry.high == key.high)
+                return true;
+            if (entry.low == 0 && entry.high == 0)
+                return false;
+        }
+    }
+
+}
@@ -0,0 +1,102 @@
+// Memory of recently verified signatures, to turn away replayed requests
+
+#ifndef AWSSIGV4_REPLAY_H
+#define AWSSIGV4_REPLAY_H
+
+#include <mutex>
+#include <vector>
+
+#include "awssigv4.h"
+
+namespace aws_sigv4 {
+
+    // Set of the signatures of requests dated within window seconds of now.
+    // Signatures are grouped into buckets by request time: a bucket is
+    // emptied when a request from window * 2 seconds later needs it, so
+    // expiry costs nothing per entry and follows the request timestamps
+    // rather than a timer. Buckets are spread over shards, each with its own
+    // lock, by the signature bytes, which HMAC makes uniformly random. All
+    // memory is allocated up front: a flood of unique signatures fills
+    // buckets up to capacity and is then reported as kNotRecorded instead
+    // of growing the set.
+    class ReplayCache
+    {
+        public:
+            // The default skew AWS allows
+            static const time_t kDefaultWindow = 15 * 60;
+            static const size_t kDefaultCapacity = 1 << 18;
+            static const size_t kDefaultShards = 64;
+
+            enum Result
+            {
+                kFirstSeen,
+                kReplayed,
+                // The signature's bucket is full, or request_time is older
+                // than the window the cache can still tell about
+                kNotRecorded
+            };
+
+            // Room for at least capacity signatures per window * 2 seconds
+            // of request times, evenly spread. Shard counts are rounded up to
+            // a power of two.
+            explicit ReplayCache(
+                time_t window=kDefaultWindow,
+                size_t capacity=kDefaultCapacity,
+                size_t shard_count=kDefaultShards
+            );
+
+            time_t window() const;
+
+            // Bytes of signature storage, fixed at construction
+            size_t memoryBytes() const;
+
+            // Records the signature of a request dated request_time, which
+            // the caller has checked is within window of now
+            Result insert(const unsigned char signature[kSha256DigestLength], time_t request_time);
+
+            bool contains(const unsigned char signature[kSha256DigestLength], time_t request_time) const;
+
+        private:
+            // First 128 bits of a signature; all zero marks an empty slot
+            struct Fingerprint
+            {
+                uint64_t low;
+                uint64_t high;
+            };
+
+            struct Bucket
+            {
+                int64_t time_slot;
+                size_t count;
+            };
+
+            struct alignas(64) Shard
+            {
+                mutable std::mutex mutex;
+            };
+
+            time_t m_window;
+            time_t m_bucket_seconds;
+            size_t m_bucket_count;
+            size_t m_table_mask;
+            size_t m_max_load;
+            size_t m_shard_mask;
+
+            std::vector<Shard> m_shards;
+            // m_bucket_count buckets per shard, and m_table_mask + 1
+            // fingerprints per bucket
+            std::vector<Bucket> m_buckets;
+            std::vector<Fingerprint> m_fingerprints;
+
+            ReplayCache(const ReplayCache &);
+            ReplayCache &operator=(const ReplayCache &);
+
+            static Fingerprint fingerprint(const unsigned char signature[kSha256DigestLength]);
+
+            // Shard and bucket of a signature, with its fingerprint and slot
+            size_t locate(const Fingerprint &key, time_t request_time, int64_t &time_slot, size_t &shard) const;
+    };
+
+}
+
+#endif
@@ -0,0 +1,413 @@
+#include "awssigv4_sha256.h"
+
+#include <string.h>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AWSSIGV4_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace aws_sigv4 {
+
+    static inline uint32_t loadBigEndian32(const unsigned char *p)
+    {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+    }
+
+    static inline void storeBigEndian32(unsigned char *p, uint32_t v)
+    {
+        p[0] = v >> 24;
+        p[1] = v >> 16;
+        p[2] = v >> 8;
+        p[3] = v;
+    }
+
+    // One message as the compression function sees it: whole blocks are read
+    // in place, the last one or two blocks with the padding live in tail
+    struct LaneMessage
+    {
+        const unsigned char *data;
+        size_t full_blocks;
+        size_t blocks;
+        unsigned char tail[128];
+
+        void init(std::string_view message, uint64_t prefix_length)
+        {
+            data = (const unsigned char *)message.data();
+            full_blocks = message.length() / 64;
+
+            size_t remainder = message.length() % 64;
+            size_t tail_length = remainder + 9 <= 64 ? 64 : 128;
+            memset(tail, 0, tail_length);
+            memcpy(tail, data + full_blocks * 64, remainder);
+            tail[remainder] = 0x80;
+
+            uint64_t bits = (prefix_length + message.length()) * 8;
+            for (int i = 0; i < 8; i++)
+                tail[tail_length - 1 - i] = (unsigned char)(bits >> (8 * i));
+
+            blocks = full_blocks + tail_length / 64;
+        }
+
+        const unsigned char *block(size_t index) const
+        {
+            if (index < full_blocks)
+                return data + index * 64;
+            return tail + (index - full_blocks) * 64;
+        }
+    };
+
+    // Compression of one block per lane. state and words are laid out
+    // [word][lane]; lanes whose bit is clear in active keep their state.
+    template <size_t Lanes>
+    struct CompressFunction
+    {
+        typedef void (*Type)(uint32_t state[8][Lanes], const uint32_t words[16][Lanes], uint32_t active);
+    };
+
+#ifdef AWSSIGV4_X86_KERNELS
+
+#define AVX2_ROTR(x, n) _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+
+    __attribute__((target("avx2")))
+    static void compressAvx2(uint32_t state[8][8], const uint32_t words[16][8], uint32_t active)
+    {
+        __m256i w[64];
+        for (int t = 0; t < 16; t++)
+            w[t] = _mm256_load_si256((const __m256i *)words[t]);
+        for (int t = 16; t < 64; t++)
+        {
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(AVX2_ROTR(w[t - 15], 7), AVX2_ROTR(w[t - 15], 18)), _mm256_srli_epi32(w[t - 15], 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(AVX2_ROTR(w[t - 2], 17), AVX2_ROTR(w[t - 2], 19)), _mm256_srli_epi32(w[t - 2], 10));
+            w[t] = _mm256_add_epi32(_mm256_add_epi32(w[t - 16], s0), _mm256_add_epi32(w[t - 7], s1));
+        }
+
+        __m256i old[8];
+        for (int i = 0; i < 8; i++)
+            old[i] = _mm256_load_si256((const __m256i *)state[i]);
+
+        __m256i a = old[0], b = old[1], c = old[2], d = old[3];
+        __m256i e = old[4], f = old[5], g = old[6], h = old[7];
+
+        for (int t = 0; t < 64; t++)
+        {
+            __m256i big_s1 = _mm256_xor_si256(_mm256_xor_si256(AVX2_ROTR(e, 6), AVX2_ROTR(e, 11)), AVX2_ROTR(e, 25));
+            __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+            __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, big_s1), _mm256_add_epi32(ch, _mm256_add_epi32(_mm256_set1_epi32(kSha256RoundConstants[t]), w[t])));
+            __m256i big_s0 = _mm256_xor_si256(_mm256_xor_si256(AVX2_ROTR(a, 2), AVX2_ROTR(a, 13)), AVX2_ROTR(a, 22));
+            __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+            __m256i t2 = _mm256_add_epi32(big_s0, maj);
+            h = g;
+            g = f;
+            f = e;
+            e = _mm256_add_epi32(d, t1);
+            d = c;
+            c = b;
+            b = a;
+            a = _mm256_add_epi32(t1, t2);
+        }
+
+        __m256i lane_bits = _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+        __m256i mask = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(active), lane_bits), lane_bits);
+
+        __m256i result[8] = {a, b, c, d, e, f, g, h};
+        for (int i = 0; i < 8; i++)
+            _mm256_store_si256((__m256i *)state[i], _mm256_blendv_epi8(old[i], _mm256_add_epi32(old[i], result[i]), mask));
+    }
+
+#undef AVX2_ROTR
+
+// GCC 12 reports the placeholder operand of its own AVX-512 intrinsics as
+// used uninitialized at -O2
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+
+    __attribute__((target("avx512f")))
+    static void compressAvx512(uint32_t state[8][16], const uint32_t words[16][16], uint32_t active)
+    {
+        __m512i w[64];
+        for (int t = 0; t < 16; t++)
+            w[t] = _mm512_load_si512((const void *)words[t]);
+        for (int t = 16; t < 64; t++)
+        {
+            __m512i s0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(w[t - 15], 7), _mm512_ror_epi32(w[t - 15], 18), _mm512_srli_epi32(w[t - 15], 3), 0x96);
+            __m512i s1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(w[t - 2], 17), _mm512_ror_epi32(w[t - 2], 19), _mm512_srli_epi32(w[t - 2], 10), 0x96);
+            w[t] = _mm512_add_epi32(_mm512_add_epi32(w[t - 16], s0), _mm512_add_epi32(w[t - 7], s1));
+        }
+
+        __m512i old[8];
+        for (int i = 0; i < 8; i++)
+            old[i] = _mm512_load_si512((const void *)state[i]);
+
+        __m512i a = old[0], b = old[1], c = old[2], d = old[3];
+        __m512i e = old[4], f = old[5], g = old[6], h = old[7];
+
+        for (int t = 0; t < 64; t++)
+        {
+            __m512i big_s1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(e, 6), _mm512_ror_epi32(e, 11), _mm512_ror_epi32(e, 25), 0x96);
+            __m512i ch = _mm512_ternarylogic_epi32(e, f, g, 0xca);
+            __m512i t1 = _mm512_add_epi32(_mm512_add_epi32(h, big_s1), _mm512_add_epi32(ch, _mm512_add_epi32(_mm512_set1_epi32(kSha256RoundConstants[t]), w[t])));
+            __m512i big_s0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(a, 2), _mm512_ror_epi32(a, 13), _mm512_ror_epi32(a, 22), 0x96);
+            __m512i maj = _mm512_ternarylogic_epi32(a, b, c, 0xe8);
+            __m512i t2 = _mm512_add_epi32(big_s0, maj);
+            h = g;
+            g = f;
+            f = e;
+            e = _mm512_add_epi32(d, t1);
+            d = c;
+            c = b;
+            b = a;
+            a = _mm512_add_epi32(t1, t2);
+        }
+
+        __m512i result[8] = {a, b, c, d, e, f, g, h};
+        for (int i = 0; i < 8; i++)
+            _mm512_store_si512((void *)state[i], _mm512_mask_add_epi32(old[i], (__mmask16)active, old[i], result[i]));
+    }
+
+#pragma GCC diagnostic pop
+
+#endif
+
+    // Hash up to Lanes messages, one per lane, until the longest is done
+    template <size_t Lanes>
+    static void hashLanes(
+        typename CompressFunction<Lanes>::Type compress,
+        const Sha256Midstate *initial,
+        const std::string_view *messages,
+        size_t count,
+        unsigned char (*digests)[MultiBufferSha256::kDigestLength])
+    {
+        LaneMessage lanes[Lanes];
+        alignas(64) uint32_t state[8][Lanes];
+        alignas(64) uint32_t words[16][Lanes];
+
+        const uint32_t *initial_state = initial != NULL ? initial->h : kSha256InitialState;
+        uint64_t prefix_length = initial != NULL ? initial->length : 0;
+
+        size_t max_blocks = 0;
+        for (size_t lane = 0; lane < Lanes; lane++)
+        {
+            for (int i = 0; i < 8; i++)
+                state[i][lane] = initial_state[i];
+
+            if (lane < count)
+            {
+                lanes[lane].init(messages[lane], prefix_length);
+                max_blocks = std::max(max_blocks, lanes[lane].blocks);
+            }
+            else
+            {
+                lanes[lane].blocks = 0;
+            }
+        }
+
+        for (size_t block = 0; block < max_blocks; block++)
+        {
+            uint32_t active = 0;
+            for (size_t lane = 0; lane < Lanes; lane++)
+            {
+                if (block < lanes[lane].blocks)
+                {
+                    // Transpose the block into word-major order, one column per lane
+                    const unsigned char *p = lanes[lane].block(block);
+                    for (int t = 0; t < 16; t++)
+                        words[t][lane] = loadBigEndian32(p + 4 * t);
+                    active |= 1u << lane;
+                }
+                else
+                {
+                    for (int t = 0; t < 16; t++)
+                        words[t][lane] = 0;
+                }
+            }
+
+            compress(state, words, active);
+        }
+
+        for (size_t lane = 0; lane < count; lane++)
+            for (int i = 0; i < 8; i++)
+                storeBigEndian32(digests[lane] + 4 * i, state[i][lane]);
+    }
+
+    MultiBufferSha256::Kernel MultiBufferSha256::bestKernel()
+    {
+        if (supported(kAvx512))
+            return kAvx512;
+        if (supported(kAvx2))
+            return kAvx2;
+        return kScalar;
+    }
+
+    bool MultiBufferSha256::supported(Kernel kernel)
+    {
+        switch (kernel)
+        {
+            case kScalar:
+                return true;
+#ifdef AWSSIGV4_X86_KERNELS
+            case kAvx2:
+                return __builtin_cpu_supports("avx2");
+            case kAvx512:
+                return __builtin_cpu_supports("avx512f");
+#endif
+            default:
+                return false;
+        }
+    }
+
+    const char *MultiBufferSha256::kernelName(Kernel kernel)
+    {
+        switch (kernel)
+        {
+            case kAvx2:
+                return "avx2";
+            case kAvx512:
+                return "avx512";
+            default:
+                return "scalar";
+        }
+    }
+
+    MultiBufferSha256::MultiBufferSha256(Kernel kernel)
+    {
+        m_kernel = supported(kernel) ? kernel : kScalar;
+    }
+
+    MultiBufferSha256::Kernel MultiBufferSha256::kernel() const
+    {
+        return m_kernel;
+    }
+
+    size_t MultiBufferSha256::lanes() const
+    {
+        switch (m_kernel)
+        {
+            case kAvx2:
+                return 8;
+            case kAvx512:
+                return 16;
+            default:
+                return 1;
+        }
+    }
+
+    void MultiBufferSha256::hash(
+        const std::string_view *messages,
+        size_t count,
+        unsigned char (*digests)[kDigestLength]) const
+    {
+        hashFrom(NULL, messages, count, digests);
+    }
+
+    void MultiBufferSha256::hash(
+        const Sha256Midstate &initial,
+        const std::string_view *messages,
+        size_t count,
+        unsigned char (*digests)[kDigestLength]) const
+    {
+        hashFrom(&initial, messages, count, digests);
+    }
+
+    // Messages longer than this are hashed on their own: a long lane keeps
+    // every other lane of its group idle until it is done
+    static const size_t kMaxLaneBlocks = 64;
+
+    // Messages sorted by length at a time to find lanes of similar length
+    static const size_t kGatherCount = 64;
+
+    // Blocks in a message once padded, as LaneMessage lays it out
+    static inline size_t paddedBlocks(size_t length)
+    {
+        return length / 64 + (length % 64 + 9 <= 64 ? 1 : 2);
+    }
+
+    static void hashOne(
+        const Sha256Midstate *initial,
+        std::string_view message,
+        unsigned char digest[MultiBufferSha256::kDigestLength])
+    {
+        Sha256 sha256 = initial != NULL ? Sha256(*initial) : Sha256();
+        sha256.update(message);
+        sha256.final(digest);
+    }
+
+    void MultiBufferSha256::hashFrom(
+        const Sha256Midstate *initial,
+        const std::string_view *messages,
+        size_t count,
+        unsigned char (*digests)[kDigestLength]) const
+    {
+        size_t lane_count = lanes();
+        if (lane_count == 1)
+        {
+            for (size_t i = 0; i < count; i++)
+                hashOne(initial, messages[i], digests[i]);
+            return;
+        }
+
+        for (size_t start = 0; start < count; start += kGatherCount)
+        {
+            size_t gather = std::min(count - start, kGatherCount);
+            const std::string_view *batch = messages + start;
+            unsigned char (*batch_digests)[kDigestLength] = digests + start;
+
+            // Long messages go to the single-stream backend (SHA-NI or
+            // scalar), the rest are ordered by length
+            size_t blocks[kGatherCount];
+            size_t order[kGatherCount];
+            size_t ordered = 0;
+            for (size_t i = 0; i < gather; i++)
+            {
+                blocks[i] = paddedBlocks(batch[i].length());
+                if (blocks[i] > kMaxLaneBlocks)
+                    hashOne(initial, batch[i], batch_digests[i]);
+                else
+                    order[ordered++] = i;
+            }
+            std::sort(order, order + ordered, [&blocks](size_t a, size_t b) { return blocks[a] < blocks[b]; });
+
+            // A group only takes messages at most twice as long as its
+            // shortest, and only runs in lanes when it fills half of them
+            for (size_t first = 0; first < ordered; )
+            {
+                size_t end = first + 1;
+                while (end < ordered && end - first < lane_count && blocks[order[end]] <= 2 * blocks[order[first]])
+                    end++;
+
+                size_t group = end - first;
+                if (2 * group < lane_count)
+                {
+                    hashOne(initial, batch[order[first]], batch_digests[order[first]]);
+                    first++;
+                    continue;
+                }
+
+                std::string_view lane_messages[16];
+                unsigned char lane_digests[16][kDigestLength];
+                for (size_t lane = 0; lane < group; lane++)
+                    lane_messages[lane] = batch[order[first + lane]];
+
+                switch (m_kernel)
+                {
+#ifdef AWSSIGV4_X86_KERNELS
+                    case kAvx2:
+                        hashLanes<8>(compressAvx2, initial, lane_messages, group, lane_digests);
+                        break;
+                    case kAvx512:
+                        hashLanes<16>(compressAvx512, initial, lane_messages, group, lane_digests);
+                        break;
+#endif
+                    default:
+                        break;
+                }
+
+                for (size_t lane = 0; lane < group; lane++)
+                    memcpy(batch_digests[order[first + lane]], lane_digests[lane], kDigestLength);
+                first = end;
+            }
+        }
+    }
+
+}
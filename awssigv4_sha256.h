@@ -0,0 +1,67 @@
+// SHA-256 over many independent messages at once (multi-buffer hashing)
+
+#ifndef AWSSIGV4_SHA256_H
+#define AWSSIGV4_SHA256_H
+
+#include "awssigv4_crypto.h"
+
+namespace aws_sigv4 {
+
+    // Hashes independent messages side by side, one message per SIMD lane:
+    // 8 lanes with AVX2 and 16 with AVX-512. The kernel is picked from what
+    // the CPU supports at runtime; the scalar kernel hashes one message at a
+    // time with the active CryptoBackend and runs anywhere. Only messages of
+    // similar length share lanes; long or unmatched ones are hashed one at a
+    // time with the active CryptoBackend too.
+    class MultiBufferSha256
+    {
+        public:
+            enum Kernel
+            {
+                kScalar,
+                kAvx2,
+                kAvx512
+            };
+
+            static const size_t kDigestLength = 32;
+
+            // Widest kernel this CPU can run
+            static Kernel bestKernel();
+            static bool supported(Kernel kernel);
+            static const char *kernelName(Kernel kernel);
+
+            // Falls back to the scalar kernel if the CPU lacks the one asked for
+            explicit MultiBufferSha256(Kernel kernel=bestKernel());
+
+            Kernel kernel() const;
+            size_t lanes() const;
+
+            // digests[i] = SHA-256(messages[i])
+            void hash(
+                const std::string_view *messages,
+                size_t count,
+                unsigned char (*digests)[kDigestLength]
+            ) const;
+
+            // Same, with every message continuing from initial
+            void hash(
+                const Sha256Midstate &initial,
+                const std::string_view *messages,
+                size_t count,
+                unsigned char (*digests)[kDigestLength]
+            ) const;
+
+        private:
+            Kernel m_kernel;
+
+            void hashFrom(
+                const Sha256Midstate *initial,
+                const std::string_view *messages,
+                size_t count,
+                unsigned char (*digests)[kDigestLength]
+            ) const;
+    };
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+#include "awssigv4_stats.h"
+
+namespace aws_sigv4 {
+
+    SigningStats::SigningStats()
+    {
+        reset();
+    }
+
+    SigningStats &SigningStats::global()
+    {
+        static SigningStats stats;
+        return stats;
+    }
+
+    bool SigningStats::enabled()
+    {
+#ifdef AWSSIGV4_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    const char *SigningStats::stageName(SigningStage stage)
+    {
+        switch (stage)
+        {
+            case kStagePayloadHash: return "payload_hash";
+            case kStageCanonicalize: return "canonicalize";
+            case kStageCanonicalRequestHash: return "canonical_request_hash";
+            case kStageKeyDerivation: return "key_derivation";
+            case kStageSignature: return "signature";
+            case kStageSignRequest: return "sign_request";
+            case kStageSignBatch: return "sign_batch";
+            case kStageCount: break;
+        }
+        return "unknown";
+    }
+
+    SigningStats::Shard &SigningStats::shard()
+    {
+        // Threads take shards in turn as they first record
+        static std::atomic<size_t> next_shard(0);
+        thread_local size_t index = next_shard.fetch_add(1, std::memory_order_relaxed) % kShards;
+        return m_shards[index];
+    }
+
+    void SigningStats::record(SigningStage stage, uint64_t bytes, uint64_t ns)
+    {
+        size_t bucket = 0;
+        if (ns > 1)
+            bucket = std::min<size_t>(63 - __builtin_clzll(ns), kLatencyBuckets - 1);
+
+        Shard &counters = shard();
+        counters.calls[stage].fetch_add(1, std::memory_order_relaxed);
+        counters.bytes[stage].fetch_add(bytes, std::memory_order_relaxed);
+        counters.total_ns[stage].fetch_add(ns, std::memory_order_relaxed);
+        counters.latency[stage][bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void SigningStats::recordKeyLookup(bool hit)
+    {
+        Shard &counters = shard();
+        if (hit)
+            counters.key_cache_hits.fetch_add(1, std::memory_order_relaxed);
+        else
+            counters.key_cache_misses.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void SigningStats::snapshot(Snapshot &snapshot) const
+    {
+        memset(&snapshot, 0, sizeof(snapshot));
+        for (size_t s = 0; s < kShards; s++)
+        {
+            const Shard &counters = m_shards[s];
+            for (size_t stage = 0; stage < kStageCount; stage++)
+            {
+                StageStats &stats = snapshot.stages[stage];
+                stats.calls += counters.calls[stage].load(std::memory_order_relaxed);
+                stats.bytes += counters.bytes[stage].load(std::memory_order_relaxed);
+                stats.total_ns += counters.total_ns[stage].load(std::memory_order_relaxed);
+                for (size_t bucket = 0; bucket < kLatencyBuckets; bucket++)
+                    stats.latency[bucket] += counters.latency[stage][bucket].load(std::memory_order_relaxed);
+            }
+            snapshot.key_cache_hits += counters.key_cache_hits.load(std::memory_order_relaxed);
+            snapshot.key_cache_misses += counters.key_cache_misses.load(std::memory_order_relaxed);
+        }
+    }
+
+    void SigningStats::reset()
+    {
+        for (size_t s = 0; s < kShards; s++)
+        {
+            Shard &counters = m_shards[s];
+            for (size_t stage = 0; stage < kStageCount; stage++)
+            {
+                counters.calls[stage].store(0, std::memory_order_relaxed);
+                counters.bytes[stage].store(0, std::memory_order_relaxed);
+                counters.total_ns[stage].store(0, std::memory_order_relaxed);
+                for (size_t bucket = 0; bucket < kLatencyBuckets; bucket++)
+                    counters.latency[stage][bucket].store(0, std::memory_order_relaxed);
+            }
+            counters.key_cache_hits.store(0, std::memory_order_relaxed);
+            counters.key_cache_misses.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void SigningStats::visit(const Snapshot &snapshot, const MetricVisitor &visitor)
+    {
+        for (size_t stage = 0; stage < kStageCount; stage++)
+        {
+            const StageStats &stats = snapshot.stages[stage];
+            const char *name = stageName((SigningStage)stage);
+            Metric calls = {"calls", name, 0, stats.calls};
+            visitor(calls);
+            Metric bytes = {"bytes", name, 0, stats.bytes};
+            visitor(bytes);
+            Metric total_ns = {"total_ns", name, 0, stats.total_ns};
+            visitor(total_ns);
+
+            uint64_t cumulative = 0;
+            for (size_t bucket = 0; bucket < kLatencyBuckets; bucket++)
+            {
+                cumulative += stats.latency[bucket];
+                uint64_t limit = bucket + 1 < kLatencyBuckets ? (uint64_t)2 << bucket : UINT64_MAX;
+                Metric latency = {"latency_bucket", name, limit, cumulative};
+                visitor(latency);
+            }
+        }
+
+        Metric hits = {"key_cache_hits", NULL, 0, snapshot.key_cache_hits};
+        visitor(hits);
+        Metric misses = {"key_cache_misses", NULL, 0, snapshot.key_cache_misses};
+        visitor(misses);
+    }
+
+}
@@ -0,0 +1,141 @@
+// Per-stage counters and latency histograms of the signer, built in with
+// -DAWSSIGV4_STATS ("make STATS=1" in tests/)
+
+#ifndef AWSSIGV4_STATS_H
+#define AWSSIGV4_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+#include "awssigv4.h"
+
+namespace aws_sigv4 {
+
+    // Where signing time goes. Stages nest: kStageSignRequest covers the
+    // others for one request.
+    enum SigningStage
+    {
+        // Step 1.6, bytes are the payload
+        kStagePayloadHash,
+        // Steps 1.2 to 1.5: path, query and headers put in canonical form
+        kStageCanonicalize,
+        // Step 1.7 and the hash of step 2, bytes are the canonical request
+        kStageCanonicalRequestHash,
+        // Signing key derivation, on a key cache miss only
+        kStageKeyDerivation,
+        // Step 3, the HMAC of the string to sign
+        kStageSignature,
+        // One signRequest call
+        kStageSignRequest,
+        // One signBatch call, bytes are the payloads of the batch. Batches
+        // hashed across SIMD lanes record no other stage.
+        kStageSignBatch,
+        kStageCount
+    };
+
+    // Process-wide signing statistics. Recording is lock free: each thread
+    // adds to one of a few cache-line aligned shards, and snapshot() sums
+    // them, so a snapshot taken while others sign is only approximately
+    // consistent across counters. Without AWSSIGV4_STATS the signer records
+    // nothing and snapshots stay at zero.
+    class SigningStats
+    {
+        public:
+            // Latency bucket i counts durations under 2^(i + 1) ns (bucket 0
+            // also takes 0 and 1 ns); the last one everything longer
+            static const size_t kLatencyBuckets = 36;
+
+            struct StageStats
+            {
+                uint64_t calls;
+                uint64_t bytes;
+                uint64_t total_ns;
+                uint64_t latency[kLatencyBuckets];
+            };
+
+            struct Snapshot
+            {
+                StageStats stages[kStageCount];
+                // Signing keys found for the signer's own copy or in its
+                // SigningKeyCache, and keys derived
+                uint64_t key_cache_hits;
+                uint64_t key_cache_misses;
+            };
+
+            // One value of a snapshot, flattened for a metrics exporter.
+            // stage is NULL for the key cache counters, and bucket_limit_ns
+            // is set for "latency_bucket" values only, which are cumulative
+            // (durations under the limit) with UINT64_MAX for the last
+            struct Metric
+            {
+                const char *name;
+                const char *stage;
+                uint64_t bucket_limit_ns;
+                uint64_t value;
+            };
+
+            typedef std::function<void(const Metric &metric)> MetricVisitor;
+
+            static SigningStats &global();
+
+            static bool enabled();
+            static const char *stageName(SigningStage stage);
+
+            // Nanoseconds on a monotonic clock, for timing a stage
+            static uint64_t now()
+            {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+
+            void record(SigningStage stage, uint64_t bytes, uint64_t ns);
+            void recordKeyLookup(bool hit);
+
+            void snapshot(Snapshot &snapshot) const;
+            void reset();
+
+            // Calls visitor with "calls", "bytes", "total_ns" and every
+            // "latency_bucket" of each stage, then "key_cache_hits" and
+            // "key_cache_misses"
+            static void visit(const Snapshot &snapshot, const MetricVisitor &visitor);
+
+        private:
+            static const size_t kShards = 16;
+
+            struct alignas(64) Shard
+            {
+                std::atomic<uint64_t> calls[kStageCount];
+                std::atomic<uint64_t> bytes[kStageCount];
+                std::atomic<uint64_t> total_ns[kStageCount];
+                std::atomic<uint64_t> latency[kStageCount][kLatencyBuckets];
+                std::atomic<uint64_t> key_cache_hits;
+                std::atomic<uint64_t> key_cache_misses;
+            };
+
+            Shard m_shards[kShards];
+
+            SigningStats();
+            SigningStats(const SigningStats &);
+            SigningStats &operator=(const SigningStats &);
+
+            Shard &shard();
+    };
+
+}
+
+// Stage timing for the library's own code: compiled out unless
+// AWSSIGV4_STATS is defined. A stage is begun and ended in one scope.
+#ifdef AWSSIGV4_STATS
+#define AWSSIGV4_STAGE_BEGIN(stage) \
+    const uint64_t awssigv4_stage_start_##stage = ::aws_sigv4::SigningStats::now()
+#define AWSSIGV4_STAGE_END(stage, bytes) \
+    ::aws_sigv4::SigningStats::global().record(::aws_sigv4::stage, (bytes), ::aws_sigv4::SigningStats::now() - awssigv4_stage_start_##stage)
+#define AWSSIGV4_KEY_LOOKUP(hit) \
+    ::aws_sigv4::SigningStats::global().recordKeyLookup(hit)
+#else
+#define AWSSIGV4_STAGE_BEGIN(stage)
+#define AWSSIGV4_STAGE_END(stage, bytes)
+#define AWSSIGV4_KEY_LOOKUP(hit)
+#endif
+
+#endif
@@ -0,0 +1,536 @@
+#include "awssigv4_text.h"
+
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AWSSIGV4_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define AWSSIGV4_NEON_KERNELS 1
+#include <arm_neon.h>
+#endif
+
+namespace aws_sigv4 {
+
+    static const char kLowerHexDigits[] = "0123456789abcdef";
+
+    static inline bool isWhitespace(unsigned char c)
+    {
+        return c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t';
+    }
+
+    // Scalar kernels, also used for the tails of the vector ones
+
+    static void lowercaseScalar(const char *in, size_t length, char *out)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            unsigned char c = in[i];
+            out[i] = c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+        }
+    }
+
+    static size_t leadingWhitespaceScalar(const char *s, size_t length)
+    {
+        size_t i = 0;
+        while (i < length && isWhitespace(s[i]))
+            i++;
+        return i;
+    }
+
+    static size_t trailingWhitespaceScalar(const char *s, size_t length)
+    {
+        size_t end = length;
+        while (end > 0 && isWhitespace(s[end - 1]))
+            end--;
+        return length - end;
+    }
+
+    static size_t findCollapsibleScalar(const char *in, size_t length)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            unsigned char c = in[i];
+            if (isWhitespace(c) && (c != ' ' || (i + 1 < length && isWhitespace(in[i + 1]))))
+                return i;
+        }
+        return length;
+    }
+
+    static void hexEncodeScalar(const unsigned char *in, size_t length, char *out)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            out[2 * i] = kLowerHexDigits[in[i] >> 4];
+            out[2 * i + 1] = kLowerHexDigits[in[i] & 0xf];
+        }
+    }
+
+#ifdef AWSSIGV4_X86_KERNELS
+    // SSE2: 16 bytes at a time
+
+    __attribute__((target("sse2")))
+    static inline __m128i whitespaceMaskSse2(__m128i v)
+    {
+        // \t to \r are contiguous: one unsigned range check covers them
+        __m128i control = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+        __m128i is_control = _mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8('\r' - '\t')), control);
+        return _mm_or_si128(is_control, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+    }
+
+    __attribute__((target("sse2")))
+    static void lowercaseSse2(const char *in, size_t length, char *out)
+    {
+        size_t i = 0;
+        for (; i + 16 <= length; i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+            __m128i alpha = _mm_sub_epi8(v, _mm_set1_epi8('A'));
+            __m128i upper = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8('Z' - 'A')), alpha);
+            _mm_storeu_si128((__m128i *)(out + i), _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+        }
+        lowercaseScalar(in + i, length - i, out + i);
+    }
+
+    __attribute__((target("sse2")))
+    static size_t leadingWhitespaceSse2(const char *s, size_t length)
+    {
+        size_t i = 0;
+        for (; i + 16 <= length; i += 16)
+        {
+            unsigned mask = _mm_movemask_epi8(whitespaceMaskSse2(_mm_loadu_si128((const __m128i *)(s + i))));
+            if (mask != 0xffff)
+                return i + __builtin_ctz(~mask);
+        }
+        return i + leadingWhitespaceScalar(s + i, length - i);
+    }
+
+    __attribute__((target("sse2")))
+    static size_t trailingWhitespaceSse2(const char *s, size_t length)
+    {
+        size_t end = length;
+        for (; end >= 16; end -= 16)
+        {
+            unsigned mask = _mm_movemask_epi8(whitespaceMaskSse2(_mm_loadu_si128((const __m128i *)(s + end - 16))));
+            if (mask != 0xffff)
+                return length - (end - 16 + (31 - __builtin_clz(~mask & 0xffff)) + 1);
+        }
+        return (length - end) + trailingWhitespaceScalar(s, end);
+    }
+
+    __attribute__((target("sse2")))
+    static size_t findCollapsibleSse2(const char *in, size_t length)
+    {
+        // Each block is compared with the same bytes shifted by one, so a
+        // space is only flagged when whitespace follows it
+        size_t i = 0;
+        for (; i + 17 <= length; i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+            __m128i next = _mm_loadu_si128((const __m128i *)(in + i + 1));
+            __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+            __m128i collapsible = _mm_or_si128(_mm_andnot_si128(space, whitespaceMaskSse2(v)),
+                                               _mm_and_si128(space, whitespaceMaskSse2(next)));
+            unsigned mask = _mm_movemask_epi8(collapsible);
+            if (mask != 0)
+                return i + __builtin_ctz(mask);
+        }
+        return i + findCollapsibleScalar(in + i, length - i);
+    }
+
+    __attribute__((target("sse2")))
+    static inline __m128i hexDigitsSse2(__m128i nibbles)
+    {
+        __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+        return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+    }
+
+    __attribute__((target("sse2")))
+    static void hexEncodeSse2(const unsigned char *in, size_t length, char *out)
+    {
+        size_t i = 0;
+        for (; i + 16 <= length; i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+            __m128i high = _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f));
+            __m128i low = _mm_and_si128(v, _mm_set1_epi8(0x0f));
+            _mm_storeu_si128((__m128i *)(out + 2 * i), hexDigitsSse2(_mm_unpacklo_epi8(high, low)));
+            _mm_storeu_si128((__m128i *)(out + 2 * i + 16), hexDigitsSse2(_mm_unpackhi_epi8(high, low)));
+        }
+        hexEncodeScalar(in + i, length - i, out + 2 * i);
+    }
+
+    // AVX2: 32 bytes at a time, finishing with the SSE2 kernels. GCC does
+    // not clear the upper halves before those tail calls, and legacy SSE
+    // code after dirty AVX state runs many times slower, hence the explicit
+    // _mm256_zeroupper().
+
+    __attribute__((target("avx2")))
+    static inline __m256i whitespaceMaskAvx2(__m256i v)
+    {
+        __m256i control = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+        __m256i is_control = _mm256_cmpeq_epi8(_mm256_min_epu8(control, _mm256_set1_epi8('\r' - '\t')), control);
+        return _mm256_or_si256(is_control, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+    }
+
+    __attribute__((target("avx2")))
+    static void lowercaseAvx2(const char *in, size_t length, char *out)
+    {
+        size_t i = 0;
+        for (; i + 32 <= length; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+            __m256i alpha = _mm256_sub_epi8(v, _mm256_set1_epi8('A'));
+            __m256i upper = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, _mm256_set1_epi8('Z' - 'A')), alpha);
+            _mm256_storeu_si256((__m256i *)(out + i), _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20))));
+        }
+        _mm256_zeroupper();
+        lowercaseSse2(in + i, length - i, out + i);
+    }
+
+    __attribute__((target("avx2")))
+    static size_t leadingWhitespaceAvx2(const char *s, size_t length)
+    {
+        size_t i = 0;
+        for (; i + 32 <= length; i += 32)
+        {
+            uint32_t mask = _mm256_movemask_epi8(whitespaceMaskAvx2(_mm256_loadu_si256((const __m256i *)(s + i))));
+            if (mask != 0xffffffff)
+                return i + __builtin_ctz(~mask);
+        }
+        _mm256_zeroupper();
+        return i + leadingWhitespaceSse2(s + i, length - i);
+    }
+
+    __attribute__((target("avx2")))
+    static size_t trailingWhitespaceAvx2(const char *s, size_t length)
+    {
+        size_t end = length;
+        for (; end >= 32; end -= 32)
+        {
+            uint32_t mask = _mm256_movemask_epi8(whitespaceMaskAvx2(_mm256_loadu_si256((const __m256i *)(s + end - 32))));
+            if (mask != 0xffffffff)
+                return length - (end - 32 + (31 - __builtin_clz(~mask)) + 1);
+        }
+        _mm256_zeroupper();
+        return (length - end) + trailingWhitespaceSse2(s, end);
+    }
+
+    __attribute__((target("avx2")))
+    static size_t findCollapsibleAvx2(const char *in, size_t length)
+    {
+        size_t i = 0;
+        for (; i + 33 <= length; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+            __m256i next = _mm256_loadu_si256((const __m256i *)(in + i + 1));
+            __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+            __m256i collapsible = _mm256_or_si256(_mm256_andnot_si256(space, whitespaceMaskAvx2(v)),
+                                                  _mm256_and_si256(space, whitespaceMaskAvx2(next)));
+            uint32_t mask = _mm256_movemask_epi8(collapsible);
+            if (mask != 0)
+                return i + __builtin_ctz(mask);
+        }
+        _mm256_zeroupper();
+        return i + findCollapsibleSse2(in + i, length - i);
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i hexDigitsAvx2(__m256i nibbles)
+    {
+        __m256i letters = _mm256_and_si256(_mm256_cmpgt_epi8(nibbles, _mm256_set1_epi8(9)), _mm256_set1_epi8('a' - '0' - 10));
+        return _mm256_add_epi8(_mm256_add_epi8(nibbles, _mm256_set1_epi8('0')), letters);
+    }
+
+    __attribute__((target("avx2")))
+    static void hexEncodeAvx2(const unsigned char *in, size_t length, char *out)
+    {
+        size_t i = 0;
+        for (; i + 32 <= length; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+            __m256i high = _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0f));
+            __m256i low = _mm256_and_si256(v, _mm256_set1_epi8(0x0f));
+
+            // Unpacking stays within 128-bit lanes: bytes 0-7 and 16-23
+            // come out of the low unpack, 8-15 and 24-31 out of the high one
+            __m256i first = hexDigitsAvx2(_mm256_unpacklo_epi8(high, low));
+            __m256i second = hexDigitsAvx2(_mm256_unpackhi_epi8(high, low));
+            _mm256_storeu_si256((__m256i *)(out + 2 * i), _mm256_permute2x128_si256(first, second, 0x20));
+            _mm256_storeu_si256((__m256i *)(out + 2 * i + 32), _mm256_permute2x128_si256(first, second, 0x31));
+        }
+        _mm256_zeroupper();
+        hexEncodeSse2(in + i, length - i, out + 2 * i);
+    }
+#endif
+
+#ifdef AWSSIGV4_NEON_KERNELS
+    // NEON: 16 bytes at a time. There is no movemask, so blocks that need
+    // a closer look are handed to the scalar kernel.
+
+    static inline uint8x16_t whitespaceMaskNeon(uint8x16_t v)
+    {
+        uint8x16_t control = vcleq_u8(vsubq_u8(v, vdupq_n_u8('\t')), vdupq_n_u8('\r' - '\t'));
+        return vorrq_u8(control, vceqq_u8(v, vdupq_n_u8(' ')));
+    }
+
+    static void lowercaseNeon(const char *in, size_t length, char *out)
+    {
+        size_t i = 0;
+        for (; i + 16 <= length; i += 16)
+        {
+            uint8x16_t v = vld1q_u8((const uint8_t *)in + i);
+            uint8x16_t upper = vcleq_u8(vsubq_u8(v, vdupq_n_u8('A')), vdupq_n_u8('Z' - 'A'));
+            vst1q_u8((uint8_t *)out + i, vorrq_u8(v, vandq_u8(upper, vdupq_n_u8(0x20))));
+        }
+        lowercaseScalar(in + i, length - i, out + i);
+    }
+
+    static size_t leadingWhitespaceNeon(const char *s, size_t length)
+    {
+        size_t i = 0;
+        while (i + 16 <= length && vminvq_u8(whitespaceMaskNeon(vld1q_u8((const uint8_t *)s + i))) == 0xff)
+            i += 16;
+        return i + leadingWhitespaceScalar(s + i, length - i);
+    }
+
+    static size_t trailingWhitespaceNeon(const char *s, size_t length)
+    {
+        size_t end = length;
+        while (end >= 16 && vminvq_u8(whitespaceMaskNeon(vld1q_u8((const uint8_t *)s + end - 16))) == 0xff)
+            end -= 16;
+        return (length - end) + trailingWhitespaceScalar(s, end);
+    }
+
+    static size_t findCollapsibleNeon(const char *in, size_t length)
+    {
+        size_t i = 0;
+        for (; i + 17 <= length; i += 16)
+        {
+            uint8x16_t v = vld1q_u8((const uint8_t *)in + i);
+            uint8x16_t next = vld1q_u8((const uint8_t *)in + i + 1);
+            uint8x16_t space = vceqq_u8(v, vdupq_n_u8(' '));
+            uint8x16_t collapsible = vorrq_u8(vbicq_u8(whitespaceMaskNeon(v), space), vandq_u8(space, whitespaceMaskNeon(next)));
+            if (vmaxvq_u8(collapsible) != 0)
+                break;
+        }
+        return i + findCollapsibleScalar(in + i, length - i);
+    }
+
+    static void hexEncodeNeon(const unsigned char *in, size_t length, char *out)
+    {
+        uint8x16_t digits = vld1q_u8((const uint8_t *)kLowerHexDigits);
+        size_t i = 0;
+        for (; i + 16 <= length; i += 16)
+        {
+            uint8x16_t v = vld1q_u8(in + i);
+            uint8x16x2_t hex;
+            hex.val[0] = vqtbl1q_u8(digits, vshrq_n_u8(v, 4));
+            hex.val[1] = vqtbl1q_u8(digits, vandq_u8(v, vdupq_n_u8(0x0f)));
+            vst2q_u8((uint8_t *)out + 2 * i, hex);
+        }
+        hexEncodeScalar(in + i, length - i, out + 2 * i);
+    }
+#endif
+
+    TextKernels::Kernel TextKernels::bestKernel()
+    {
+        if (supported(kAvx2))
+            return kAvx2;
+        if (supported(kSse2))
+            return kSse2;
+        if (supported(kNeon))
+            return kNeon;
+        return kScalar;
+    }
+
+    bool TextKernels::supported(Kernel kernel)
+    {
+        switch (kernel)
+        {
+            case kScalar:
+                return true;
+#ifdef AWSSIGV4_X86_KERNELS
+            case kSse2:
+                return __builtin_cpu_supports("sse2");
+            case kAvx2:
+                return __builtin_cpu_supports("avx2");
+#endif
+#ifdef AWSSIGV4_NEON_KERNELS
+            case kNeon:
+                return true;
+#endif
+            default:
+                return false;
+        }
+    }
+
+    const char *TextKernels::kernelName(Kernel kernel)
+    {
+        switch (kernel)
+        {
+            case kSse2:
+                return "sse2";
+            case kAvx2:
+                return "avx2";
+            case kNeon:
+                return "neon";
+            default:
+                return "scalar";
+        }
+    }
+
+    const TextKernels &TextKernels::best()
+    {
+        static const TextKernels kernels;
+        return kernels;
+    }
+
+    TextKernels::TextKernels(Kernel kernel)
+    {
+        m_kernel = supported(kernel) ? kernel : kScalar;
+    }
+
+    TextKernels::Kernel TextKernels::kernel() const
+    {
+        return m_kernel;
+    }
+
+    void TextKernels::lowercase(const char *in, size_t length, char *out) const
+    {
+        switch (m_kernel)
+        {
+#ifdef AWSSIGV4_X86_KERNELS
+            case kSse2:
+                lowercaseSse2(in, length, out);
+                return;
+            case kAvx2:
+                lowercaseAvx2(in, length, out);
+                return;
+#endif
+#ifdef AWSSIGV4_NEON_KERNELS
+            case kNeon:
+                lowercaseNeon(in, length, out);
+                return;
+#endif
+            default:
+                lowercaseScalar(in, length, out);
+                return;
+        }
+    }
+
+    std::string_view TextKernels::trim(std::string_view s) const
+    {
+        // Most names and values have nothing to trim
+        if (s.empty() || (!isWhitespace(s.front()) && !isWhitespace(s.back())))
+            return s;
+
+        size_t leading, trailing;
+        switch (m_kernel)
+        {
+#ifdef AWSSIGV4_X86_KERNELS
+            case kSse2:
+                leading = leadingWhitespaceSse2(s.data(), s.length());
+                trailing = leading == s.length() ? 0 : trailingWhitespaceSse2(s.data() + leading, s.length() - leading);
+                break;
+            case kAvx2:
+                leading = leadingWhitespaceAvx2(s.data(), s.length());
+                trailing = leading == s.length() ? 0 : trailingWhitespaceAvx2(s.data() + leading, s.length() - leading);
+                break;
+#endif
+#ifdef AWSSIGV4_NEON_KERNELS
+            case kNeon:
+                leading = leadingWhitespaceNeon(s.data(), s.length());
+                trailing = leading == s.length() ? 0 : trailingWhitespaceNeon(s.data() + leading, s.length() - leading);
+                break;
+#endif
+            default:
+                leading = leadingWhitespaceScalar(s.data(), s.length());
+                trailing = leading == s.length() ? 0 : trailingWhitespaceScalar(s.data() + leading, s.length() - leading);
+                break;
+        }
+
+        return s.substr(leading, s.length() - leading - trailing);
+    }
+
+    size_t TextKernels::findCollapsible(const char *in, size_t length) const
+    {
+        switch (m_kernel)
+        {
+#ifdef AWSSIGV4_X86_KERNELS
+            case kSse2:
+                return findCollapsibleSse2(in, length);
+            case kAvx2:
+                return findCollapsibleAvx2(in, length);
+#endif
+#ifdef AWSSIGV4_NEON_KERNELS
+            case kNeon:
+                return findCollapsibleNeon(in, length);
+#endif
+            default:
+                return findCollapsibleScalar(in, length);
+        }
+    }
+
+    size_t TextKernels::collapseWhitespace(const char *in, size_t length, char *out, bool &previous_space) const
+    {
+        size_t i = 0, written = 0;
+        while (i < length)
+        {
+            if (previous_space)
+            {
+                // The rest of a run already written as one space
+                while (i < length && isWhitespace(in[i]))
+                    i++;
+                if (i == length)
+                    break;
+                previous_space = false;
+            }
+
+            // Copy up to the next run in one go
+            size_t clean = findCollapsible(in + i, length - i);
+            memcpy(out + written, in + i, clean);
+            written += clean;
+            i += clean;
+            if (i == length)
+            {
+                // A trailing single space may continue in the next call
+                previous_space = clean > 0 && out[written - 1] == ' ';
+                break;
+            }
+
+            out[written++] = ' ';
+            i++;
+            previous_space = true;
+        }
+
+        return written;
+    }
+
+    void TextKernels::hexEncode(const unsigned char *in, size_t length, char *out) const
+    {
+        switch (m_kernel)
+        {
+#ifdef AWSSIGV4_X86_KERNELS
+            case kSse2:
+                hexEncodeSse2(in, length, out);
+                return;
+            case kAvx2:
+                hexEncodeAvx2(in, length, out);
+                return;
+#endif
+#ifdef AWSSIGV4_NEON_KERNELS
+            case kNeon:
+                hexEncodeNeon(in, length, out);
+                return;
+#endif
+            default:
+                hexEncodeScalar(in, length, out);
+                return;
+        }
+    }
+
+}
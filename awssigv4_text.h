@@ -0,0 +1,66 @@
+// Byte string kernels of request canonicalisation: ASCII lowercasing,
+// whitespace trimming and collapsing, and lowercase hex encoding
+
+#ifndef AWSSIGV4_TEXT_H
+#define AWSSIGV4_TEXT_H
+
+#include <stddef.h>
+#include <string_view>
+
+namespace aws_sigv4 {
+
+    // The same operations in several instruction sets. SSE2 and AVX2 on x86
+    // and NEON on AArch64 work on 16 or 32 bytes at a time; the scalar
+    // kernel runs anywhere. Whitespace is what std::isspace accepts in the
+    // C locale: space, \t, \n, \v, \f and \r. Every kernel gives the same
+    // results, so the choice only affects speed.
+    class TextKernels
+    {
+        public:
+            enum Kernel
+            {
+                kScalar,
+                kSse2,
+                kAvx2,
+                kNeon
+            };
+
+            // Widest kernel this CPU can run
+            static Kernel bestKernel();
+            static bool supported(Kernel kernel);
+            static const char *kernelName(Kernel kernel);
+
+            // Process-wide instance on the best kernel
+            static const TextKernels &best();
+
+            // Falls back to the scalar kernel if the CPU lacks the one asked for
+            explicit TextKernels(Kernel kernel=bestKernel());
+
+            Kernel kernel() const;
+
+            // out[i] = in[i] with A-Z mapped to a-z. out may be in.
+            void lowercase(const char *in, size_t length, char *out) const;
+
+            // s without leading and trailing whitespace
+            std::string_view trim(std::string_view s) const;
+
+            // Offset of the first byte that collapseWhitespace would change
+            // (whitespace other than a single space), or length if none
+            size_t findCollapsible(const char *in, size_t length) const;
+
+            // Copies in to out, which has room for length bytes, replacing
+            // every run of whitespace with one space, and returns the length
+            // written. previous_space carries a run across calls that split
+            // one value: start it false.
+            size_t collapseWhitespace(const char *in, size_t length, char *out, bool &previous_space) const;
+
+            // Lowercase hex digits of length bytes into out (2 * length chars)
+            void hexEncode(const unsigned char *in, size_t length, char *out) const;
+
+        private:
+            Kernel m_kernel;
+    };
+
+}
+
+#endif
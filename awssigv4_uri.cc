@@ -0,0 +1,417 @@
+#include "awssigv4_uri.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace aws_sigv4 {
+
+    static const char kHexDigits[] = "0123456789ABCDEF";
+
+    // Byte classes, one table lookup per byte
+    enum
+    {
+        kUnreserved = 1,
+        kSlash = 2,
+        kUpperHex = 4
+    };
+
+    struct UriTable
+    {
+        unsigned char classes[256];
+        signed char hex_values[256];
+
+        constexpr UriTable() : classes(), hex_values()
+        {
+            for (int c = 0; c < 256; c++)
+            {
+                bool alpha = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+                bool digit = c >= '0' && c <= '9';
+                if (alpha || digit || c == '-' || c == '_' || c == '.' || c == '~')
+                    classes[c] |= kUnreserved;
+                if (c == '/')
+                    classes[c] |= kSlash;
+                if (digit || (c >= 'A' && c <= 'F'))
+                    classes[c] |= kUpperHex;
+
+                hex_values[c] = -1;
+                if (digit)
+                    hex_values[c] = c - '0';
+                else if (c >= 'A' && c <= 'F')
+                    hex_values[c] = c - 'A' + 10;
+                else if (c >= 'a' && c <= 'f')
+                    hex_values[c] = c - 'a' + 10;
+            }
+        }
+    };
+
+    static constexpr UriTable kUriTable;
+
+    static inline size_t spanOf(const char *s, size_t length, unsigned char classes)
+    {
+        size_t i = 0;
+        while (i < length && (kUriTable.classes[(unsigned char)s[i]] & classes))
+            i++;
+        return i;
+    }
+
+    void appendUriEncoded(std::string &out, std::string_view in, bool encode_slash)
+    {
+        unsigned char keep = encode_slash ? kUnreserved : kUnreserved | kSlash;
+        const char *s = in.data();
+        size_t length = in.length();
+
+        // Most names and values are a single unreserved run
+        size_t run = spanOf(s, length, keep);
+        if (run == length)
+        {
+            out.append(s, length);
+            return;
+        }
+
+        // Size the output exactly, then copy runs and write escapes into it
+        size_t escapes = 0;
+        for (size_t i = run; i < length; i++)
+            escapes += !(kUriTable.classes[(unsigned char)s[i]] & keep);
+
+        size_t start = out.length();
+        out.resize(start + length + 2 * escapes);
+        char *o = &out[start];
+        while (length > 0)
+        {
+            memcpy(o, s, run);
+            o += run;
+            s += run;
+            length -= run;
+
+            while (length > 0 && !(kUriTable.classes[(unsigned char)*s] & keep))
+            {
+                unsigned char c = *s++;
+                o[0] = '%';
+                o[1] = kHexDigits[c >> 4];
+                o[2] = kHexDigits[c & 0xf];
+                o += 3;
+                length--;
+            }
+            run = spanOf(s, length, keep);
+        }
+    }
+
+    void appendUriDecoded(std::string &out, std::string_view in, bool plus_is_space)
+    {
+        const char *s = in.data();
+        size_t length = in.length();
+        size_t i = 0;
+        while (i < length)
+        {
+            size_t start = i;
+            while (i < length && s[i] != '%' && !(plus_is_space && s[i] == '+'))
+                i++;
+            out.append(s + start, i - start);
+            if (i == length)
+                break;
+
+            if (s[i] == '+')
+            {
+                out += ' ';
+                i++;
+                continue;
+            }
+
+            int high = i + 2 < length ? kUriTable.hex_values[(unsigned char)s[i + 1]] : -1;
+            int low = high >= 0 ? kUriTable.hex_values[(unsigned char)s[i + 2]] : -1;
+            if (low >= 0)
+            {
+                out += (char)(high << 4 | low);
+                i += 3;
+            }
+            else
+            {
+                out += '%';
+                i++;
+            }
+        }
+    }
+
+    bool isUriEncoded(std::string_view in)
+    {
+        const char *s = in.data();
+        size_t length = in.length();
+        size_t i = 0;
+        while (true)
+        {
+            i += spanOf(s + i, length - i, kUnreserved);
+            if (i == length)
+                return true;
+            if (s[i] != '%' || i + 2 >= length
+                || !(kUriTable.classes[(unsigned char)s[i + 1]] & kUpperHex)
+                || !(kUriTable.classes[(unsigned char)s[i + 2]] & kUpperHex))
+                return false;
+
+            // An escaped unreserved byte decodes to itself unescaped
+            unsigned char c = kUriTable.hex_values[(unsigned char)s[i + 1]] << 4 | kUriTable.hex_values[(unsigned char)s[i + 2]];
+            if (kUriTable.classes[c] & kUnreserved)
+                return false;
+            i += 3;
+        }
+    }
+
+    UriNormalization uriNormalizationFor(std::string_view service)
+    {
+        return service == "s3" ? kUriEncodeOnce : kUriNormalize;
+    }
+
+    size_t maxCanonicalUriLength(size_t length, UriNormalization mode)
+    {
+        // A leading '/', then at most %XX per byte, or %25XX encoded twice
+        switch (mode)
+        {
+            case kUriUnchanged:
+                return length;
+            case kUriNormalizeDoubleEncode:
+                return 1 + 5 * length;
+            default:
+                return 1 + 3 * length;
+        }
+    }
+
+    // One segment: escapes in it decoded, then every byte but the unreserved
+    // ones encoded, once or twice
+    static char *writeSegment(const char *s, size_t length, bool twice, char *o)
+    {
+        size_t i = 0;
+        while (i < length)
+        {
+            size_t run = spanOf(s + i, length - i, kUnreserved);
+            memcpy(o, s + i, run);
+            o += run;
+            i += run;
+            if (i == length)
+                break;
+
+            unsigned char c = s[i];
+            int high = c == '%' && i + 2 < length ? kUriTable.hex_values[(unsigned char)s[i + 1]] : -1;
+            int low = high >= 0 ? kUriTable.hex_values[(unsigned char)s[i + 2]] : -1;
+            if (low >= 0)
+            {
+                c = high << 4 | low;
+                i += 3;
+            }
+            else
+            {
+                i++;
+            }
+
+            if (kUriTable.classes[c] & kUnreserved)
+            {
+                *o++ = c;
+                continue;
+            }
+            *o++ = '%';
+            if (twice)
+            {
+                *o++ = '2';
+                *o++ = '5';
+            }
+            *o++ = kHexDigits[c >> 4];
+            *o++ = kHexDigits[c & 0xf];
+        }
+        return o;
+    }
+
+    size_t canonicalizeUri(std::string_view path, UriNormalization mode, char *out)
+    {
+        if (mode == kUriUnchanged)
+        {
+            memcpy(out, path.data(), path.length());
+            return path.length();
+        }
+
+        bool normalize = mode == kUriNormalize || mode == kUriNormalizeDoubleEncode;
+        bool twice = mode == kUriNormalizeDoubleEncode;
+        const char *s = path.data();
+        size_t length = path.length();
+        size_t i = !path.empty() && s[0] == '/' ? 1 : 0;
+
+        // Every segment but the last is written with its '/', so when
+        // normalising, out always ends with a '/' a ".." can go back from
+        char *o = out;
+        *o++ = '/';
+        while (true)
+        {
+            const char *slash = i < length ? (const char *)memchr(s + i, '/', length - i) : NULL;
+            size_t end = slash != NULL ? slash - s : length;
+            const char *segment = s + i;
+            size_t segment_length = end - i;
+
+            if (normalize && (segment_length == 0 || (segment_length == 1 && segment[0] == '.')))
+            {
+                // Empty and "." segments go; a trailing one leaves its '/'
+            }
+            else if (normalize && segment_length == 2 && segment[0] == '.' && segment[1] == '.')
+            {
+                // Back over the last segment written, never past the root
+                if (o - out > 1)
+                {
+                    o--;
+                    while (o[-1] != '/')
+                        o--;
+                }
+            }
+            else
+            {
+                o = writeSegment(segment, segment_length, twice, o);
+                if (slash != NULL)
+                    *o++ = '/';
+            }
+
+            if (slash == NULL)
+                break;
+            i = end + 1;
+        }
+        return o - out;
+    }
+
+    bool isCanonicalUri(std::string_view path, UriNormalization mode)
+    {
+        if (mode == kUriUnchanged)
+            return true;
+        if (path.empty() || path[0] != '/')
+            return false;
+
+        bool normalize = mode == kUriNormalize || mode == kUriNormalizeDoubleEncode;
+        path.remove_prefix(1);
+        while (true)
+        {
+            size_t slash = path.find('/');
+            std::string_view segment = path.substr(0, slash);
+            bool last = slash == std::string_view::npos;
+
+            if (normalize && ((segment.empty() && !last) || segment == "." || segment == ".."))
+                return false;
+            if (mode == kUriNormalizeDoubleEncode)
+            {
+                // Encoding twice leaves nothing but unreserved bytes alone
+                if (spanOf(segment.data(), segment.length(), kUnreserved) != segment.length())
+                    return false;
+            }
+            else if (!isUriEncoded(segment))
+            {
+                return false;
+            }
+
+            if (last)
+                return true;
+            path.remove_prefix(slash + 1);
+        }
+    }
+
+    void appendCanonicalUri(std::string &out, std::string_view path, UriNormalization mode)
+    {
+        size_t start = out.length();
+        out.resize(start + maxCanonicalUriLength(path.length(), mode));
+        out.resize(start + canonicalizeUri(path, mode, &out[start]));
+    }
+
+    CanonicalQueryBuilder::CanonicalQueryBuilder()
+        : m_sorted(true)
+    {
+    }
+
+    void CanonicalQueryBuilder::clear()
+    {
+        m_buffer.clear();
+        m_parameters.clear();
+        m_sorted = true;
+    }
+
+    void CanonicalQueryBuilder::addPart(std::string_view part)
+    {
+        // Parts that are already canonical go in as they are
+        if (isUriEncoded(part))
+        {
+            m_buffer.append(part.data(), part.length());
+            return;
+        }
+
+        m_decoded.clear();
+        appendUriDecoded(m_decoded, part, true);
+        appendUriEncoded(m_buffer, m_decoded);
+    }
+
+    void CanonicalQueryBuilder::add(std::string_view name, std::string_view value)
+    {
+        Parameter parameter;
+        parameter.name = m_buffer.length();
+        appendUriEncoded(m_buffer, name);
+        parameter.name_length = m_buffer.length() - parameter.name;
+        parameter.value = m_buffer.length();
+        appendUriEncoded(m_buffer, value);
+        parameter.value_length = m_buffer.length() - parameter.value;
+
+        m_parameters.push_back(parameter);
+        m_sorted = false;
+    }
+
+    void CanonicalQueryBuilder::parse(std::string_view query)
+    {
+        while (!query.empty())
+        {
+            size_t amp = query.find('&');
+            std::string_view pair = query.substr(0, amp);
+            query.remove_prefix(amp == std::string_view::npos ? query.length() : amp + 1);
+            if (pair.empty())
+                continue;
+
+            size_t epos = pair.find('=');
+            Parameter parameter;
+            parameter.name = m_buffer.length();
+            addPart(pair.substr(0, epos));
+            parameter.name_length = m_buffer.length() - parameter.name;
+            parameter.value = m_buffer.length();
+            if (epos != std::string_view::npos)
+                addPart(pair.substr(epos + 1));
+            parameter.value_length = m_buffer.length() - parameter.value;
+
+            m_parameters.push_back(parameter);
+            m_sorted = false;
+        }
+    }
+
+    void CanonicalQueryBuilder::appendTo(std::string &out)
+    {
+        const char *buffer = m_buffer.data();
+        if (!m_sorted)
+        {
+            // Byte order of the encoded names, then of the encoded values
+            std::sort(m_parameters.begin(), m_parameters.end(),
+                [buffer](const Parameter &a, const Parameter &b)
+                {
+                    std::string_view a_name(buffer + a.name, a.name_length);
+                    std::string_view b_name(buffer + b.name, b.name_length);
+                    if (a_name != b_name)
+                        return a_name < b_name;
+                    return std::string_view(buffer + a.value, a.value_length) < std::string_view(buffer + b.value, b.value_length);
+                });
+            m_sorted = true;
+        }
+
+        // Every byte of the buffer plus one '=' and one '&' per parameter
+        out.reserve(out.length() + m_buffer.length() + 2 * m_parameters.size());
+        for (size_t i = 0; i < m_parameters.size(); i++)
+        {
+            if (i > 0)
+                out += '&';
+            out.append(buffer + m_parameters[i].name, m_parameters[i].name_length);
+            out += '=';
+            out.append(buffer + m_parameters[i].value, m_parameters[i].value_length);
+        }
+    }
+
+    std::string CanonicalQueryBuilder::str()
+    {
+        std::string out;
+        appendTo(out);
+        return out;
+    }
+
+}
@@ -0,0 +1,112 @@
+// RFC 3986 percent-encoding as SigV4 canonical requests want it, and the
+// canonical query string built on top of it
+
+#ifndef AWSSIGV4_URI_H
+#define AWSSIGV4_URI_H
+
+#include <stddef.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace aws_sigv4 {
+
+    // Appends in with every byte but the unreserved A-Z a-z 0-9 - _ . ~
+    // written as %XX (uppercase hex). With encode_slash false, '/' is kept
+    // too, for object key paths. Runs of unreserved bytes are copied whole.
+    void appendUriEncoded(std::string &out, std::string_view in, bool encode_slash=true);
+
+    // Appends in with %XX escapes decoded, and '+' as a space if
+    // plus_is_space (application/x-www-form-urlencoded). A '%' not followed
+    // by two hex digits is kept as it is.
+    void appendUriDecoded(std::string &out, std::string_view in, bool plus_is_space=false);
+
+    // True if appendUriEncoded(appendUriDecoded(in)) would give in back:
+    // only unreserved bytes and %XX escapes, with uppercase hex digits, of
+    // bytes that are not unreserved
+    bool isUriEncoded(std::string_view in);
+
+    // Step 1.2: how the path of a request becomes its canonical URI
+    enum UriNormalization
+    {
+        // Signed as given: the caller has already canonicalised it
+        kUriUnchanged,
+        // S3: every segment percent-encoded once, escapes already in the
+        // path decoded first so none is encoded twice; '.' and '..'
+        // segments and empty segments are part of the object key
+        kUriEncodeOnce,
+        // Everything else: RFC 3986 dot segments removed, duplicate slashes
+        // collapsed, then every segment encoded once as above
+        kUriNormalize,
+        // kUriNormalize, then the result encoded again ('%' becomes %25),
+        // for services whose signers encode the path twice
+        kUriNormalizeDoubleEncode
+    };
+
+    // The mode a service signs with: kUriEncodeOnce for "s3", kUriNormalize
+    // for every other service
+    UriNormalization uriNormalizationFor(std::string_view service);
+
+    // Upper bound of the canonical length of a path of the given length
+    size_t maxCanonicalUriLength(size_t length, UriNormalization mode);
+
+    // Writes the canonical URI of path into out, which needs room for
+    // maxCanonicalUriLength(path.length(), mode) bytes, in one pass and
+    // without allocating, and returns the length written. An empty path is
+    // "/". The query string must already be split off.
+    size_t canonicalizeUri(std::string_view path, UriNormalization mode, char *out);
+
+    // True if canonicalizeUri would return path unchanged, so that it can be
+    // signed as it is
+    bool isCanonicalUri(std::string_view path, UriNormalization mode);
+
+    // canonicalizeUri into a string
+    void appendCanonicalUri(std::string &out, std::string_view path, UriNormalization mode);
+
+    // Step 1.3: query parameters percent-encoded and sorted by name, then
+    // value. Every encoded name and value goes into one buffer, so adding a
+    // parameter costs its encoding plus a slice; sorting moves the slices.
+    // A builder can be cleared and reused without reallocating.
+    class CanonicalQueryBuilder
+    {
+        public:
+            CanonicalQueryBuilder();
+
+            void clear();
+
+            // One parameter, neither part encoded yet
+            void add(std::string_view name, std::string_view value);
+
+            // Every name=value pair of an encoded query string, or of an
+            // application/x-www-form-urlencoded body, which parses the same.
+            // %XX escapes and '+' (a space, as the AWS services read it) are
+            // decoded before encoding. Empty pairs are skipped; a name
+            // without '=' has an empty value.
+            void parse(std::string_view query);
+
+            size_t size() const { return m_parameters.size(); }
+
+            // Appends "name=value&name=value..." in canonical order
+            void appendTo(std::string &out);
+            std::string str();
+
+        private:
+            struct Parameter
+            {
+                size_t name;
+                size_t name_length;
+                size_t value;
+                size_t value_length;
+            };
+
+            void addPart(std::string_view part);
+
+            std::string m_buffer;
+            std::string m_decoded;
+            std::vector<Parameter> m_parameters;
+            bool m_sorted;
+    };
+
+}
+
+#endif
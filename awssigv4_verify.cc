@@ -0,0 +1,450 @@
+#include "awssigv4_verify.h"
+#include "awssigv4_text.h"
+#include "awssigv4_uri.h"
+
+namespace aws_sigv4 {
+
+    static const char kAlgorithm[] = "AWS4-HMAC-SHA256";
+    static const size_t kSignatureLength = 2 * kSha256DigestLength;
+
+    // Derived keys of many access keys and days
+    static const size_t kKeyCacheSlots = 1024;
+
+    // Longest validity of a presigned URL, as for Presigner
+    static const int kMaxExpires = 7 * 24 * 60 * 60;
+
+    // The parts of an Authorization header, or of the X-Amz-* parameters of
+    // a presigned URL, that the signature depends on
+    struct Verifier::Authorization
+    {
+        std::string_view access_key;
+        // access_key/datestamp/region/service, the key cache key
+        std::string_view scope;
+        // datestamp/region/service/aws4_request, as in the string to sign
+        std::string_view credential_scope;
+        std::string_view datestamp;
+        std::string_view region;
+        std::string_view service;
+        // Lowercase names separated by ';'
+        std::string_view signed_headers;
+        std::string_view signature;
+        RequestTime time;
+    };
+
+    static inline bool equalsLowercase(std::string_view name, std::string_view lowercase)
+    {
+        if (name.length() != lowercase.length())
+            return false;
+        for (size_t i = 0; i < name.length(); i++)
+        {
+            unsigned char c = name[i];
+            if ((c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c) != (unsigned char)lowercase[i])
+                return false;
+        }
+        return true;
+    }
+
+    static bool startsWith(std::string_view s, std::string_view prefix)
+    {
+        return s.substr(0, prefix.length()) == prefix;
+    }
+
+    // Value of the first header called name (lowercase), trimmed
+    static bool findHeader(const SignRequest &request, std::string_view name, std::string_view &value)
+    {
+        for (size_t i = 0; i < request.header_count; i++)
+        {
+            if (equalsLowercase(TextKernels::best().trim(request.headers[i].name), name))
+            {
+                value = TextKernels::best().trim(request.headers[i].value);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Whether name appears in a ';' separated list of lowercase names
+    static bool isSignedHeader(std::string_view name, std::string_view signed_headers)
+    {
+        while (!signed_headers.empty())
+        {
+            size_t semicolon = signed_headers.find(';');
+            if (equalsLowercase(name, signed_headers.substr(0, semicolon)))
+                return true;
+            if (semicolon == std::string_view::npos)
+                break;
+            signed_headers.remove_prefix(semicolon + 1);
+        }
+        return false;
+    }
+
+    static bool parseDigits(std::string_view s, int &value)
+    {
+        value = 0;
+        for (size_t i = 0; i < s.length(); i++)
+        {
+            if (s[i] < '0' || s[i] > '9')
+                return false;
+            value = value * 10 + (s[i] - '0');
+        }
+        return !s.empty();
+    }
+
+    // 20110909T233600Z
+    static bool parseAmzDate(std::string_view s, time_t &time)
+    {
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        if (s.length() != 16 || s[8] != 'T' || s[15] != 'Z' ||
+            !parseDigits(s.substr(0, 4), tm.tm_year) || !parseDigits(s.substr(4, 2), tm.tm_mon) ||
+            !parseDigits(s.substr(6, 2), tm.tm_mday) || !parseDigits(s.substr(9, 2), tm.tm_hour) ||
+            !parseDigits(s.substr(11, 2), tm.tm_min) || !parseDigits(s.substr(13, 2), tm.tm_sec))
+            return false;
+
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        time = timegm(&tm);
+        return true;
+    }
+
+    // Mon, 09 Sep 2011 23:36:00 GMT, for requests dated by a Date header
+    static bool parseHttpDate(std::string_view s, time_t &time)
+    {
+        char buffer[64];
+        if (s.length() >= sizeof(buffer))
+            return false;
+        memcpy(buffer, s.data(), s.length());
+        buffer[s.length()] = '\0';
+
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        const char *end = strptime(buffer, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        if (end == NULL || *end != '\0')
+            return false;
+
+        time = timegm(&tm);
+        return true;
+    }
+
+    static bool equalConstantTime(const char *a, const char *b, size_t length)
+    {
+        // No early exit: the time taken does not depend on where they differ
+        unsigned char difference = 0;
+        for (size_t i = 0; i < length; i++)
+            difference |= a[i] ^ b[i];
+        return difference == 0;
+    }
+
+    const char *Verifier::statusName(Status status)
+    {
+        switch (status)
+        {
+            case kVerified: return "verified";
+            case kMissingAuthorization: return "missing authorization";
+            case kMalformedAuthorization: return "malformed authorization";
+            case kWrongScope: return "wrong scope";
+            case kUnknownAccessKey: return "unknown access key";
+            case kExpired: return "expired";
+            case kTooLarge: return "too large";
+            case kSignatureMismatch: return "signature mismatch";
+            case kRequestTimeTooSkewed: return "request time too skewed";
+            case kReplayed: return "replayed";
+            case kReplayCacheFull: return "replay cache full";
+        }
+        return "unknown";
+    }
+
+    Verifier::Verifier(
+        const std::string &region,
+        const std::string &service,
+        SecretLookup secret_lookup,
+        const Clock &clock
+    ) : m_region(region),
+        m_service(service),
+        m_secret_lookup(secret_lookup),
+        m_clock(clock),
+        m_uri_normalization(uriNormalizationFor(service)),
+        m_own_key_cache(kKeyCacheSlots),
+        m_key_cache(&m_own_key_cache),
+        m_max_clock_skew(0),
+        m_replay_cache(NULL)
+    {
+    }
+
+    void Verifier::setUriNormalization(UriNormalization mode)
+    {
+        m_uri_normalization = mode;
+    }
+
+    void Verifier::setKeyCache(SigningKeyCache *key_cache)
+    {
+        m_key_cache = key_cache != NULL ? key_cache : &m_own_key_cache;
+    }
+
+    void Verifier::setMaxClockSkew(time_t seconds)
+    {
+        m_max_clock_skew = seconds;
+    }
+
+    void Verifier::setReplayCache(ReplayCache *cache)
+    {
+        m_replay_cache = cache;
+    }
+
+    // <access key>/<datestamp>/<region>/<service>/aws4_request
+    bool Verifier::parseCredential(std::string_view credential, Authorization &authorization)
+    {
+        std::string_view parts[5];
+        std::string_view rest = credential;
+        for (size_t i = 0; i < 5; i++)
+        {
+            size_t slash = i < 4 ? rest.find('/') : rest.length();
+            if (slash == std::string_view::npos || slash == 0)
+                return false;
+            parts[i] = rest.substr(0, slash);
+            rest.remove_prefix(i < 4 ? slash + 1 : slash);
+        }
+        if (parts[4] != "aws4_request")
+            return false;
+
+        authorization.access_key = parts[0];
+        authorization.datestamp = parts[1];
+        authorization.region = parts[2];
+        authorization.service = parts[3];
+        authorization.scope = credential.substr(0, parts[4].data() - 1 - credential.data());
+        authorization.credential_scope = credential.substr(parts[1].data() - credential.data());
+        return true;
+    }
+
+    void Verifier::fillCredential(const Authorization &authorization, Credential *credential)
+    {
+        if (credential == NULL)
+            return;
+        credential->access_key.assign(authorization.access_key.data(), authorization.access_key.length());
+        credential->datestamp.assign(authorization.datestamp.data(), authorization.datestamp.length());
+        credential->request_time = authorization.time.time;
+    }
+
+    void Verifier::loadSigningKey(const Authorization &authorization, std::string_view secret_key, SigningKey &signing_key) const
+    {
+        if (m_key_cache->lookup(authorization.scope, secret_key, signing_key))
+            return;
+
+        deriveSigningKey(secret_key, authorization.datestamp, authorization.region, authorization.service, signing_key);
+        m_key_cache->store(authorization.scope, secret_key, signing_key);
+    }
+
+    Verifier::Status Verifier::checkSignature(
+        const SignRequest &request,
+        const Authorization &authorization,
+        std::string_view payload_hash,
+        bool presigned,
+        Credential *credential
+    ) const
+    {
+        fillCredential(authorization, credential);
+        if (authorization.region != m_region || authorization.service != m_service ||
+            authorization.datestamp != authorization.time.datestamp)
+            return kWrongScope;
+        if (authorization.signature.length() != kSignatureLength)
+            return kMalformedAuthorization;
+
+        // Replays can only be caught within the window the cache covers
+        ReplayCache *replay_cache = presigned ? NULL : m_replay_cache;
+        time_t max_skew = m_max_clock_skew;
+        if (replay_cache != NULL && (max_skew == 0 || max_skew > replay_cache->window()))
+            max_skew = replay_cache->window();
+        if (max_skew > 0)
+        {
+            time_t now = m_clock.now();
+            time_t time = authorization.time.time;
+            if (time > now + max_skew || (!presigned && time < now - max_skew))
+                return kRequestTimeTooSkewed;
+        }
+
+        // Step 1 over the signed headers only
+        HeaderField headers[Signature::kMaxHeaders];
+        SignRequest signed_request = request;
+        signed_request.headers = headers;
+        signed_request.header_count = 0;
+        for (size_t i = 0; i < request.header_count; i++)
+        {
+            if (!isSignedHeader(TextKernels::best().trim(request.headers[i].name), authorization.signed_headers))
+                continue;
+            if (signed_request.header_count == Signature::kMaxHeaders)
+                return kTooLarge;
+            headers[signed_request.header_count++] = request.headers[i];
+        }
+
+        unsigned char digest[kSha256DigestLength];
+        if (!hashCanonicalRequest(signed_request, payload_hash, m_uri_normalization, digest))
+            return kTooLarge;
+
+        std::string secret_key;
+        if (!m_secret_lookup(authorization.access_key, secret_key))
+            return kUnknownAccessKey;
+
+        SigningKey signing_key;
+        loadSigningKey(authorization, secret_key, signing_key);
+
+        // Steps 2 and 3
+        char hex[kSignatureLength];
+        TextKernels::best().hexEncode(digest, sizeof(digest), hex);
+
+        HmacSha256 hmac = signing_key.hmac;
+        hmac.update(kAlgorithm, sizeof(kAlgorithm) - 1);
+        hmac.update("\n", 1);
+        hmac.update(authorization.time.amzdate, 16);
+        hmac.update("\n", 1);
+        hmac.update(authorization.credential_scope);
+        hmac.update("\n", 1);
+        hmac.update(hex, sizeof(hex));
+        hmac.final(digest);
+        TextKernels::best().hexEncode(digest, sizeof(digest), hex);
+
+        // A signed header missing from the request changes the canonical
+        // request, so it ends up here too
+        if (!equalConstantTime(hex, authorization.signature.data(), kSignatureLength))
+            return kSignatureMismatch;
+
+        if (replay_cache != NULL)
+        {
+            switch (replay_cache->insert(digest, authorization.time.time))
+            {
+                case ReplayCache::kFirstSeen: break;
+                case ReplayCache::kReplayed: return kReplayed;
+                case ReplayCache::kNotRecorded: return kReplayCacheFull;
+            }
+        }
+        return kVerified;
+    }
+
+    Verifier::Status Verifier::verify(const SignRequest &request, Credential *credential) const
+    {
+        Authorization authorization;
+        std::string_view header;
+
+        std::string_view content_sha256;
+        bool has_content_sha256 = findHeader(request, "x-amz-content-sha256", content_sha256);
+
+        if (findHeader(request, "authorization", header))
+        {
+            // AWS4-HMAC-SHA256 Credential=..., SignedHeaders=..., Signature=...
+            if (!startsWith(header, kAlgorithm) || header.length() == sizeof(kAlgorithm) - 1 || header[sizeof(kAlgorithm) - 1] != ' ')
+                return kMalformedAuthorization;
+            header.remove_prefix(sizeof(kAlgorithm));
+
+            bool has_credential = false, has_signed_headers = false, has_signature = false;
+            while (!header.empty())
+            {
+                size_t comma = header.find(',');
+                std::string_view component = TextKernels::best().trim(header.substr(0, comma));
+                header.remove_prefix(comma == std::string_view::npos ? header.length() : comma + 1);
+
+                if (startsWith(component, "Credential="))
+                {
+                    if (!parseCredential(component.substr(11), authorization))
+                        return kMalformedAuthorization;
+                    has_credential = true;
+                }
+                else if (startsWith(component, "SignedHeaders="))
+                {
+                    authorization.signed_headers = component.substr(14);
+                    has_signed_headers = true;
+                }
+                else if (startsWith(component, "Signature="))
+                {
+                    authorization.signature = component.substr(10);
+                    has_signature = true;
+                }
+            }
+            if (!has_credential || !has_signed_headers || !has_signature)
+                return kMalformedAuthorization;
+
+            // The request time comes from x-amz-date, or failing that Date
+            std::string_view date;
+            time_t time;
+            if (findHeader(request, "x-amz-date", date))
+            {
+                if (!parseAmzDate(date, time))
+                    return kMalformedAuthorization;
+            }
+            else if (!findHeader(request, "date", date) || !(parseAmzDate(date, time) || parseHttpDate(date, time)))
+            {
+                return kMalformedAuthorization;
+            }
+            formatRequestTime(time, authorization.time);
+
+            // Step 1.6: the payload hash
+            char payload_hash[kSignatureLength];
+            if (!has_content_sha256)
+            {
+                unsigned char digest[kSha256DigestLength];
+                Sha256::digest(request.payload.data(), request.payload.length(), digest);
+                TextKernels::best().hexEncode(digest, sizeof(digest), payload_hash);
+                content_sha256 = std::string_view(payload_hash, sizeof(payload_hash));
+            }
+
+            return checkSignature(request, authorization, content_sha256, false, credential);
+        }
+
+        // Presigned: the X-Amz-* parameters, decoded, and the query string
+        // without X-Amz-Signature, which is what was signed
+        std::string credential_value, signed_headers, signature, date, expires, query;
+        std::string_view querystring = request.querystring;
+        bool presigned = false;
+        while (!querystring.empty())
+        {
+            size_t amp = querystring.find('&');
+            std::string_view pair = querystring.substr(0, amp);
+            querystring.remove_prefix(amp == std::string_view::npos ? querystring.length() : amp + 1);
+
+            size_t epos = pair.find('=');
+            std::string_view name = pair.substr(0, epos);
+            std::string_view value = epos == std::string_view::npos ? std::string_view() : pair.substr(epos + 1);
+            if (name == "X-Amz-Signature")
+            {
+                appendUriDecoded(signature, value);
+                presigned = true;
+                continue;
+            }
+
+            if (name == "X-Amz-Algorithm" && value != kAlgorithm)
+                return kMalformedAuthorization;
+            else if (name == "X-Amz-Credential")
+                appendUriDecoded(credential_value, value);
+            else if (name == "X-Amz-SignedHeaders")
+                appendUriDecoded(signed_headers, value);
+            else if (name == "X-Amz-Date")
+                appendUriDecoded(date, value);
+            else if (name == "X-Amz-Expires")
+                appendUriDecoded(expires, value);
+
+            if (!query.empty())
+                query += '&';
+            query.append(pair.data(), pair.length());
+        }
+        if (!presigned)
+            return kMissingAuthorization;
+
+        time_t time;
+        int expires_seconds;
+        if (!parseCredential(credential_value, authorization) || signed_headers.empty() || !parseAmzDate(date, time) ||
+            expires.length() > 6 || !parseDigits(expires, expires_seconds) || expires_seconds > kMaxExpires)
+            return kMalformedAuthorization;
+        authorization.signed_headers = signed_headers;
+        authorization.signature = signature;
+        formatRequestTime(time, authorization.time);
+
+        if (m_clock.now() > time + expires_seconds)
+        {
+            fillCredential(authorization, credential);
+            return kExpired;
+        }
+
+        SignRequest signed_request = request;
+        signed_request.querystring = query;
+        return checkSignature(signed_request, authorization, has_content_sha256 ? content_sha256 : std::string_view(PayloadHash::kUnsignedPayload), true, credential);
+    }
+
+}
@@ -0,0 +1,138 @@
+// Server side of SigV4: checking the signature of an incoming request
+// http://docs.aws.amazon.com/AmazonS3/latest/API/sig-v4-authenticating-requests.html
+
+#ifndef AWSSIGV4_VERIFY_H
+#define AWSSIGV4_VERIFY_H
+
+#include <functional>
+
+#include "awssigv4.h"
+#include "awssigv4_clock.h"
+#include "awssigv4_replay.h"
+
+namespace aws_sigv4 {
+
+    // Verifies requests signed for one region and service, authenticated
+    // either by an Authorization header or by a presigned query string. The
+    // canonical request is rebuilt with the signer's own canonicalisation,
+    // derived keys are cached per access key, date, region and service, and
+    // signatures are compared in constant time. verify() is const and may be
+    // called from any number of threads.
+    class Verifier
+    {
+        public:
+            enum Status
+            {
+                kVerified,
+                // Neither an Authorization header nor X-Amz-Signature
+                kMissingAuthorization,
+                // Authorization, credential or date that does not parse, or
+                // another algorithm than AWS4-HMAC-SHA256
+                kMalformedAuthorization,
+                // Credential for another region or service, or dated another
+                // day than the request
+                kWrongScope,
+                kUnknownAccessKey,
+                // Presigned URL used after X-Amz-Expires
+                kExpired,
+                // More signed headers or parameters than Signature::signRequest
+                // takes
+                kTooLarge,
+                kSignatureMismatch,
+                // Dated further from now than the allowed clock skew, or for
+                // a presigned URL, dated in the future by more than it
+                kRequestTimeTooSkewed,
+                // A correctly signed request whose signature was already seen
+                kReplayed,
+                // A correctly signed request the replay cache had no room to
+                // record, which therefore cannot be told apart from a replay
+                kReplayCacheFull
+            };
+
+            static const char *statusName(Status status);
+
+            // Fills secret_key for access_key and returns true, or returns
+            // false for an unknown key. Called on every verification, from
+            // any thread, so it should be a fast in-memory lookup; a changed
+            // secret takes effect on the next call.
+            typedef std::function<bool(std::string_view access_key, std::string &secret_key)> SecretLookup;
+
+            // Who signed a request, and when
+            struct Credential
+            {
+                std::string access_key;
+                std::string datestamp;
+                time_t request_time;
+            };
+
+            // The clock, read for presigned URL expiry and clock skew, must
+            // outlive the verifier
+            Verifier(
+                const std::string &region,
+                const std::string &service,
+                SecretLookup secret_lookup,
+                const Clock &clock=Clock::system()
+            );
+
+            // Paths are canonicalised as a Signature for the service would,
+            // uriNormalizationFor(service) unless set here
+            void setUriNormalization(UriNormalization mode);
+
+            // Cache derived keys in the given cache instead of the verifier's
+            // own. Must not race with verify().
+            void setKeyCache(SigningKeyCache *key_cache);
+
+            // Reject requests dated more than seconds away from the clock's
+            // time. 0, the default, turns the check off.
+            void setMaxClockSkew(time_t seconds);
+
+            // Reject requests whose Authorization header signature is
+            // already in cache, and record the others. Requests must then
+            // also be within the cache's window of the clock's time.
+            // Presigned URLs are meant to be reused and are not recorded.
+            // The cache must outlive the verifier; NULL turns this off.
+            void setReplayCache(ReplayCache *cache);
+
+            // Checks a request as received: method, path and raw query string
+            // from the request line, every header (any case, any order) and
+            // the body. The payload hash signed is x-amz-content-sha256 when
+            // the request carries one, as S3 requests do, and the caller
+            // must then check the body against it (unless it is
+            // UNSIGNED-PAYLOAD); otherwise the body is hashed here. Presigned
+            // URLs sign UNSIGNED-PAYLOAD. credential is filled as far as
+            // parsing got, whatever the result.
+            Status verify(const SignRequest &request, Credential *credential=NULL) const;
+
+        private:
+            std::string m_region;
+            std::string m_service;
+            SecretLookup m_secret_lookup;
+            const Clock &m_clock;
+            UriNormalization m_uri_normalization;
+            SigningKeyCache m_own_key_cache;
+            SigningKeyCache *m_key_cache;
+            time_t m_max_clock_skew;
+            ReplayCache *m_replay_cache;
+
+            Verifier(const Verifier &);
+            Verifier &operator=(const Verifier &);
+
+            struct Authorization;
+
+            static bool parseCredential(std::string_view credential, Authorization &authorization);
+            static void fillCredential(const Authorization &authorization, Credential *credential);
+
+            Status checkSignature(
+                const SignRequest &request,
+                const Authorization &authorization,
+                std::string_view payload_hash,
+                bool presigned,
+                Credential *credential
+            ) const;
+
+            void loadSigningKey(const Authorization &authorization, std::string_view secret_key, SigningKey &signing_key) const;
+    };
+
+}
+
+#endif
@@ -0,0 +1,672 @@
+// Micro benchmarks for the signing paths. Build and run with "make bench".
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#include "awssigv4.h"
+#include "awssigv4_async.h"
+#include "awssigv4_clock.h"
+#include "awssigv4_sha256.h"
+#include "awssigv4_text.h"
+#include "awssigv4_uri.h"
+#include "awssigv4_verify.h"
+#include "awssigv4_presign.h"
+#include "awssigv4_replay.h"
+
+#ifndef AWSSIGV4_NO_OPENSSL
+#include "openssl/hmac.h"
+#endif
+
+static const time_t kSigTime = 1315611360; // 20110909T233600Z
+
+static void Report(const std::string &name, double total_ns, size_t operations)
+{
+    std::cout << std::left << std::setw(48) << name << std::right << std::setw(12)
+              << std::fixed << std::setprecision(1) << total_ns / operations << " ns/op" << std::endl;
+}
+
+template <typename F>
+static double TimeNs(size_t iterations, F f)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+        f();
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+static void BenchBatchSigning()
+{
+    const size_t kIterations = 20000;
+    const size_t kBatchSize = 100;
+
+    std::map<std::string, std::vector<std::string> > header_map;
+    header_map["Content-Type"].push_back("application/x-amz-json-1.0");
+    header_map["Host"].push_back("dynamodb.us-east-1.amazonaws.com");
+    header_map["X-Amz-Date"].push_back("20110909T233600Z");
+    header_map["X-Amz-Target"].push_back("DynamoDB_20120810.PutItem");
+    std::string payload = "{\"TableName\":\"t\",\"Item\":{\"k\":{\"S\":\"v\"}}}";
+
+    aws_sigv4::HeaderField headers[] = {
+        {"Content-Type", "application/x-amz-json-1.0"},
+        {"Host", "dynamodb.us-east-1.amazonaws.com"},
+        {"X-Amz-Date", "20110909T233600Z"},
+        {"X-Amz-Target", "DynamoDB_20120810.PutItem"},
+    };
+
+    double single_ns = TimeNs(kIterations, [&]() {
+        aws_sigv4::Signature signature("dynamodb", "dynamodb.us-east-1.amazonaws.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", kSigTime);
+        std::string canonical_request = signature.createCanonicalRequest("POST", "/", "", header_map, payload);
+        std::string string_to_sign = signature.createStringToSign(canonical_request);
+        signature.createAuthorizationHeader(signature.createSignature(string_to_sign));
+    });
+    Report("sign: new Signature per request", single_ns, kIterations);
+
+    aws_sigv4::Signature signature("dynamodb", "dynamodb.us-east-1.amazonaws.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", kSigTime);
+    char out[512];
+    double view_ns = TimeNs(kIterations, [&]() {
+        signature.signRequest("POST", "/", "", headers, 4, payload, out, sizeof(out));
+    });
+    Report("sign: signRequest on a reused signer", view_ns, kIterations);
+
+    std::vector<aws_sigv4::SignRequest> requests(kBatchSize);
+    for (size_t i = 0; i < kBatchSize; i++)
+    {
+        aws_sigv4::SignRequest request = {"POST", "/", "", headers, 4, payload};
+        requests[i] = request;
+    }
+    std::vector<std::string> authorization_headers(kBatchSize);
+    double batch_ns = TimeNs(kIterations / kBatchSize, [&]() {
+        signature.signBatch(requests.data(), kBatchSize, authorization_headers.data());
+    });
+    Report("sign: signBatch, per request (batch of 100)", batch_ns, kIterations);
+
+    // One upload among small requests: it must not hold the SIMD lanes
+    std::string large_payload(1 << 20, 'x');
+    requests[0].payload = large_payload;
+    const size_t kUnevenIterations = 20;
+    double uneven_single_ns = TimeNs(kUnevenIterations, [&]() {
+        for (size_t i = 0; i < kBatchSize; i++)
+            signature.signRequest("POST", "/", "", headers, 4, requests[i].payload, out, sizeof(out));
+    });
+    Report("sign: signRequest, 1 MiB + 99 small, per batch", uneven_single_ns, kUnevenIterations);
+
+    aws_sigv4::RequestTime time;
+    aws_sigv4::formatRequestTime(kSigTime, time);
+    const aws_sigv4::MultiBufferSha256::Kernel kernels[] = {
+        aws_sigv4::MultiBufferSha256::kScalar,
+        aws_sigv4::MultiBufferSha256::kAvx2,
+        aws_sigv4::MultiBufferSha256::kAvx512
+    };
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+    {
+        if (!aws_sigv4::MultiBufferSha256::supported(kernels[k]))
+            continue;
+
+        aws_sigv4::MultiBufferSha256 hasher(kernels[k]);
+        double uneven_batch_ns = TimeNs(kUnevenIterations, [&]() {
+            signature.signBatch(time, requests.data(), kBatchSize, authorization_headers.data(), hasher);
+        });
+        Report(std::string("sign: signBatch ") + aws_sigv4::MultiBufferSha256::kernelName(kernels[k]) + ", 1 MiB + 99 small, per batch", uneven_batch_ns, kUnevenIterations);
+    }
+}
+
+// Canonical request from the map API, dominated by header canonicalisation
+static void BenchHeaderCanonicalization()
+{
+    const size_t kIterations = 50000;
+    const size_t kHeaderCounts[] = {5, 15, 40};
+
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", kSigTime);
+    for (size_t c = 0; c < sizeof(kHeaderCounts) / sizeof(kHeaderCounts[0]); c++)
+    {
+        std::map<std::string, std::vector<std::string> > header_map;
+        header_map["Host"].push_back("host.foo.com");
+        for (size_t i = 1; i < kHeaderCounts[c]; i++)
+            header_map["X-Amz-Meta-Field-" + std::to_string(i)].push_back(" value " + std::to_string(i * 7919) + " ");
+
+        double ns = TimeNs(kIterations, [&]() {
+            signature.createCanonicalRequest("GET", "/", "", header_map, "");
+        });
+        Report("headers: createCanonicalRequest, " + std::to_string(kHeaderCounts[c]) + " headers", ns, kIterations);
+    }
+}
+
+// The stringstream and map query canonicalisation the builder replaced,
+// which did no encoding at all
+static std::string SplitAndSortQuery(const std::string &query_string)
+{
+    std::map<std::string, std::vector<std::string> > query_map;
+    std::stringstream qss(query_string);
+    std::string query_pair;
+    while (std::getline(qss, query_pair, '&'))
+    {
+        if (query_pair.empty())
+            continue;
+        std::size_t epos = query_pair.find("=");
+        if (epos != std::string::npos)
+            query_map[query_pair.substr(0, epos)].push_back(query_pair.substr(epos + 1));
+        else
+            query_map[query_pair].push_back("");
+    }
+
+    std::string canonical;
+    for (std::map<std::string, std::vector<std::string> >::iterator it = query_map.begin(); it != query_map.end(); it++)
+    {
+        std::sort(it->second.begin(), it->second.end());
+        for (size_t i = 0; i < it->second.size(); i++)
+            canonical += (canonical.empty() ? "" : "&") + it->first + "=" + it->second[i];
+    }
+    return canonical;
+}
+
+// Canonical query strings at 10, 100 and 1000 parameters, in random order
+// and with every other value needing encoding
+static void BenchQueryCanonicalization()
+{
+    const size_t kParameterCounts[] = {10, 100, 1000};
+
+    for (size_t c = 0; c < sizeof(kParameterCounts) / sizeof(kParameterCounts[0]); c++)
+    {
+        size_t count = kParameterCounts[c];
+        size_t iterations = 2000000 / count;
+
+        std::string query;
+        uint32_t seed = 12345;
+        for (size_t i = 0; i < count; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            query += (i ? "&" : "") + std::string("param-") + std::to_string(seed >> 8)
+                + (i % 2 ? "=plain-value-" + std::to_string(i) : "=a value/with+reserved%2Fbytes");
+        }
+
+        double ns = TimeNs(iterations, [&]() {
+            SplitAndSortQuery(query);
+        });
+        Report("query: map and stringstream, " + std::to_string(count) + " params", ns, iterations);
+
+        aws_sigv4::CanonicalQueryBuilder builder;
+        std::string canonical;
+        ns = TimeNs(iterations, [&]() {
+            builder.clear();
+            builder.parse(query);
+            canonical.clear();
+            builder.appendTo(canonical);
+        });
+        Report("query: CanonicalQueryBuilder, " + std::to_string(count) + " params", ns, iterations);
+        Report("query: CanonicalQueryBuilder, per param", ns / count, iterations);
+    }
+
+    const size_t kIterations = 1000000;
+    std::string key = "photos/2011/09/vacation at the beach (1).jpg";
+    std::string encoded;
+    double ns = TimeNs(kIterations, [&]() {
+        encoded.clear();
+        aws_sigv4::appendUriEncoded(encoded, key, false);
+    });
+    Report("query: appendUriEncoded, 45 byte object key", ns, kIterations);
+}
+
+// Canonical URIs of deeply nested object keys: 8 and 64 levels, already
+// canonical or with spaces, dot segments and doubled slashes to clean up
+static void BenchUriNormalization()
+{
+    const size_t kDepths[] = {8, 64};
+    const aws_sigv4::UriNormalization kModes[] = {aws_sigv4::kUriEncodeOnce, aws_sigv4::kUriNormalize};
+    const char *kModeNames[] = {"encode once", "normalize"};
+
+    for (size_t d = 0; d < sizeof(kDepths) / sizeof(kDepths[0]); d++)
+    {
+        std::string canonical = "/bucket", messy = "/bucket";
+        for (size_t i = 0; i < kDepths[d]; i++)
+        {
+            canonical += "/level-" + std::to_string(i) + "-photos_2011";
+            messy += "/level " + std::to_string(i) + " photos+2011//./x/..";
+        }
+        canonical += "/IMG_0001.jpg";
+        messy += "/IMG 0001.jpg";
+
+        size_t iterations = 4000000 / (canonical.length() + messy.length());
+        std::vector<char> out(aws_sigv4::maxCanonicalUriLength(messy.length(), aws_sigv4::kUriNormalize));
+        for (size_t m = 0; m < sizeof(kModes) / sizeof(kModes[0]); m++)
+        {
+            std::string label = std::string("uri: ") + kModeNames[m] + ", " + std::to_string(kDepths[d]) + " levels";
+
+            double ns = TimeNs(iterations, [&]() {
+                aws_sigv4::isCanonicalUri(canonical, kModes[m]);
+            });
+            Report(label + ", check " + std::to_string(canonical.length()) + " B", ns, iterations);
+
+            ns = TimeNs(iterations, [&]() {
+                aws_sigv4::canonicalizeUri(messy, kModes[m], out.data());
+            });
+            Report(label + ", rewrite " + std::to_string(messy.length()) + " B", ns, iterations);
+        }
+    }
+}
+
+// Each text kernel on inputs shaped like header names, values and digests,
+// next to the per-character code they replace
+static void BenchTextKernels()
+{
+    const size_t kIterations = 1000000;
+    std::string name = "X-Amz-Server-Side-Encryption-Customer-Algorithm-Content-Type";
+    std::string padded = "   " + std::string(48, 'v') + "  \t ";
+    std::string spaced;
+    for (int i = 0; i < 16; i++)
+        spaced += "word" + std::string(i % 3 + 1, ' ');
+    unsigned char digest[aws_sigv4::kSha256DigestLength];
+    for (size_t i = 0; i < sizeof(digest); i++)
+        digest[i] = (unsigned char)(i * 37);
+    char out[256];
+    volatile size_t sink = 0;
+
+    double transform_ns = TimeNs(kIterations, [&]() {
+        std::transform(name.begin(), name.end(), out, ::tolower);
+        sink = sink + out[0];
+    });
+    Report("text: std::transform(::tolower), 62 B", transform_ns, kIterations);
+
+    double sprintf_ns = TimeNs(kIterations / 10, [&]() {
+        for (size_t i = 0; i < sizeof(digest); i++)
+            sprintf(out + 2 * i, "%02x", digest[i]);
+        sink = sink + out[0];
+    });
+    Report("text: sprintf(\"%02x\") per byte, 32 B", sprintf_ns, kIterations / 10);
+
+    const aws_sigv4::TextKernels::Kernel kernels[] = {
+        aws_sigv4::TextKernels::kScalar, aws_sigv4::TextKernels::kSse2,
+        aws_sigv4::TextKernels::kAvx2, aws_sigv4::TextKernels::kNeon
+    };
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+    {
+        if (!aws_sigv4::TextKernels::supported(kernels[k]))
+            continue;
+        const aws_sigv4::TextKernels text(kernels[k]);
+        const std::string label = std::string("text: ") + aws_sigv4::TextKernels::kernelName(kernels[k]);
+
+        double lowercase_ns = TimeNs(kIterations, [&]() {
+            text.lowercase(name.data(), name.length(), out);
+            sink = sink + out[0];
+        });
+        Report(label + " lowercase, 62 B", lowercase_ns, kIterations);
+
+        double trim_ns = TimeNs(kIterations, [&]() {
+            sink = sink + text.trim(padded).length();
+        });
+        Report(label + " trim, 56 B", trim_ns, kIterations);
+
+        double collapse_ns = TimeNs(kIterations, [&]() {
+            bool previous_space = false;
+            sink = sink + text.collapseWhitespace(spaced.data(), spaced.length(), out, previous_space);
+        });
+        Report(label + " collapse, " + std::to_string(spaced.length()) + " B", collapse_ns, kIterations);
+
+        double hex_ns = TimeNs(kIterations, [&]() {
+            text.hexEncode(digest, sizeof(digest), out);
+            sink = sink + out[0];
+        });
+        Report(label + " hex encode, 32 B", hex_ns, kIterations);
+    }
+}
+
+// Signing at the current time: a new Signature per request formats the
+// timestamp and builds the scope strings each time, a live signer reads
+// them from the per-second TimestampCache
+static void BenchTimestamps()
+{
+    const size_t kIterations = 200000;
+    aws_sigv4::HeaderField headers[] = {
+        {"Host", "dynamodb.us-east-1.amazonaws.com"},
+        {"X-Amz-Date", "20110909T233600Z"},
+    };
+    char out[512];
+
+    aws_sigv4::RequestTime request_time;
+    double format_ns = TimeNs(kIterations, [&]() {
+        aws_sigv4::formatRequestTime(time(NULL), request_time);
+    });
+    Report("time: gmtime_r + strftime", format_ns, kIterations);
+
+    const aws_sigv4::TimestampCache &timestamps = aws_sigv4::TimestampCache::system();
+    double cached_ns = TimeNs(kIterations, [&]() {
+        timestamps.now(request_time);
+    });
+    Report("time: TimestampCache::now", cached_ns, kIterations);
+
+    double new_signer_ns = TimeNs(kIterations / 10, [&]() {
+        aws_sigv4::Signature signature("dynamodb", "dynamodb.us-east-1.amazonaws.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE");
+        signature.signRequest("GET", "/", "", headers, 2, "", out, sizeof(out));
+    });
+    Report("time: new Signature at time(0) per request", new_signer_ns, kIterations / 10);
+
+    aws_sigv4::Signature live("dynamodb", "dynamodb.us-east-1.amazonaws.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", timestamps);
+    double live_ns = TimeNs(kIterations / 10, [&]() {
+        live.signRequest("GET", "/", "", headers, 2, "", out, sizeof(out));
+    });
+    Report("time: live signer on TimestampCache", live_ns, kIterations / 10);
+}
+
+// Final HMAC of a request: one-shot HMAC() re-hashes the ipad and opad
+// blocks of the key every time, the midstate version starts after them
+static void BenchHmacMidstates()
+{
+    const size_t kIterations = 200000;
+
+    unsigned char key[aws_sigv4::kSha256DigestLength];
+    memset(key, 0x0b, sizeof(key));
+    std::string string_to_sign = "AWS4-HMAC-SHA256\n20110909T233600Z\n20110909/us-east-1/dynamodb/aws4_request\n"
+                                 "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+    unsigned char digest[aws_sigv4::kSha256DigestLength];
+
+#ifndef AWSSIGV4_NO_OPENSSL
+    unsigned int digest_length = 0;
+    double one_shot_ns = TimeNs(kIterations, [&]() {
+        HMAC(EVP_sha256(), key, sizeof(key), (const unsigned char *)string_to_sign.data(), string_to_sign.length(), digest, &digest_length);
+    });
+    Report("hmac: one-shot HMAC()", one_shot_ns, kIterations);
+#endif
+
+    aws_sigv4::HmacSha256 keyed;
+    keyed.init(key, sizeof(key));
+    double midstate_ns = TimeNs(kIterations, [&]() {
+        aws_sigv4::HmacSha256 hmac = keyed;
+        hmac.update(string_to_sign);
+        hmac.final(digest);
+    });
+    Report("hmac: precomputed ipad/opad midstates", midstate_ns, kIterations);
+
+    aws_sigv4::Signature signature("dynamodb", "dynamodb.us-east-1.amazonaws.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", kSigTime);
+    double create_ns = TimeNs(kIterations, [&]() {
+        signature.createSignature(string_to_sign);
+    });
+    Report("hmac: Signature::createSignature", create_ns, kIterations);
+}
+
+// SHA-256 of many short messages (canonical request sized) per kernel
+static void BenchMultiBufferSha256()
+{
+    const size_t kIterations = 2000;
+    const size_t kMessages = 256;
+
+    std::string canonical_request = "POST\n/\n\ncontent-type:application/x-amz-json-1.0\nhost:dynamodb.us-east-1.amazonaws.com\n"
+                                    "x-amz-date:20110909T233600Z\nx-amz-target:DynamoDB_20120810.PutItem\n\n"
+                                    "content-type;host;x-amz-date;x-amz-target\n"
+                                    "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+    std::vector<std::string_view> messages(kMessages, canonical_request);
+    std::vector<unsigned char> digests(kMessages * aws_sigv4::MultiBufferSha256::kDigestLength);
+
+    double single_ns = TimeNs(kIterations, [&]() {
+        for (size_t i = 0; i < kMessages; i++)
+            aws_sigv4::Sha256::digest(messages[i].data(), messages[i].length(), &digests[i * aws_sigv4::MultiBufferSha256::kDigestLength]);
+    });
+    Report(std::string("sha256: one at a time (") + aws_sigv4::CryptoBackend::active().name() + "), per message", single_ns, kIterations * kMessages);
+
+    const aws_sigv4::MultiBufferSha256::Kernel kernels[] = {
+        aws_sigv4::MultiBufferSha256::kScalar,
+        aws_sigv4::MultiBufferSha256::kAvx2,
+        aws_sigv4::MultiBufferSha256::kAvx512
+    };
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+    {
+        if (!aws_sigv4::MultiBufferSha256::supported(kernels[k]))
+            continue;
+
+        aws_sigv4::MultiBufferSha256 hasher(kernels[k]);
+        double ns = TimeNs(kIterations, [&]() {
+            hasher.hash(messages.data(), kMessages, (unsigned char (*)[aws_sigv4::MultiBufferSha256::kDigestLength])digests.data());
+        });
+        Report(std::string("sha256: multi-buffer ") + aws_sigv4::MultiBufferSha256::kernelName(kernels[k]) + ", per message", ns, kIterations * kMessages);
+    }
+}
+
+// Each crypto backend on the payload sizes we sign: empty bodies, small
+// JSON/form bodies, canonical requests, and object uploads
+static void BenchCryptoBackends()
+{
+    const size_t kSizes[] = {0, 64, 256, 1024, 16 * 1024, 1024 * 1024};
+    std::string payload(kSizes[sizeof(kSizes) / sizeof(kSizes[0]) - 1], 'x');
+    unsigned char digest[aws_sigv4::kSha256DigestLength];
+
+    const aws_sigv4::CryptoBackend &previous = aws_sigv4::CryptoBackend::active();
+    for (size_t b = 0; aws_sigv4::CryptoBackend::available(b) != NULL; b++)
+    {
+        const aws_sigv4::CryptoBackend &backend = *aws_sigv4::CryptoBackend::available(b);
+        aws_sigv4::CryptoBackend::setActive(backend);
+
+        for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++)
+        {
+            size_t iterations = std::max<size_t>(20, (64 * 1024 * 1024) / (kSizes[i] + 64) / 16);
+            double one_shot_ns = TimeNs(iterations, [&]() {
+                backend.sha256(payload.data(), kSizes[i], digest);
+            });
+            Report(std::string("crypto: ") + backend.name() + " sha256 " + std::to_string(kSizes[i]) + " B", one_shot_ns, iterations);
+        }
+
+        aws_sigv4::HeaderField headers[] = {
+            {"Content-Type", "application/x-amz-json-1.0"},
+            {"Host", "dynamodb.us-east-1.amazonaws.com"},
+            {"X-Amz-Date", "20110909T233600Z"},
+        };
+        aws_sigv4::Signature signature("dynamodb", "dynamodb.us-east-1.amazonaws.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", kSigTime);
+        char out[512];
+        const size_t kIterations = 20000;
+        double sign_ns = TimeNs(kIterations, [&]() {
+            signature.signRequest("POST", "/", "", headers, 3, std::string_view(payload.data(), 256), out, sizeof(out));
+        });
+        Report(std::string("crypto: ") + backend.name() + " signRequest, 256 B body", sign_ns, kIterations);
+    }
+    aws_sigv4::CryptoBackend::setActive(previous);
+}
+
+// One Signature shared by 1 to N threads; wall time per request falls with
+// the thread count as long as signing scales
+static void BenchThreadScaling()
+{
+    const size_t kIterations = 20000;
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    aws_sigv4::HeaderField headers[] = {
+        {"Content-Type", "application/x-amz-json-1.0"},
+        {"Host", "dynamodb.us-east-1.amazonaws.com"},
+        {"X-Amz-Date", "20110909T233600Z"},
+        {"X-Amz-Target", "DynamoDB_20120810.PutItem"},
+    };
+    std::string payload = "{\"TableName\":\"t\",\"Item\":{\"k\":{\"S\":\"v\"}}}";
+    const aws_sigv4::Signature signature("dynamodb", "dynamodb.us-east-1.amazonaws.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", kSigTime);
+
+    for (size_t thread_count = 1; ; thread_count = std::min(thread_count * 2, max_threads))
+    {
+        double ns = TimeNs(1, [&]() {
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < thread_count; t++)
+            {
+                threads.push_back(std::thread([&]() {
+                    char out[512];
+                    for (size_t i = 0; i < kIterations; i++)
+                        signature.signRequest("POST", "/", "", headers, 4, payload, out, sizeof(out));
+                }));
+            }
+            for (size_t t = 0; t < thread_count; t++)
+                threads[t].join();
+        });
+        Report("threads: shared signer, " + std::to_string(thread_count) + " thread(s), wall per request", ns, kIterations * thread_count);
+
+        if (thread_count == max_threads)
+            break;
+    }
+}
+
+// Header-only signatures through the async executor: throughput with the
+// queue kept full, then the latency of one at a time while 100 MB bodies
+// hash on every worker
+static void BenchAsyncSigner()
+{
+    const size_t kIterations = 20000;
+    const size_t kLatencySamples = 200;
+    size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    aws_sigv4::HeaderField headers[] = {
+        {"Host", "examplebucket.s3.amazonaws.com"},
+        {"x-amz-content-sha256", "UNSIGNED-PAYLOAD"},
+        {"x-amz-date", "20110909T233600Z"},
+    };
+    const aws_sigv4::Signature signature("s3", "examplebucket.s3.amazonaws.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", kSigTime);
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+    aws_sigv4::SignRequest small = {"GET", "/photos/2011/09/IMG_0001.jpg", "", headers, 3, ""};
+
+    aws_sigv4::AsyncSigner async(signature, thread_count, 256);
+    double ns = TimeNs(1, [&]() {
+        std::atomic<size_t> done(0);
+        for (size_t i = 0; i < kIterations; i++)
+            async.submit(time, small, [&](const std::string &) { done++; });
+        while (done.load() < kIterations)
+            std::this_thread::yield();
+    });
+    Report("async: header-only, " + std::to_string(thread_count) + " worker(s), wall per request", ns, kIterations);
+
+    std::string large(100 << 20, 'x');
+    aws_sigv4::SignRequest upload = {"PUT", "/photos/large.bin", "", headers + 2, 1, large};
+    std::atomic<size_t> large_done(0);
+    for (size_t i = 0; i < thread_count; i++)
+        async.submit(time, upload, [&](const std::string &) { large_done++; });
+
+    std::vector<double> latencies;
+    while (latencies.size() < kLatencySamples && large_done.load() < thread_count)
+        latencies.push_back(TimeNs(1, [&]() { async.submit(time, small).get(); }));
+    std::sort(latencies.begin(), latencies.end());
+    if (!latencies.empty())
+    {
+        Report("async: header-only beside 100 MB bodies, p50", latencies[latencies.size() / 2], 1);
+        Report("async: header-only beside 100 MB bodies, p99", latencies[latencies.size() * 99 / 100], 1);
+        Report("async: header-only beside 100 MB bodies, max", latencies.back(), 1);
+    }
+    double large_ns = TimeNs(1, [&]() {
+        unsigned char digest[aws_sigv4::kSha256DigestLength];
+        aws_sigv4::Sha256::digest(large.data(), large.length(), digest);
+    });
+    Report("async: one 100 MB payload hash, for reference", large_ns, 1);
+}
+
+// Server-side verification of S3-style requests: one thread, so ns/op is
+// per core; verifications per second per core is 1e9 over it
+static void BenchVerifier()
+{
+    const size_t kIterations = 50000;
+    const aws_sigv4::Signature signature("s3", "examplebucket.s3.amazonaws.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", kSigTime);
+
+    aws_sigv4::HeaderField headers[] = {
+        {"Host", "examplebucket.s3.amazonaws.com"},
+        {"Range", "bytes=0-9"},
+        {"x-amz-content-sha256", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+        {"x-amz-date", "20110909T233600Z"},
+        {"User-Agent", "aws-sdk-cpp/1.11"},
+        {"Authorization", ""},
+    };
+    char authorization[512];
+    headers[5].value = std::string_view(authorization, signature.signRequest("GET", "/photos/2011/09/IMG_0001.jpg", "versionId=3", headers, 4, "", authorization, sizeof(authorization)));
+    aws_sigv4::SignRequest request = {"GET", "/photos/2011/09/IMG_0001.jpg", "versionId=3", headers, 6, ""};
+
+    aws_sigv4::FixedClock clock(kSigTime);
+    aws_sigv4::Verifier verifier("us-east-1", "s3", [](std::string_view, std::string &secret_key) {
+        secret_key = "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY";
+        return true;
+    }, clock);
+    if (verifier.verify(request) != aws_sigv4::Verifier::kVerified)
+        std::cerr << "verify: request does not verify" << std::endl;
+
+    double ns = TimeNs(kIterations, [&]() {
+        verifier.verify(request);
+    });
+    Report("verify: Authorization header, cached key", ns, kIterations);
+    std::cout << "verify: Authorization header, per core" << std::right << std::setw(28) << (size_t)(1e9 * kIterations / ns) << " /s" << std::endl;
+
+    ns = TimeNs(kIterations, [&]() {
+        char out[512];
+        signature.signRequest("GET", "/photos/2011/09/IMG_0001.jpg", "versionId=3", headers, 4, "", out, sizeof(out));
+    });
+    Report("verify: signing the same request, for reference", ns, kIterations);
+
+    aws_sigv4::Presigner presigner(signature, 3600);
+    std::string url = presigner.presign("GET", "/photos/2011/09/IMG_0001.jpg");
+    std::string query = url.substr(url.find('?') + 1);
+    aws_sigv4::SignRequest presigned = {"GET", "/photos/2011/09/IMG_0001.jpg", query, headers, 1, ""};
+    if (verifier.verify(presigned) != aws_sigv4::Verifier::kVerified)
+        std::cerr << "verify: presigned URL does not verify" << std::endl;
+    ns = TimeNs(kIterations, [&]() {
+        verifier.verify(presigned);
+    });
+    Report("verify: presigned URL, cached key", ns, kIterations);
+    std::cout << "verify: presigned URL, per core" << std::right << std::setw(35) << (size_t)(1e9 * kIterations / ns) << " /s" << std::endl;
+}
+
+// Replay cache insert and lookup with every thread on its own signatures,
+// as verifier threads would be; memory stays at the figure reported
+static void BenchReplayCache()
+{
+    const size_t kIterations = 100000;
+    const size_t kMaxThreads = 8;
+    aws_sigv4::ReplayCache cache(aws_sigv4::ReplayCache::kDefaultWindow, kIterations * kMaxThreads * 2);
+    std::cout << "replay: cache memory" << std::right << std::setw(43) << cache.memoryBytes() / 1024 << " KiB" << std::endl;
+
+    std::vector<unsigned char> signatures(kIterations * kMaxThreads * aws_sigv4::kSha256DigestLength);
+    for (uint64_t i = 0; i < kIterations * kMaxThreads; i++)
+        aws_sigv4::Sha256::digest(&i, sizeof(i), &signatures[i * aws_sigv4::kSha256DigestLength]);
+
+    for (size_t thread_count = 1; thread_count <= kMaxThreads; thread_count *= 2)
+    {
+        time_t base = kSigTime + (time_t)thread_count * 10000;
+        for (int pass = 0; pass < 2; pass++)
+        {
+            double ns = TimeNs(1, [&]() {
+                std::vector<std::thread> threads;
+                for (size_t t = 0; t < thread_count; t++)
+                {
+                    threads.push_back(std::thread([&, t]() {
+                        for (size_t i = t * kIterations; i < (t + 1) * kIterations; i++)
+                        {
+                            const unsigned char *signature = &signatures[i * aws_sigv4::kSha256DigestLength];
+                            time_t time = base + (time_t)(i % 600);
+                            if (pass == 0)
+                                cache.insert(signature, time);
+                            else
+                                cache.contains(signature, time);
+                        }
+                    }));
+                }
+                for (size_t t = 0; t < thread_count; t++)
+                    threads[t].join();
+            });
+            Report(std::string("replay: ") + (pass == 0 ? "insert, " : "contains, ") + std::to_string(thread_count) + " thread(s), wall per op", ns, kIterations * thread_count);
+        }
+    }
+}
+
+int main()
+{
+    BenchBatchSigning();
+    BenchTimestamps();
+    BenchHeaderCanonicalization();
+    BenchQueryCanonicalization();
+    BenchUriNormalization();
+    BenchTextKernels();
+    BenchHmacMidstates();
+    BenchMultiBufferSha256();
+    BenchCryptoBackends();
+    BenchThreadScaling();
+    BenchAsyncSigner();
+    BenchVerifier();
+    BenchReplayCache();
+
+    return 0;
+}
@@ -0,0 +1,185 @@
+// Throughput of MultipartSigner::signFile on a local file as the worker
+// count grows, from 1 to --max-threads (one per core by default) in powers
+// of two. Without --file a file of --size bytes is written to /tmp first
+// and removed at the end. One untimed pass warms the page cache, so the
+// rows measure hashing and signing rather than the disk. Results are CSV,
+// or JSON lines with --json; speedup is against the 1 thread row.
+//
+//   ./bench_multipart [--json] [--file=PATH] [--size=BYTES]
+//                     [--part-size=BYTES] [--max-threads=N] [--repeat=N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "awssigv4_multipart.h"
+
+static const time_t kSigTime = 1315611360; // 20110909T233600Z
+
+struct Options
+{
+    bool json;
+    std::string file;
+    uint64_t size;
+    size_t part_size;
+    size_t max_threads;
+    size_t repeat;
+};
+
+static Options g_options = {false, "", (uint64_t)2 << 30, aws_sigv4::MultipartSigner::kDefaultPartSize, 0, 3};
+
+// Writes size bytes of varied content to a new temporary file
+static bool WriteTestFile(std::string &path, uint64_t size)
+{
+    char name[] = "/tmp/bench_multipart_XXXXXX";
+    int fd = mkstemp(name);
+    if (fd < 0)
+        return false;
+    path = name;
+
+    std::vector<char> block(4 << 20);
+    for (size_t i = 0; i < block.size(); i++)
+        block[i] = (char)(i * 131 + i / 251);
+
+    for (uint64_t written = 0; written < size; )
+    {
+        size_t length = (size_t)std::min<uint64_t>(block.size(), size - written);
+        block[0] = (char)(written >> 22);
+        ssize_t result = write(fd, block.data(), length);
+        if (result <= 0)
+        {
+            close(fd);
+            unlink(name);
+            return false;
+        }
+        written += result;
+    }
+    close(fd);
+    return true;
+}
+
+static void PrintHeader()
+{
+    if (!g_options.json)
+        printf("threads,part_size,parts,bytes,seconds,mb_per_s,speedup\n");
+}
+
+static void PrintResult(size_t threads, size_t parts, uint64_t bytes, double seconds, double speedup)
+{
+    double mb_per_s = bytes / seconds / 1e6;
+    if (g_options.json)
+        printf("{\"threads\":%zu,\"part_size\":%zu,\"parts\":%zu,\"bytes\":%llu,\"seconds\":%.3f,\"mb_per_s\":%.1f,\"speedup\":%.2f}\n",
+               threads, g_options.part_size, parts, (unsigned long long)bytes, seconds, mb_per_s, speedup);
+    else
+        printf("%zu,%zu,%zu,%llu,%.3f,%.1f,%.2f\n",
+               threads, g_options.part_size, parts, (unsigned long long)bytes, seconds, mb_per_s, speedup);
+    fflush(stdout);
+}
+
+// Best of --repeat runs, in seconds, or a negative value if signing failed
+static double SignFile(const aws_sigv4::Signature &signature, size_t threads, const std::string &path, std::vector<aws_sigv4::MultipartSigner::Part> &parts)
+{
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+    aws_sigv4::HeaderField host[] = {{"Host", "examplebucket.s3.amazonaws.com"}};
+    aws_sigv4::MultipartSigner multipart(signature, g_options.part_size, threads);
+
+    double best = -1;
+    for (size_t r = 0; r < g_options.repeat; r++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!multipart.signFile(time, "/examplebucket/large-object.bin", "VXBsb2FkIElE", host, 1, path.c_str(), parts))
+            return -1;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (best < 0 || seconds < best)
+            best = seconds;
+    }
+    return best;
+}
+
+static bool ParseOptions(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--json") == 0)
+            g_options.json = true;
+        else if (strncmp(arg, "--file=", 7) == 0)
+            g_options.file = arg + 7;
+        else if (strncmp(arg, "--size=", 7) == 0)
+            g_options.size = strtoull(arg + 7, NULL, 10);
+        else if (strncmp(arg, "--part-size=", 12) == 0)
+            g_options.part_size = strtoull(arg + 12, NULL, 10);
+        else if (strncmp(arg, "--max-threads=", 14) == 0)
+            g_options.max_threads = strtoull(arg + 14, NULL, 10);
+        else if (strncmp(arg, "--repeat=", 9) == 0)
+            g_options.repeat = std::max(1ULL, strtoull(arg + 9, NULL, 10));
+        else
+        {
+            fprintf(stderr, "usage: %s [--json] [--file=PATH] [--size=BYTES] [--part-size=BYTES] [--max-threads=N] [--repeat=N]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (!ParseOptions(argc, argv))
+        return 2;
+    if (g_options.part_size == 0)
+        g_options.part_size = aws_sigv4::MultipartSigner::kDefaultPartSize;
+    else if (g_options.part_size < aws_sigv4::MultipartSigner::kMinPartSize)
+        g_options.part_size = aws_sigv4::MultipartSigner::kMinPartSize;
+    if (g_options.max_threads == 0)
+        g_options.max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::string path = g_options.file;
+    bool temporary = path.empty();
+    if (temporary && !WriteTestFile(path, g_options.size))
+    {
+        fprintf(stderr, "cannot write a %llu byte file in /tmp\n", (unsigned long long)g_options.size);
+        return 1;
+    }
+
+    aws_sigv4::Signature signature("s3", "examplebucket.s3.amazonaws.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", kSigTime);
+    std::vector<aws_sigv4::MultipartSigner::Part> parts;
+
+    // Warm the page cache
+    size_t saved_repeat = g_options.repeat;
+    g_options.repeat = 1;
+    bool readable = SignFile(signature, g_options.max_threads, path, parts) >= 0;
+    g_options.repeat = saved_repeat;
+
+    int status = 0;
+    if (!readable)
+    {
+        fprintf(stderr, "cannot sign %s (unreadable, or more than %zu parts)\n", path.c_str(), aws_sigv4::MultipartSigner::kMaxParts);
+        status = 1;
+    }
+    else
+    {
+        uint64_t bytes = parts.back().offset + parts.back().length;
+        PrintHeader();
+
+        double serial = 0;
+        for (size_t threads = 1; ; threads = std::min(threads * 2, g_options.max_threads))
+        {
+            double seconds = SignFile(signature, threads, path, parts);
+            if (threads == 1)
+                serial = seconds;
+            PrintResult(threads, parts.size(), bytes, seconds, serial / seconds);
+            if (threads == g_options.max_threads)
+                break;
+        }
+    }
+
+    if (temporary)
+        unlink(path.c_str());
+    return status;
+}
@@ -0,0 +1,296 @@
+// Per-stage benchmarks of the signing API, swept over header count, query
+// parameter count and payload size. Results are written as CSV (or JSON
+// lines with --json), one row per stage and size, so runs of two builds can
+// be joined on stage, headers, params and payload_bytes and compared.
+// The label defaults to "stats" in a "make STATS=1" build and "default"
+// otherwise; the stage_timer row is the cost of timing and recording one
+// stage, of which signRequest records five or six.
+//
+//   ./bench_stages [--json] [--label=NAME] [--max-payload=BYTES]
+//                  [--min-time-ms=N] [--stage=NAME]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "awssigv4.h"
+#include "awssigv4_stats.h"
+#include "awssigv4_uri.h"
+
+static const time_t kSigTime = 1315611360; // 20110909T233600Z
+
+struct Options
+{
+    bool json;
+    std::string label;
+    size_t max_payload;
+    double min_time_ns;
+    std::string stage;
+};
+
+static Options g_options = {false, "", (size_t)1 << 30, 200e6, ""};
+
+// One request of a sweep, in both the map and the view forms
+struct BenchRequest
+{
+    size_t header_count;
+    size_t param_count;
+    std::string query;
+    std::string payload;
+    std::map<std::string, std::vector<std::string> > header_map;
+    std::vector<std::string> names, values;
+    std::vector<aws_sigv4::HeaderField> headers;
+
+    BenchRequest(size_t header_count, size_t param_count, size_t payload_bytes) :
+        header_count(header_count),
+        param_count(param_count),
+        payload(payload_bytes, 'p')
+    {
+        // Host and x-amz-date, then metadata headers, in no particular order
+        names.push_back("Host");
+        values.push_back("examplebucket.s3.amazonaws.com");
+        names.push_back("X-Amz-Date");
+        values.push_back("20110909T233600Z");
+        for (size_t i = names.size(); i < header_count; i++)
+        {
+            names.push_back("X-Amz-Meta-Field" + std::to_string((i * 7919) % 1000));
+            values.push_back("  value of field  " + std::to_string(i));
+        }
+        names.resize(header_count);
+        values.resize(header_count);
+        for (size_t i = 0; i < header_count; i++)
+        {
+            header_map[names[i]].push_back(values[i]);
+            aws_sigv4::HeaderField field = {names[i], values[i]};
+            headers.push_back(field);
+        }
+
+        // Parameters in reverse order, some needing escapes
+        for (size_t i = param_count; i > 0; i--)
+        {
+            if (!query.empty())
+                query += '&';
+            query += "param" + std::to_string(i) + "=value " + std::to_string(i) + "/x";
+        }
+    }
+
+    aws_sigv4::SignRequest view() const
+    {
+        aws_sigv4::SignRequest request = {"PUT", "/photos/2011/09/IMG 0001.jpg", query, headers.data(), headers.size(), payload};
+        return request;
+    }
+};
+
+static aws_sigv4::Signature Signer()
+{
+    return aws_sigv4::Signature("s3", "examplebucket.s3.amazonaws.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", kSigTime);
+}
+
+static void PrintHeader()
+{
+    if (!g_options.json)
+        printf("label,stage,headers,params,payload_bytes,iterations,ns_per_op,mb_per_s\n");
+}
+
+static void PrintResult(const char *stage, const BenchRequest *request, size_t iterations, double ns)
+{
+    size_t headers = request != NULL ? request->header_count : 0;
+    size_t params = request != NULL ? request->param_count : 0;
+    size_t payload_bytes = request != NULL ? request->payload.size() : 0;
+    double ns_per_op = ns / iterations;
+    double mb_per_s = payload_bytes > 0 ? payload_bytes / ns_per_op * 1e3 : 0;
+
+    if (g_options.json)
+        printf("{\"label\":\"%s\",\"stage\":\"%s\",\"headers\":%zu,\"params\":%zu,\"payload_bytes\":%zu,\"iterations\":%zu,\"ns_per_op\":%.1f,\"mb_per_s\":%.1f}\n",
+               g_options.label.c_str(), stage, headers, params, payload_bytes, iterations, ns_per_op, mb_per_s);
+    else
+        printf("%s,%s,%zu,%zu,%zu,%zu,%.1f,%.1f\n",
+               g_options.label.c_str(), stage, headers, params, payload_bytes, iterations, ns_per_op, mb_per_s);
+    fflush(stdout);
+}
+
+// Runs f in doubling batches until a batch takes at least --min-time-ms,
+// or 2^30 iterations for code that compiles to nothing, and reports that
+// batch
+template <typename F>
+static void Run(const char *stage, const BenchRequest *request, F f)
+{
+    if (!g_options.stage.empty() && g_options.stage != stage)
+        return;
+
+    for (size_t iterations = 1; ; iterations *= 2)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+            f();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (ns >= g_options.min_time_ns || iterations == (size_t)1 << 30)
+        {
+            PrintResult(stage, request, iterations, ns);
+            return;
+        }
+    }
+}
+
+// Stages whose cost depends on the headers and query only
+static void BenchRequestShape(const BenchRequest &request)
+{
+    aws_sigv4::Signature signature = Signer();
+    aws_sigv4::SignRequest view = request.view();
+    std::string canonical_request = signature.createCanonicalRequest(std::string(view.method), std::string(view.canonical_uri), request.query, request.header_map, request.payload);
+
+    Run("canonicalize_query", &request, [&]() {
+        aws_sigv4::CanonicalQueryBuilder builder;
+        builder.parse(request.query);
+        std::string out;
+        builder.appendTo(out);
+    });
+    Run("hash_canonical_request", &request, [&]() {
+        unsigned char digest[aws_sigv4::kSha256DigestLength];
+        aws_sigv4::hashCanonicalRequest(view, "UNSIGNED-PAYLOAD", signature.uriNormalization(), digest);
+    });
+    Run("create_string_to_sign", &request, [&]() {
+        signature.createStringToSign(canonical_request);
+    });
+}
+
+// Stages that see the whole request, payload included
+static void BenchEndToEnd(const BenchRequest &request)
+{
+    aws_sigv4::Signature signature = Signer();
+    aws_sigv4::SignRequest view = request.view();
+    std::string method(view.method), path(view.canonical_uri);
+
+    Run("create_canonical_request", &request, [&]() {
+        signature.createCanonicalRequest(method, path, request.query, request.header_map, request.payload);
+    });
+    Run("sign_steps_1_to_4", &request, [&]() {
+        std::string canonical_request = signature.createCanonicalRequest(method, path, request.query, request.header_map, request.payload);
+        signature.createAuthorizationHeader(signature.createSignature(signature.createStringToSign(canonical_request)));
+    });
+    Run("sign_request_map", &request, [&]() {
+        signature.signRequest(method, path, request.query, request.header_map, request.payload);
+    });
+    Run("sign_request_views", &request, [&]() {
+        char out[4096];
+        signature.signRequest(view.method, view.canonical_uri, view.querystring, view.headers, view.header_count, view.payload, out, sizeof(out));
+    });
+
+    // The payload is not read in these two modes
+    unsigned char digest[aws_sigv4::kSha256DigestLength];
+    aws_sigv4::Sha256::digest(request.payload.data(), request.payload.length(), digest);
+    aws_sigv4::PayloadHash precomputed = aws_sigv4::PayloadHash::fromDigest(digest);
+    Run("sign_request_precomputed", &request, [&]() {
+        char out[4096];
+        signature.signRequest(view.method, view.canonical_uri, view.querystring, view.headers, view.header_count, precomputed, out, sizeof(out));
+    });
+    Run("sign_request_unsigned", &request, [&]() {
+        char out[4096];
+        signature.signRequest(view.method, view.canonical_uri, view.querystring, view.headers, view.header_count, aws_sigv4::PayloadHash::unsignedPayload(), out, sizeof(out));
+    });
+
+    // x-amz-date varies, every other header is prepared
+    std::string_view date_name = request.names[1];
+    std::string_view date_value = request.values[1];
+    std::vector<aws_sigv4::HeaderField> fixed(request.headers);
+    fixed.erase(fixed.begin() + 1);
+    aws_sigv4::PreparedRequest prepared(signature, view.method, view.canonical_uri, fixed.data(), fixed.size(), &date_name, 1);
+    Run("sign_prepared", &request, [&]() {
+        char out[4096];
+        prepared.sign(&date_value, view.querystring, view.payload, out, sizeof(out));
+    });
+}
+
+// Stages of fixed size
+static void BenchFixed()
+{
+    aws_sigv4::Signature signature = Signer();
+    BenchRequest request(4, 4, 0);
+    std::string canonical_request = signature.createCanonicalRequest("PUT", "/", request.query, request.header_map, "");
+    std::string string_to_sign = signature.createStringToSign(canonical_request);
+    std::string hex_signature = signature.createSignature(string_to_sign);
+
+    Run("stage_timer", NULL, []() {
+        AWSSIGV4_STAGE_BEGIN(kStageSignature);
+        AWSSIGV4_STAGE_END(kStageSignature, 0);
+    });
+    Run("derive_signing_key", NULL, []() {
+        aws_sigv4::SigningKey signing_key;
+        aws_sigv4::deriveSigningKey("wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "20110909", "us-east-1", "s3", signing_key);
+    });
+    Run("create_signature", NULL, [&]() {
+        signature.createSignature(string_to_sign);
+    });
+    Run("create_authorization_header", NULL, [&]() {
+        signature.createAuthorizationHeader(hex_signature);
+    });
+}
+
+static bool ParseOptions(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--json") == 0)
+            g_options.json = true;
+        else if (strncmp(arg, "--label=", 8) == 0)
+            g_options.label = arg + 8;
+        else if (strncmp(arg, "--max-payload=", 14) == 0)
+            g_options.max_payload = strtoull(arg + 14, NULL, 10);
+        else if (strncmp(arg, "--min-time-ms=", 14) == 0)
+            g_options.min_time_ns = strtod(arg + 14, NULL) * 1e6;
+        else if (strncmp(arg, "--stage=", 8) == 0)
+            g_options.stage = arg + 8;
+        else
+        {
+            fprintf(stderr, "usage: %s [--json] [--label=NAME] [--max-payload=BYTES] [--min-time-ms=N] [--stage=NAME]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (!ParseOptions(argc, argv))
+        return 2;
+    if (g_options.label.empty())
+        g_options.label = aws_sigv4::SigningStats::enabled() ? "stats" : "default";
+
+    static const size_t kHeaderCounts[] = {2, 4, 16, 64};
+    static const size_t kParamCounts[] = {0, 4, 16, 64, 256};
+    static const size_t kPayloadSizes[] = {0, 1 << 10, 64 << 10, 1 << 20, 16 << 20, 256 << 20, 1 << 30};
+
+    PrintHeader();
+    BenchFixed();
+
+    // Each sweep varies one dimension, the others at 4 headers, 4
+    // parameters and an empty payload
+    for (size_t i = 0; i < sizeof(kHeaderCounts) / sizeof(kHeaderCounts[0]); i++)
+    {
+        BenchRequest request(kHeaderCounts[i], 4, 0);
+        BenchRequestShape(request);
+        BenchEndToEnd(request);
+    }
+    for (size_t i = 0; i < sizeof(kParamCounts) / sizeof(kParamCounts[0]); i++)
+    {
+        if (kParamCounts[i] == 4)
+            continue;
+        BenchRequest request(4, kParamCounts[i], 0);
+        BenchRequestShape(request);
+        BenchEndToEnd(request);
+    }
+    for (size_t i = 0; i < sizeof(kPayloadSizes) / sizeof(kPayloadSizes[0]); i++)
+    {
+        if (kPayloadSizes[i] == 0 || kPayloadSizes[i] > g_options.max_payload)
+            continue;
+        BenchRequest request(4, 4, kPayloadSizes[i]);
+        BenchEndToEnd(request);
+    }
+
+    return 0;
+}
@@ -6,8 +6,39 @@
 #include <functional> 
 #include <cctype>
 #include <locale>
+#include <atomic>
+#include <new>
+#include <cstdlib>
 
 #include "awssigv4.h"
+#include "awssigv4_incremental.h"
+#include "awssigv4_sha256.h"
+#include "awssigv4_text.h"
+
+// Count heap allocations made while g_count_allocations is set
+static std::atomic<bool> g_count_allocations(false);
+static std::atomic<size_t> g_allocation_count(0);
+
+void *operator new(std::size_t size)
+{
+    if (g_count_allocations.load(std::memory_order_relaxed))
+        g_allocation_count++;
+
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
 
 std::string GetWholeFile(std::string file_name)
 {
@@ -245,6 +276,70 @@ TEST(createCanonicalRequest, get_header_value_trim)
 }
 
 
+TEST(createCanonicalRequest, get_relative)
+{
+    std::string canonical_request = GetCreateCanonicalRequest("aws4_testsuite/get-relative.req");
+
+    EXPECT_EQ(canonical_request, GetWholeFile("aws4_testsuite/get-relative.creq"));
+}
+
+
+TEST(createCanonicalRequest, get_relative_relative)
+{
+    std::string canonical_request = GetCreateCanonicalRequest("aws4_testsuite/get-relative-relative.req");
+
+    EXPECT_EQ(canonical_request, GetWholeFile("aws4_testsuite/get-relative-relative.creq"));
+}
+
+
+TEST(createCanonicalRequest, get_slash)
+{
+    std::string canonical_request = GetCreateCanonicalRequest("aws4_testsuite/get-slash.req");
+
+    EXPECT_EQ(canonical_request, GetWholeFile("aws4_testsuite/get-slash.creq"));
+}
+
+
+TEST(createCanonicalRequest, get_slash_dot_slash)
+{
+    std::string canonical_request = GetCreateCanonicalRequest("aws4_testsuite/get-slash-dot-slash.req");
+
+    EXPECT_EQ(canonical_request, GetWholeFile("aws4_testsuite/get-slash-dot-slash.creq"));
+}
+
+
+TEST(createCanonicalRequest, get_slash_pointless_dot)
+{
+    std::string canonical_request = GetCreateCanonicalRequest("aws4_testsuite/get-slash-pointless-dot.req");
+
+    EXPECT_EQ(canonical_request, GetWholeFile("aws4_testsuite/get-slash-pointless-dot.creq"));
+}
+
+
+TEST(createCanonicalRequest, get_slashes)
+{
+    std::string canonical_request = GetCreateCanonicalRequest("aws4_testsuite/get-slashes.req");
+
+    EXPECT_EQ(canonical_request, GetWholeFile("aws4_testsuite/get-slashes.creq"));
+}
+
+
+TEST(createCanonicalRequest, get_space)
+{
+    std::string canonical_request = GetCreateCanonicalRequest("aws4_testsuite/get-space.req");
+
+    EXPECT_EQ(canonical_request, GetWholeFile("aws4_testsuite/get-space.creq"));
+}
+
+
+TEST(createCanonicalRequest, get_utf8)
+{
+    std::string canonical_request = GetCreateCanonicalRequest("aws4_testsuite/get-utf8.req");
+
+    EXPECT_EQ(canonical_request, GetWholeFile("aws4_testsuite/get-utf8.creq"));
+}
+
+
 TEST(createCanonicalRequest, get_vanilla)
 {
     std::string canonical_request = GetCreateCanonicalRequest("aws4_testsuite/get-vanilla.req");
@@ -300,6 +395,30 @@ TEST(createCanonicalRequest,get_vanilla_query_unreserved)
 }
 
 
+TEST(createCanonicalRequest, get_vanilla_ut8_query)
+{
+    std::string canonical_request = GetCreateCanonicalRequest("aws4_testsuite/get-vanilla-ut8-query.req");
+
+    EXPECT_EQ(canonical_request, GetWholeFile("aws4_testsuite/get-vanilla-ut8-query.creq"));
+}
+
+
+TEST(createCanonicalRequest, post_vanilla_query_nonunreserved)
+{
+    std::string canonical_request = GetCreateCanonicalRequest("aws4_testsuite/post-vanilla-query-nonunreserved.req");
+
+    EXPECT_EQ(canonical_request, GetWholeFile("aws4_testsuite/post-vanilla-query-nonunreserved.creq"));
+}
+
+
+TEST(createCanonicalRequest, post_vanilla_query_space)
+{
+    std::string canonical_request = GetCreateCanonicalRequest("aws4_testsuite/post-vanilla-query-space.req");
+
+    EXPECT_EQ(canonical_request, GetWholeFile("aws4_testsuite/post-vanilla-query-space.creq"));
+}
+
+
 TEST(createCanonicalRequest,post_header_key_case)
 {
     std::string canonical_request = GetCreateCanonicalRequest("aws4_testsuite/post-header-key-case.req");
@@ -363,6 +482,101 @@ TEST(createCanonicalRequest,post_x_www_form_urlencoded_parameters)
     EXPECT_EQ(canonical_request, GetWholeFile("aws4_testsuite/post-x-www-form-urlencoded-parameters.creq"));
 }
 
+TEST(createCanonicalRequest, many_headers)
+{
+    // More headers than the canonicalizer keeps inline, inserted so that
+    // map order and canonical order differ
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE");
+    std::map<std::string, std::vector<std::string> > header_map;
+    std::string expected_headers, expected_signed;
+    for (int i = 0; i < 40; i++)
+    {
+        char name[16], value[16];
+        snprintf(name, sizeof(name), "%s-%02d", i % 2 ? "X-Odd" : "x-even", i);
+        snprintf(value, sizeof(value), "v%d", 40 - i);
+        header_map[name].push_back(std::string("  ") + value + " ");
+    }
+    for (int i = 0; i < 40; i += 2)
+    {
+        char line[32];
+        snprintf(line, sizeof(line), "x-even-%02d:v%d\n", i, 40 - i);
+        expected_headers += line;
+        expected_signed += std::string(expected_signed.empty() ? "" : ";") + std::string(line, 9);
+    }
+    for (int i = 1; i < 40; i += 2)
+    {
+        char line[32];
+        snprintf(line, sizeof(line), "x-odd-%02d:v%d\n", i, 40 - i);
+        expected_headers += line;
+        expected_signed += ";" + std::string(line, 8);
+    }
+
+    std::string canonical_request = signature.createCanonicalRequest("GET", "/", "", header_map, "");
+    EXPECT_EQ(canonical_request, "GET\n/\n\n" + expected_headers + "\n" + expected_signed +
+              "\ne3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+}
+
+TEST(createCanonicalRequest, many_query_parameters)
+{
+    // More parameters than the view path sorts, given in reverse order
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE");
+    std::map<std::string, std::vector<std::string> > header_map;
+    header_map["Host"].push_back("host.foo.com");
+    size_t count = (size_t)aws_sigv4::Signature::kMaxQueryParameters + 1;
+    std::string querystring, expected_query;
+    for (size_t i = 0; i < count; i++)
+    {
+        char param[32];
+        snprintf(param, sizeof(param), "p%04zu=v%zu", count - 1 - i, i);
+        querystring += std::string(querystring.empty() ? "" : "&") + param;
+        snprintf(param, sizeof(param), "p%04zu=v%zu", i, count - 1 - i);
+        expected_query += std::string(expected_query.empty() ? "" : "&") + param;
+    }
+
+    std::string canonical_request = signature.createCanonicalRequest("GET", "/", querystring, header_map, "");
+    EXPECT_EQ(canonical_request, "GET\n/\n" + expected_query + "\nhost:host.foo.com\n\nhost\n"
+              "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+}
+
+TEST(createCanonicalRequest, header_names_differing_in_case_merge)
+{
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE");
+    std::map<std::string, std::vector<std::string> > header_map;
+    header_map["Host"].push_back("host.foo.com");
+    header_map["X-Tag"].push_back("b");
+    header_map["x-tag"].push_back(" a");
+    header_map["x-tag"].push_back("c ");
+    header_map["X-Empty"];
+
+    std::string canonical_request = signature.createCanonicalRequest("GET", "/", "", header_map, "");
+    EXPECT_EQ(canonical_request, "GET\n/\n\nhost:host.foo.com\nx-empty:\nx-tag:a,b,c\n\nhost;x-empty;x-tag\n"
+              "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+}
+
+TEST(createCanonicalRequest, get_header_value_multiline)
+{
+    // get-header-value-multiline.req: the folded lines of "p" arrive as one
+    // value, and every run of whitespace in it becomes a single space
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE");
+    std::map<std::string, std::vector<std::string> > header_map;
+    header_map["DATE"].push_back("Mon, 09 Sep 2011 23:36:00 GMT");
+    header_map["host"].push_back("host.foo.com");
+    header_map["p"].push_back("a\r\n  b\r\n\tc");
+    header_map["q"].push_back("x  \t y");
+
+    std::string canonical_request = signature.createCanonicalRequest("POST", "/", "", header_map, "");
+    EXPECT_EQ(canonical_request, "POST\n/\n\ndate:Mon, 09 Sep 2011 23:36:00 GMT\nhost:host.foo.com\np:a b c\nq:x y\n\ndate;host;p;q\n"
+              "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+
+    // The view API canonicalises the same way
+    aws_sigv4::HeaderField headers[] = {
+        {"DATE", "Mon, 09 Sep 2011 23:36:00 GMT"}, {"host", "host.foo.com"}, {"p", "a\r\n  b\r\n\tc"}, {"q", "x  \t y"}
+    };
+    char out[512];
+    EXPECT_EQ(std::string(out, signature.signRequest("POST", "/", "", headers, 4, "", out, sizeof(out))),
+              signature.signRequest("POST", "/", "", header_map, ""));
+}
+
 // Task 2: Create a String to Sign for Signature Version 4
 TEST(createStringToSign, get_header_key_duplicate)
 {
@@ -746,3 +960,529 @@ TEST(createAuthorizationHeader, post_x_www_form_urlencoded_parameters)
 
     EXPECT_EQ(authorization_header, GetWholeFile("aws4_testsuite/post-x-www-form-urlencoded-parameters.authz"));
 }
+
+// Derived signing key cache
+
+static time_t TestSuiteTime(int day)
+{
+    struct tm timeinfo;
+    memset(&timeinfo, 0, sizeof(timeinfo));
+    timeinfo.tm_year = 2011 - 1900;
+    timeinfo.tm_mon = 9 - 1;
+    timeinfo.tm_mday = day;
+    timeinfo.tm_hour = 23;
+    timeinfo.tm_min = 36;
+    timeinfo.tm_sec = 0;
+
+    return timegm(&timeinfo);
+}
+
+static std::string SignVanilla(aws_sigv4::Signature &signature)
+{
+    std::map<std::string, std::vector<std::string> > header_map;
+    header_map["Date"].push_back("Mon, 09 Sep 2011 23:36:00 GMT");
+    header_map["Host"].push_back("host.foo.com");
+
+    std::string canonical_request = signature.createCanonicalRequest("GET", "/", "", header_map, "");
+    std::string string_to_sign = signature.createStringToSign(canonical_request);
+
+    return signature.createAuthorizationHeader(signature.createSignature(string_to_sign));
+}
+
+TEST(deriveSigningKey, documented_example)
+{
+    // The key derivation example from the SigV4 documentation
+    aws_sigv4::SigningKey signing_key;
+    aws_sigv4::deriveSigningKey("wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "20120215", "us-east-1", "iam", signing_key);
+
+    char hex[2 * aws_sigv4::kSha256DigestLength];
+    aws_sigv4::TextKernels::best().hexEncode(signing_key.key, sizeof(signing_key.key), hex);
+    EXPECT_EQ(std::string(hex, sizeof(hex)), "f4780e2d9f65fa895f9c67b32ce1baf0b0d8a43505a000a1a9e090d414db404d");
+}
+
+TEST(SigningKeyCache, lookup_matches_scope_and_secret)
+{
+    aws_sigv4::SigningKeyCache cache(4);
+    aws_sigv4::SigningKey stored, found;
+    memset(stored.key, 0x5a, sizeof(stored.key));
+    stored.hmac.init(stored.key, sizeof(stored.key));
+
+    EXPECT_FALSE(cache.lookup("AKIDEXAMPLE/20110909/us-east-1/host", "secret", found));
+
+    cache.store("AKIDEXAMPLE/20110909/us-east-1/host", "secret", stored);
+
+    ASSERT_TRUE(cache.lookup("AKIDEXAMPLE/20110909/us-east-1/host", "secret", found));
+    EXPECT_EQ(0, memcmp(stored.key, found.key, sizeof(found.key)));
+
+    EXPECT_FALSE(cache.lookup("AKIDEXAMPLE/20110910/us-east-1/host", "secret", found));
+    EXPECT_FALSE(cache.lookup("AKIDEXAMPLE/20110909/us-east-1/host", "other secret", found));
+}
+
+TEST(SigningKeyCache, signer_uses_cached_key)
+{
+    aws_sigv4::SigningKeyCache cache;
+    aws_sigv4::SigningKey bogus;
+    memset(bogus.key, 0, sizeof(bogus.key));
+    bogus.hmac.init(bogus.key, sizeof(bogus.key));
+    cache.store("AKIDEXAMPLE/20110909/us-east-1/host", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", bogus);
+
+    aws_sigv4::Signature uncached("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+    uncached.setKeyCache(NULL);
+    aws_sigv4::Signature cached("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+    cached.setKeyCache(&cache);
+
+    EXPECT_EQ(SignVanilla(uncached), GetWholeFile("aws4_testsuite/get-vanilla.authz"));
+    EXPECT_NE(SignVanilla(cached), SignVanilla(uncached));
+}
+
+TEST(SigningKeyCache, shared_key_rolls_over_with_date)
+{
+    aws_sigv4::SigningKeyCache cache;
+
+    aws_sigv4::Signature today("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+    today.setKeyCache(&cache);
+    aws_sigv4::Signature again("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+    again.setKeyCache(&cache);
+    aws_sigv4::Signature tomorrow("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(10));
+    tomorrow.setKeyCache(&cache);
+    aws_sigv4::Signature uncached("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(10));
+    uncached.setKeyCache(NULL);
+
+    EXPECT_EQ(SignVanilla(today), GetWholeFile("aws4_testsuite/get-vanilla.authz"));
+    EXPECT_EQ(SignVanilla(again), GetWholeFile("aws4_testsuite/get-vanilla.authz"));
+    EXPECT_EQ(SignVanilla(tomorrow), SignVanilla(uncached));
+    EXPECT_NE(SignVanilla(tomorrow), SignVanilla(today));
+}
+
+TEST(SigningKeyCache, assigned_signer_signs_as_its_source)
+{
+    aws_sigv4::Signature source("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+    source.setKeyCache(NULL);
+    aws_sigv4::Signature target("host", "host.foo.com", "us-east-1", "other secret", "AKIDEXAMPLE", TestSuiteTime(9));
+    target.setKeyCache(NULL);
+
+    // The target's own key, derived before the assignment, must not survive it
+    std::string before = SignVanilla(target);
+    target = source;
+    EXPECT_EQ(SignVanilla(target), GetWholeFile("aws4_testsuite/get-vanilla.authz"));
+    EXPECT_NE(SignVanilla(target), before);
+
+    // Nor when the source already has a key of its own
+    aws_sigv4::Signature other("host", "host.foo.com", "us-east-1", "other secret", "AKIDEXAMPLE", TestSuiteTime(9));
+    other.setKeyCache(NULL);
+    SignVanilla(other);
+    other = target;
+    EXPECT_EQ(SignVanilla(other), GetWholeFile("aws4_testsuite/get-vanilla.authz"));
+}
+
+// Incremental payload hashing
+
+TEST(PayloadHasher, empty_payload)
+{
+    aws_sigv4::PayloadHasher hasher;
+
+    EXPECT_EQ(hasher.hexDigest(), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+}
+
+TEST(PayloadHasher, chunks_match_whole_payload)
+{
+    aws_sigv4::PayloadHasher whole, chunked;
+    std::string payload;
+    for (int i = 0; i < 1000; i++)
+        payload += "foo=bar&";
+
+    whole.update(payload);
+    for (std::string::size_type pos = 0; pos < payload.length(); pos += 77)
+        chunked.update(payload.data() + pos, std::min<std::string::size_type>(77, payload.length() - pos));
+
+    EXPECT_EQ(whole.hexDigest(), chunked.hexDigest());
+    EXPECT_EQ(chunked.hexDigest(), chunked.hexDigest());
+}
+
+TEST(PayloadHasher, binary_payload)
+{
+    aws_sigv4::PayloadHasher hasher;
+    std::string payload("a\0b", 3);
+    hasher.update(payload);
+
+    EXPECT_EQ(hasher.hexDigest(), "59b271ae1bbcb1d31d41929817f4b16fb439eb4f31520b5ad1d5ce98920a7138");
+
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+    std::map<std::string, std::vector<std::string> > header_map;
+    header_map["Host"].push_back("host.foo.com");
+    std::string canonical_request = signature.createCanonicalRequest("POST", "/", "", header_map, payload);
+
+    EXPECT_EQ(canonical_request.substr(canonical_request.rfind('\n') + 1), hasher.hexDigest());
+}
+
+TEST(PayloadHasher, canonical_request_matches_string_payload)
+{
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+
+    std::map<std::string, std::vector<std::string> > header_map;
+    header_map["Content-Type"].push_back("application/x-www-form-urlencoded");
+    header_map["Date"].push_back("Mon, 09 Sep 2011 23:36:00 GMT");
+    header_map["Host"].push_back("host.foo.com");
+
+    aws_sigv4::PayloadHasher hasher;
+    hasher.update("foo=");
+    hasher.update("bar");
+
+    EXPECT_EQ(signature.createCanonicalRequest("POST", "/", "", header_map, hasher),
+              GetWholeFile("aws4_testsuite/post-x-www-form-urlencoded.creq"));
+}
+
+// Allocation-free signing API
+
+static void ParseRequestFile(
+    std::string req_file,
+    std::string &method,
+    std::string &canonical_uri,
+    std::string &query_string,
+    std::vector<std::pair<std::string, std::string> > &headers,
+    std::string &payload)
+{
+    std::stringstream reqstream(GetWholeFile(req_file));
+    std::string line, protocal;
+
+    std::getline(reqstream, line);
+    std::stringstream linestream(line);
+    linestream >> method >> canonical_uri >> protocal;
+
+    std::size_t qpos = canonical_uri.find("?");
+    if (qpos != std::string::npos)
+    {
+        query_string = canonical_uri.substr(qpos+1);
+        canonical_uri = canonical_uri.substr(0,qpos);
+    }
+
+    while (std::getline(reqstream, line))
+    {
+        std::size_t pos = line.find(":");
+        if (pos != std::string::npos)
+            headers.push_back(std::make_pair(line.substr(0, pos), line.substr(pos+1)));
+        else if (line.find("=") != std::string::npos)
+            payload += line;
+    }
+}
+
+static std::string SignRequestView(aws_sigv4::Signature &signature, std::string req_file)
+{
+    std::string method, canonical_uri, query_string, payload;
+    std::vector<std::pair<std::string, std::string> > headers;
+    ParseRequestFile(req_file, method, canonical_uri, query_string, headers, payload);
+
+    std::vector<aws_sigv4::HeaderField> fields;
+    for (size_t i = 0; i < headers.size(); i++)
+    {
+        aws_sigv4::HeaderField field = {headers[i].first, headers[i].second};
+        fields.push_back(field);
+    }
+
+    char out[512];
+    size_t length = signature.signRequest(method, canonical_uri, query_string, fields.data(), fields.size(), payload, out, sizeof(out));
+
+    return std::string(out, length);
+}
+
+TEST(signRequest, matches_test_suite)
+{
+    const char *vectors[] = {
+        "get-header-key-duplicate", "get-header-value-order", "get-header-value-trim", "get-vanilla",
+        "get-vanilla-empty-query-key", "get-vanilla-query", "get-vanilla-query-order-key",
+        "get-vanilla-query-order-key-case", "get-vanilla-query-order-value", "get-vanilla-query-unreserved",
+        "post-header-key-case", "post-header-key-sort", "post-header-value-case", "post-vanilla",
+        "post-vanilla-empty-query-value", "post-vanilla-query", "post-x-www-form-urlencoded",
+        "post-x-www-form-urlencoded-parameters", "get-vanilla-ut8-query", "post-vanilla-query-nonunreserved",
+        "post-vanilla-query-space", "get-relative", "get-relative-relative", "get-slash", "get-slash-dot-slash",
+        "get-slash-pointless-dot", "get-slashes", "get-space", "get-utf8"
+    };
+
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++)
+    {
+        std::string base = std::string("aws4_testsuite/") + vectors[i];
+        EXPECT_EQ(SignRequestView(signature, base + ".req"), GetWholeFile(base + ".authz")) << vectors[i];
+    }
+}
+
+static std::string SignRequestMap(aws_sigv4::Signature &signature, std::string req_file, std::string *canonical_request)
+{
+    std::string method, canonical_uri, query_string, payload;
+    std::vector<std::pair<std::string, std::string> > headers;
+    ParseRequestFile(req_file, method, canonical_uri, query_string, headers, payload);
+
+    std::map<std::string, std::vector<std::string> > header_map;
+    for (size_t i = 0; i < headers.size(); i++)
+        header_map[headers[i].first].push_back(headers[i].second);
+
+    return signature.signRequest(method, canonical_uri, query_string, header_map, payload, canonical_request);
+}
+
+TEST(signRequest, map_matches_test_suite)
+{
+    const char *vectors[] = {
+        "get-header-key-duplicate", "get-header-value-order", "get-header-value-trim", "get-vanilla",
+        "get-vanilla-empty-query-key", "get-vanilla-query", "get-vanilla-query-order-key",
+        "get-vanilla-query-order-key-case", "get-vanilla-query-order-value", "get-vanilla-query-unreserved",
+        "post-header-key-case", "post-header-key-sort", "post-header-value-case", "post-vanilla",
+        "post-vanilla-empty-query-value", "post-vanilla-query", "post-x-www-form-urlencoded",
+        "post-x-www-form-urlencoded-parameters", "get-vanilla-ut8-query", "post-vanilla-query-nonunreserved",
+        "post-vanilla-query-space", "get-relative", "get-relative-relative", "get-slash", "get-slash-dot-slash",
+        "get-slash-pointless-dot", "get-slashes", "get-space", "get-utf8"
+    };
+
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++)
+    {
+        std::string base = std::string("aws4_testsuite/") + vectors[i];
+        EXPECT_EQ(SignRequestMap(signature, base + ".req", NULL), GetWholeFile(base + ".authz")) << vectors[i];
+        EXPECT_EQ(SignRequestMap(signature, base + ".req", NULL), SignRequestView(signature, base + ".req")) << vectors[i];
+    }
+}
+
+TEST(signRequest, canonical_request_debug_output)
+{
+    const char *vectors[] = {"get-header-value-trim", "get-vanilla-query-order-key-case", "post-x-www-form-urlencoded", "get-relative-relative"};
+
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++)
+    {
+        std::string base = std::string("aws4_testsuite/") + vectors[i];
+        std::string expected = GetWholeFile(base + ".creq");
+
+        // Asking for the canonical request does not change the signature
+        std::string canonical_request = "left over";
+        EXPECT_EQ(SignRequestMap(signature, base + ".req", &canonical_request), GetWholeFile(base + ".authz")) << vectors[i];
+        EXPECT_EQ(canonical_request, expected) << vectors[i];
+
+        std::string method, canonical_uri, query_string, payload;
+        std::vector<std::pair<std::string, std::string> > headers;
+        ParseRequestFile(base + ".req", method, canonical_uri, query_string, headers, payload);
+        std::vector<aws_sigv4::HeaderField> fields;
+        for (size_t h = 0; h < headers.size(); h++)
+        {
+            aws_sigv4::HeaderField field = {headers[h].first, headers[h].second};
+            fields.push_back(field);
+        }
+
+        char out[512];
+        canonical_request = "left over";
+        size_t length = signature.signRequest(method, canonical_uri, query_string, fields.data(), fields.size(), payload, out, sizeof(out), &canonical_request);
+        EXPECT_EQ(std::string(out, length), GetWholeFile(base + ".authz")) << vectors[i];
+        EXPECT_EQ(canonical_request, expected) << vectors[i];
+    }
+}
+
+TEST(signRequest, output_too_small)
+{
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+    aws_sigv4::HeaderField headers[] = {{"Host", "host.foo.com"}};
+
+    char out[64];
+    EXPECT_EQ(signature.signRequest("GET", "/", "", headers, 1, "", out, sizeof(out)), 0u);
+}
+
+TEST(signRequest, steady_state_does_not_allocate)
+{
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+    aws_sigv4::HeaderField headers[] = {
+        {"Date", "Mon, 09 Sep 2011 23:36:00 GMT"},
+        {"Host", "host.foo.com"},
+        {"Content-Type", "application/x-www-form-urlencoded"},
+        {"ZOO", "zoobar"},
+        {"zoo", "foobar"},
+    };
+    char out[512];
+
+    // The first call derives the signing key
+    ASSERT_NE(signature.signRequest("POST", "/", "foo=bar&a=b", headers, 5, "foo=bar", out, sizeof(out)), 0u);
+
+    g_allocation_count = 0;
+    g_count_allocations = true;
+    size_t length = 0;
+    for (int i = 0; i < 100; i++)
+        length = signature.signRequest("POST", "/", "foo=bar&a=b", headers, 5, "foo=bar", out, sizeof(out));
+    g_count_allocations = false;
+
+    EXPECT_NE(length, 0u);
+    EXPECT_EQ(g_allocation_count.load(), 0u);
+}
+
+TEST(PreparedRequest, steady_state_does_not_allocate)
+{
+    aws_sigv4::Signature signature("dynamodb", "dynamodb.us-east-1.amazonaws.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+    aws_sigv4::HeaderField fixed[] = {
+        {"Content-Type", "application/x-amz-json-1.0"},
+        {"Host", "dynamodb.us-east-1.amazonaws.com"},
+        {"X-Amz-Target", "DynamoDB_20120810.PutItem"},
+    };
+    std::string_view names[] = {"X-Amz-Date"};
+    std::string_view values[] = {"20110909T233600Z"};
+    aws_sigv4::PreparedRequest prepared(signature, "POST", "/", fixed, 3, names, 1);
+    char out[512];
+    ASSERT_NE(prepared.sign(values, "", "{}", out, sizeof(out)), 0u);
+
+    g_allocation_count = 0;
+    g_count_allocations = true;
+    size_t length = 0;
+    for (int i = 0; i < 100; i++)
+        length = prepared.sign(values, "a=b", "{}", out, sizeof(out));
+    g_count_allocations = false;
+
+    EXPECT_NE(length, 0u);
+    EXPECT_EQ(g_allocation_count.load(), 0u);
+}
+
+TEST(IncrementalSigner, slices_do_not_allocate)
+{
+    aws_sigv4::Signature signature("s3", "examplebucket.s3.amazonaws.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+    aws_sigv4::HeaderField headers[] = {
+        {"Host", "examplebucket.s3.amazonaws.com"},
+        {"x-amz-date", "20110909T233600Z"},
+    };
+    std::string payload(100 * 1000, 'x');
+    aws_sigv4::SignRequest request = {"PUT", "/photos/large.bin", "", headers, 2, payload};
+
+    // The first signature derives the signing key
+    aws_sigv4::IncrementalSigner first(signature, time, request, 1000);
+    while (!first.hashSlice()) {}
+    ASSERT_NE(first.authorization(), "");
+
+    g_allocation_count = 0;
+    g_count_allocations = true;
+    aws_sigv4::IncrementalSigner signer(signature, time, request, 1000);
+    size_t slices = 1;
+    while (!signer.hashSlice())
+        slices++;
+    g_count_allocations = false;
+
+    EXPECT_EQ(slices, 100u);
+    EXPECT_EQ(signer.authorization(), first.authorization());
+    EXPECT_EQ(g_allocation_count.load(), 0u);
+}
+
+TEST(signBatch, matches_single_requests)
+{
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+
+    aws_sigv4::HeaderField vanilla[] = {{"Date", "Mon, 09 Sep 2011 23:36:00 GMT"}, {"Host", "host.foo.com"}};
+    aws_sigv4::HeaderField form[] = {
+        {"Content-Type", "application/x-www-form-urlencoded"},
+        {"Date", "Mon, 09 Sep 2011 23:36:00 GMT"},
+        {"Host", "host.foo.com"}
+    };
+    aws_sigv4::HeaderField too_many[aws_sigv4::Signature::kMaxHeaders + 1];
+    for (size_t i = 0; i < aws_sigv4::Signature::kMaxHeaders + 1; i++)
+    {
+        too_many[i].name = "x";
+        too_many[i].value = "y";
+    }
+
+    aws_sigv4::SignRequest requests[] = {
+        {"GET", "/", "", vanilla, 2, ""},
+        {"POST", "/", "foo=bar", vanilla, 2, ""},
+        {"POST", "/", "", too_many, aws_sigv4::Signature::kMaxHeaders + 1, ""},
+        {"POST", "/", "", form, 3, "foo=bar"},
+    };
+    std::string headers[4];
+
+    EXPECT_EQ(signature.signBatch(requests, 4, headers), 3u);
+
+    EXPECT_EQ(headers[0], GetWholeFile("aws4_testsuite/get-vanilla.authz"));
+    EXPECT_EQ(headers[1], GetWholeFile("aws4_testsuite/post-vanilla-query.authz"));
+    EXPECT_EQ(headers[2], "");
+    EXPECT_EQ(headers[3], GetWholeFile("aws4_testsuite/post-x-www-form-urlencoded.authz"));
+}
+
+TEST(signBatch, large_batch_matches_test_suite)
+{
+    // More requests than one multi-buffer window, in uneven lane groups
+    const char *vectors[] = {
+        "get-header-key-duplicate", "get-header-value-order", "get-header-value-trim", "get-vanilla",
+        "get-vanilla-empty-query-key", "get-vanilla-query", "get-vanilla-query-order-key",
+        "get-vanilla-query-order-key-case", "get-vanilla-query-order-value", "get-vanilla-query-unreserved",
+        "post-header-key-case", "post-header-key-sort", "post-header-value-case", "post-vanilla",
+        "post-vanilla-empty-query-value", "post-vanilla-query", "post-x-www-form-urlencoded",
+        "post-x-www-form-urlencoded-parameters", "get-vanilla-ut8-query", "post-vanilla-query-nonunreserved",
+        "post-vanilla-query-space", "get-relative", "get-relative-relative", "get-slash", "get-slash-dot-slash",
+        "get-slash-pointless-dot", "get-slashes", "get-space", "get-utf8"
+    };
+    const size_t vector_count = sizeof(vectors) / sizeof(vectors[0]);
+    const size_t count = 7 * vector_count;
+
+    std::vector<std::string> methods(vector_count), uris(vector_count), queries(vector_count), payloads(vector_count);
+    std::vector<std::vector<std::pair<std::string, std::string> > > headers(vector_count);
+    std::vector<std::vector<aws_sigv4::HeaderField> > fields(vector_count);
+    for (size_t i = 0; i < vector_count; i++)
+    {
+        ParseRequestFile(std::string("aws4_testsuite/") + vectors[i] + ".req", methods[i], uris[i], queries[i], headers[i], payloads[i]);
+        for (size_t j = 0; j < headers[i].size(); j++)
+        {
+            aws_sigv4::HeaderField field = {headers[i][j].first, headers[i][j].second};
+            fields[i].push_back(field);
+        }
+    }
+
+    std::vector<aws_sigv4::SignRequest> requests;
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t v = i % vector_count;
+        aws_sigv4::SignRequest request = {methods[v], uris[v], queries[v], fields[v].data(), fields[v].size(), payloads[v]};
+        requests.push_back(request);
+    }
+
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+    std::vector<std::string> authorization_headers(count);
+
+    EXPECT_EQ(signature.signBatch(requests.data(), count, authorization_headers.data()), count);
+    for (size_t i = 0; i < count; i++)
+        EXPECT_EQ(authorization_headers[i], GetWholeFile(std::string("aws4_testsuite/") + vectors[i % vector_count] + ".authz")) << i;
+}
+
+TEST(signBatch, long_headers_on_every_kernel)
+{
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", TestSuiteTime(9));
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+
+    // A signed header list long enough for a header well past 1 KiB
+    std::vector<std::string> names;
+    for (size_t i = 0; i < 40; i++)
+        names.push_back("x-amz-meta-long-header-name-" + std::to_string(100 + i));
+    std::vector<aws_sigv4::HeaderField> fields;
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        aws_sigv4::HeaderField field = {names[i], "v"};
+        fields.push_back(field);
+    }
+    aws_sigv4::SignRequest request = {"PUT", "/", "", fields.data(), fields.size(), "payload"};
+
+    char out[4096];
+    size_t length = signature.signRequest(time, request.method, request.canonical_uri, request.querystring, request.headers, request.header_count, request.payload, out, sizeof(out));
+    std::string expected(out, length);
+    ASSERT_GT(expected.length(), 1024u);
+
+    aws_sigv4::MultiBufferSha256::Kernel kernels[] = {
+        aws_sigv4::MultiBufferSha256::kScalar,
+        aws_sigv4::MultiBufferSha256::kAvx2,
+        aws_sigv4::MultiBufferSha256::kAvx512,
+    };
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+    {
+        if (!aws_sigv4::MultiBufferSha256::supported(kernels[k]))
+            continue;
+        aws_sigv4::MultiBufferSha256 hasher(kernels[k]);
+        std::vector<aws_sigv4::SignRequest> requests(3, request);
+        std::vector<std::string> authorization_headers(requests.size());
+
+        EXPECT_EQ(signature.signBatch(time, requests.data(), requests.size(), authorization_headers.data(), hasher), requests.size()) << hasher.kernelName(kernels[k]);
+        for (size_t i = 0; i < requests.size(); i++)
+            EXPECT_EQ(authorization_headers[i], expected) << hasher.kernelName(kernels[k]);
+    }
+}
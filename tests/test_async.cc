@@ -0,0 +1,224 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "awssigv4_async.h"
+#include "test_util.h"
+
+// Requests signed by AsyncSigner, checked against Signature::signRequest,
+// and the latency of small jobs queued with large ones
+
+// Holds completions back until released
+class Gate
+{
+    public:
+        Gate() : m_open(false) {}
+
+        void wait()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_changed.wait(lock, [this]() { return m_open; });
+        }
+
+        void open()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_open = true;
+            m_changed.notify_all();
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_changed;
+        bool m_open;
+};
+
+TEST(AsyncSigner, matches_inline_signing)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+
+    // Empty, within one slice, exactly one slice and several slices
+    size_t sizes[] = {0, 1000, aws_sigv4::AsyncSigner::kSliceBytes, 3 * aws_sigv4::AsyncSigner::kSliceBytes + 17};
+    std::vector<std::string> payloads;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        payloads.push_back(std::string(sizes[i], (char)('a' + i)));
+
+    aws_sigv4::AsyncSigner async(signature, 3);
+    EXPECT_EQ(async.threadCount(), 3u);
+
+    std::vector<std::future<std::string> > results;
+    for (size_t i = 0; i < payloads.size(); i++)
+        results.push_back(async.submit(time, PutRequest(payloads[i])));
+    for (size_t i = 0; i < payloads.size(); i++)
+    {
+        std::string expected = SignInline(signature, time, PutRequest(payloads[i]));
+        ASSERT_NE(expected, "");
+        EXPECT_EQ(results[i].get(), expected) << sizes[i];
+    }
+}
+
+TEST(AsyncSigner, rejected_request_completes_empty)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+
+    std::vector<aws_sigv4::HeaderField> headers(aws_sigv4::Signature::kMaxHeaders + 1, kPutHeaders[0]);
+    aws_sigv4::SignRequest request = {"PUT", "/", "", headers.data(), headers.size(), ""};
+
+    aws_sigv4::AsyncSigner async(signature, 1);
+    EXPECT_EQ(async.submit(time, request).get(), "");
+}
+
+TEST(AsyncSigner, long_headers_are_signed_in_full)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+
+    // Signed header names adding up to well over 4 KiB
+    std::vector<std::string> names;
+    std::vector<aws_sigv4::HeaderField> headers;
+    for (size_t i = 0; i < 50; i++)
+        names.push_back("x-amz-meta-" + std::string(100, 'a' + i % 26) + std::to_string(i));
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        aws_sigv4::HeaderField header = {names[i], "v"};
+        headers.push_back(header);
+    }
+    aws_sigv4::SignRequest request = {"PUT", "/", "", headers.data(), headers.size(), "payload"};
+
+    char out[16384];
+    size_t length = signature.signRequest(time, request.method, request.canonical_uri, request.querystring, request.headers, request.header_count, request.payload, out, sizeof(out));
+    ASSERT_GT(length, 4096u);
+
+    aws_sigv4::AsyncSigner async(signature, 1);
+    EXPECT_EQ(async.submit(time, request).get(), std::string(out, length));
+}
+
+TEST(AsyncSigner, try_submit_applies_backpressure)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+    aws_sigv4::SignRequest request = PutRequest("");
+
+    Gate gate;
+    std::atomic<size_t> completed(0);
+    aws_sigv4::AsyncSigner::Completion blocked = [&](const std::string &) { gate.wait(); completed++; };
+    aws_sigv4::AsyncSigner::Completion counted = [&](const std::string &) { completed++; };
+
+    aws_sigv4::AsyncSigner async(signature, 1, 3);
+    EXPECT_TRUE(async.trySubmit(time, request, blocked));
+    EXPECT_TRUE(async.trySubmit(time, request, counted));
+    EXPECT_TRUE(async.trySubmit(time, request, counted));
+    EXPECT_FALSE(async.trySubmit(time, request, counted));
+    EXPECT_EQ(async.pending(), 3u);
+
+    gate.open();
+    while (async.pending() > 0)
+        std::this_thread::yield();
+    EXPECT_EQ(completed.load(), 3u);
+    EXPECT_TRUE(async.trySubmit(time, request, counted));
+}
+
+TEST(AsyncSigner, submit_waits_for_space)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+    aws_sigv4::SignRequest request = PutRequest("");
+
+    Gate gate;
+    aws_sigv4::AsyncSigner async(signature, 1, 1);
+    async.submit(time, request, [&](const std::string &) { gate.wait(); });
+
+    std::atomic<bool> submitted(false);
+    std::thread producer([&]() {
+        std::future<std::string> result = async.submit(time, request);
+        submitted = true;
+        result.get();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(submitted.load());
+
+    gate.open();
+    producer.join();
+    EXPECT_TRUE(submitted.load());
+}
+
+TEST(AsyncSigner, destructor_completes_accepted_jobs)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+    std::string payload(aws_sigv4::AsyncSigner::kSliceBytes * 2, 'p');
+    std::string expected = SignInline(signature, time, PutRequest(payload));
+
+    std::atomic<size_t> matched(0);
+    {
+        aws_sigv4::AsyncSigner async(signature, 2, 64);
+        for (size_t i = 0; i < 64; i++)
+            async.submit(time, PutRequest(payload), [&](const std::string &authorization) {
+                if (authorization == expected)
+                    matched++;
+            });
+    }
+    EXPECT_EQ(matched.load(), 64u);
+}
+
+TEST(AsyncSigner, small_jobs_are_not_stuck_behind_large_payloads)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+    std::string large(32 << 20, 'x');
+
+    // What a small job would wait for without slicing
+    unsigned char digest[aws_sigv4::kSha256DigestLength];
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    aws_sigv4::Sha256::digest(large.data(), large.length(), digest);
+    double large_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t thread_counts[] = {1, 4};
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++)
+    {
+        size_t threads = thread_counts[t];
+        size_t large_jobs = 2 * threads;
+        std::atomic<size_t> large_done(0);
+
+        aws_sigv4::AsyncSigner async(signature, threads);
+        for (size_t i = 0; i < large_jobs; i++)
+            async.submit(time, PutRequest(large), [&](const std::string &) { large_done++; });
+
+        // Header-only signatures, one at a time, while the large ones hash
+        std::vector<double> latencies;
+        for (size_t i = 0; i < 40; i++)
+        {
+            start = std::chrono::steady_clock::now();
+            std::string authorization = async.submit(time, PutRequest("")).get();
+            latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            EXPECT_NE(authorization, "");
+        }
+        size_t large_done_meanwhile = large_done.load();
+
+        std::sort(latencies.begin(), latencies.end());
+        double p50 = latencies[latencies.size() / 2];
+        double p99 = latencies[latencies.size() * 99 / 100];
+        double worst = latencies.back();
+
+        // Slicing keeps them far below the time of one large hash
+        EXPECT_LT(large_done_meanwhile, large_jobs) << threads << " threads: the large jobs finished first";
+        EXPECT_LT(p99, large_ms / 2) << threads << " threads: p50 " << p50 << " ms, p99 " << p99 << " ms, large hash " << large_ms << " ms";
+        EXPECT_LT(worst, large_ms) << threads << " threads";
+    }
+}
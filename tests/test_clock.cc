@@ -0,0 +1,168 @@
+#include "gtest/gtest.h"
+#include <map>
+#include <string>
+#include <vector>
+
+#include "awssigv4.h"
+#include "awssigv4_clock.h"
+#include "test_util.h"
+
+// Long-lived signers on an injected clock, checked against signers built
+// for one fixed time
+
+static const time_t kNextDay = 1315612800;       // 20110910T000000Z
+
+static const char kGetVanillaAuthorization[] =
+    "AWS4-HMAC-SHA256 Credential=AKIDEXAMPLE/20110909/us-east-1/host/aws4_request, "
+    "SignedHeaders=date;host, Signature=b27ccfbfa7df52a200ff74193ca6e32d4b48b8856fab7ebf1c595d0670a7e470";
+
+static aws_sigv4::Signature MakeSigner(const aws_sigv4::TimestampCache &timestamps)
+{
+    return aws_sigv4::Signature("host", "host.foo.com", "us-east-1", kTestSecretKey, kTestAccessKey, timestamps);
+}
+
+// Authorization header for a GET of / through the step by step API of a
+// signer fixed at sig_time
+static std::string FixedTimeAuthorization(time_t sig_time)
+{
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", kTestSecretKey, kTestAccessKey, sig_time);
+    std::map<std::string, std::vector<std::string> > header_map;
+    header_map["Date"].push_back("Mon, 09 Sep 2011 23:36:00 GMT");
+    header_map["Host"].push_back("host.foo.com");
+
+    std::string canonical_request = signature.createCanonicalRequest("GET", "/", "", header_map, "");
+    return signature.createAuthorizationHeader(signature.createSignature(signature.createStringToSign(canonical_request)));
+}
+
+static std::string SignView(const aws_sigv4::Signature &signature)
+{
+    aws_sigv4::HeaderField headers[] = {{"Date", "Mon, 09 Sep 2011 23:36:00 GMT"}, {"Host", "host.foo.com"}};
+    char out[512];
+    return std::string(out, signature.signRequest("GET", "/", "", headers, 2, "", out, sizeof(out)));
+}
+
+TEST(TimestampCache, formats_each_second)
+{
+    aws_sigv4::FixedClock clock(kTestSuiteTime);
+    aws_sigv4::TimestampCache timestamps(clock);
+    aws_sigv4::RequestTime time;
+
+    timestamps.now(time);
+    EXPECT_EQ(time.time, kTestSuiteTime);
+    EXPECT_STREQ(time.amzdate, "20110909T233600Z");
+    EXPECT_STREQ(time.datestamp, "20110909");
+
+    timestamps.now(time);
+    EXPECT_STREQ(time.amzdate, "20110909T233600Z");
+
+    clock.advance(1);
+    timestamps.now(time);
+    EXPECT_STREQ(time.amzdate, "20110909T233601Z");
+
+    clock.set(kNextDay);
+    timestamps.now(time);
+    EXPECT_STREQ(time.amzdate, "20110910T000000Z");
+    EXPECT_STREQ(time.datestamp, "20110910");
+
+    // Going back in time is a new second like any other
+    clock.set(kTestSuiteTime);
+    timestamps.now(time);
+    EXPECT_STREQ(time.amzdate, "20110909T233600Z");
+}
+
+TEST(TimestampCache, system_clock)
+{
+    aws_sigv4::RequestTime request_time;
+    time_t before = time(NULL);
+    aws_sigv4::TimestampCache::system().now(request_time);
+    time_t after = time(NULL);
+
+    EXPECT_GE(request_time.time, before);
+    EXPECT_LE(request_time.time, after);
+    EXPECT_EQ(strlen(request_time.amzdate), 16u);
+    EXPECT_EQ(strlen(request_time.datestamp), 8u);
+}
+
+TEST(Signature, live_signer_pinned_to_test_suite_time)
+{
+    aws_sigv4::FixedClock clock(kTestSuiteTime);
+    aws_sigv4::TimestampCache timestamps(clock);
+    aws_sigv4::Signature signature = MakeSigner(timestamps);
+
+    std::map<std::string, std::vector<std::string> > header_map;
+    header_map["Date"].push_back("Mon, 09 Sep 2011 23:36:00 GMT");
+    header_map["Host"].push_back("host.foo.com");
+    EXPECT_EQ(signature.signRequest("GET", "/", "", header_map, ""), kGetVanillaAuthorization);
+    EXPECT_EQ(SignView(signature), kGetVanillaAuthorization);
+
+    aws_sigv4::HeaderField headers[] = {{"Date", "Mon, 09 Sep 2011 23:36:00 GMT"}, {"Host", "host.foo.com"}};
+    aws_sigv4::SignRequest request = {"GET", "/", "", headers, 2, ""};
+    std::string authorization;
+    EXPECT_EQ(signature.signBatch(&request, 1, &authorization), 1u);
+    EXPECT_EQ(authorization, kGetVanillaAuthorization);
+}
+
+TEST(Signature, live_signer_follows_the_clock)
+{
+    aws_sigv4::FixedClock clock(kTestSuiteTime);
+    aws_sigv4::TimestampCache timestamps(clock);
+    aws_sigv4::Signature signature = MakeSigner(timestamps);
+    signature.setKeyCache(NULL);
+
+    const time_t times[] = {kTestSuiteTime + 1, kTestSuiteTime + 59, kNextDay - 1, kNextDay, kNextDay + 86400 * 30};
+    for (size_t i = 0; i < sizeof(times) / sizeof(times[0]); i++)
+    {
+        clock.set(times[i]);
+        std::string expected = FixedTimeAuthorization(times[i]);
+        EXPECT_EQ(SignView(signature), expected) << times[i];
+
+        std::vector<aws_sigv4::SignRequest> batch;
+        aws_sigv4::HeaderField headers[] = {{"Date", "Mon, 09 Sep 2011 23:36:00 GMT"}, {"Host", "host.foo.com"}};
+        aws_sigv4::SignRequest request = {"GET", "/", "", headers, 2, ""};
+        batch.assign(20, request);
+        std::vector<std::string> authorizations(batch.size());
+        signature.signBatch(batch.data(), batch.size(), authorizations.data());
+        for (size_t r = 0; r < authorizations.size(); r++)
+            EXPECT_EQ(authorizations[r], expected) << times[i];
+    }
+    EXPECT_NE(SignView(signature).find("Credential=AKIDEXAMPLE/20111010/"), std::string::npos);
+
+    // The step by step API stays at the construction time
+    std::map<std::string, std::vector<std::string> > header_map;
+    header_map["Date"].push_back("Mon, 09 Sep 2011 23:36:00 GMT");
+    header_map["Host"].push_back("host.foo.com");
+    std::string canonical_request = signature.createCanonicalRequest("GET", "/", "", header_map, "");
+    EXPECT_EQ(signature.createAuthorizationHeader(signature.createSignature(signature.createStringToSign(canonical_request))), kGetVanillaAuthorization);
+}
+
+TEST(Signature, explicit_request_time)
+{
+    aws_sigv4::FixedClock clock(kNextDay - 1);
+    aws_sigv4::TimestampCache timestamps(clock);
+    aws_sigv4::Signature signature = MakeSigner(timestamps);
+
+    // A request stamped just before midnight is signed for that second,
+    // even when the clock has moved on by the time it is signed
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+    EXPECT_STREQ(time.amzdate, "20110909T235959Z");
+    clock.advance(1);
+
+    aws_sigv4::HeaderField headers[] = {{"Host", "host.foo.com"}, {"X-Amz-Date", time.amzdate}};
+    char out[512];
+    std::string stamped(out, signature.signRequest(time, "GET", "/", "", headers, 2, "", out, sizeof(out)));
+
+    aws_sigv4::Signature reference("host", "host.foo.com", "us-east-1", kTestSecretKey, kTestAccessKey, kNextDay - 1);
+    std::string expected(out, reference.signRequest("GET", "/", "", headers, 2, "", out, sizeof(out)));
+    EXPECT_EQ(stamped, expected);
+    EXPECT_NE(stamped.find("/20110909/"), std::string::npos);
+
+    aws_sigv4::SignRequest request = {"GET", "/", "", headers, 2, ""};
+    std::string authorization;
+    signature.signBatch(time, &request, 1, &authorization);
+    EXPECT_EQ(authorization, expected);
+
+    // A signer without a timestamp cache reports its fixed time
+    reference.requestTime(time);
+    EXPECT_EQ(time.time, kNextDay - 1);
+}
@@ -0,0 +1,139 @@
+#include "gtest/gtest.h"
+#include <string>
+
+#include "awssigv4.h"
+
+// FIPS 180-2 and RFC 4231 vectors, checked against every backend this build
+// and CPU can run
+
+static std::string Hex(const unsigned char *digest)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    for (size_t i = 0; i < aws_sigv4::kSha256DigestLength; i++)
+    {
+        hex += digits[digest[i] >> 4];
+        hex += digits[digest[i] & 0xf];
+    }
+    return hex;
+}
+
+// Makes a backend active for the lifetime of the object
+class ActiveBackend
+{
+    private:
+        const aws_sigv4::CryptoBackend &m_previous;
+
+    public:
+        explicit ActiveBackend(const aws_sigv4::CryptoBackend &backend) : m_previous(aws_sigv4::CryptoBackend::active())
+        {
+            aws_sigv4::CryptoBackend::setActive(backend);
+        }
+
+        ~ActiveBackend()
+        {
+            aws_sigv4::CryptoBackend::setActive(m_previous);
+        }
+};
+
+TEST(CryptoBackend, available_backends)
+{
+    ASSERT_NE(aws_sigv4::CryptoBackend::available(0), (const aws_sigv4::CryptoBackend *)NULL);
+    EXPECT_NE(aws_sigv4::CryptoBackend::find("builtin"), (const aws_sigv4::CryptoBackend *)NULL);
+    EXPECT_EQ(aws_sigv4::CryptoBackend::find("md5"), (const aws_sigv4::CryptoBackend *)NULL);
+#ifdef AWSSIGV4_NO_OPENSSL
+    EXPECT_EQ(aws_sigv4::CryptoBackend::find("openssl"), (const aws_sigv4::CryptoBackend *)NULL);
+#else
+    EXPECT_NE(aws_sigv4::CryptoBackend::find("openssl"), (const aws_sigv4::CryptoBackend *)NULL);
+#endif
+
+    for (size_t i = 0; aws_sigv4::CryptoBackend::available(i) != NULL; i++)
+        EXPECT_EQ(aws_sigv4::CryptoBackend::find(aws_sigv4::CryptoBackend::available(i)->name()), aws_sigv4::CryptoBackend::available(i));
+}
+
+TEST(CryptoBackend, sha256_vectors)
+{
+    const char *vectors[][2] = {
+        {"", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+        {"abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+        {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+    };
+    std::string million(1000000, 'a');
+
+    for (size_t b = 0; aws_sigv4::CryptoBackend::available(b) != NULL; b++)
+    {
+        const aws_sigv4::CryptoBackend &backend = *aws_sigv4::CryptoBackend::available(b);
+        ActiveBackend active(backend);
+        unsigned char digest[aws_sigv4::kSha256DigestLength];
+
+        for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++)
+        {
+            backend.sha256(vectors[i][0], strlen(vectors[i][0]), digest);
+            EXPECT_EQ(Hex(digest), vectors[i][1]) << backend.name();
+
+            aws_sigv4::Sha256 sha256;
+            sha256.update(vectors[i][0]);
+            sha256.final(digest);
+            EXPECT_EQ(Hex(digest), vectors[i][1]) << backend.name();
+        }
+
+        backend.sha256(million.data(), million.length(), digest);
+        EXPECT_EQ(Hex(digest), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0") << backend.name();
+
+        // Uneven pieces that straddle block boundaries
+        aws_sigv4::Sha256 sha256;
+        for (size_t offset = 0, piece = 1; offset < million.length(); offset += piece, piece = piece * 7 % 1013 + 1)
+            sha256.update(million.data() + offset, std::min(piece, million.length() - offset));
+        sha256.final(digest);
+        EXPECT_EQ(Hex(digest), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0") << backend.name();
+    }
+}
+
+TEST(CryptoBackend, hmac_sha256_vectors)
+{
+    std::string key1(20, '\x0b'), key6(131, '\xaa');
+    std::string data6 = "Test Using Larger Than Block-Size Key - Hash Key First";
+
+    for (size_t b = 0; aws_sigv4::CryptoBackend::available(b) != NULL; b++)
+    {
+        ActiveBackend active(*aws_sigv4::CryptoBackend::available(b));
+        unsigned char digest[aws_sigv4::kSha256DigestLength];
+
+        aws_sigv4::HmacSha256::digest(key1.data(), key1.length(), "Hi There", 8, digest);
+        EXPECT_EQ(Hex(digest), "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7");
+
+        aws_sigv4::HmacSha256::digest("Jefe", 4, "what do ya want for nothing?", 28, digest);
+        EXPECT_EQ(Hex(digest), "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+
+        // Copies of an initialised HMAC share the key pads
+        aws_sigv4::HmacSha256 keyed;
+        keyed.init(key6.data(), key6.length());
+        for (int i = 0; i < 2; i++)
+        {
+            aws_sigv4::HmacSha256 hmac = keyed;
+            hmac.update(data6);
+            hmac.final(digest);
+            EXPECT_EQ(Hex(digest), "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54");
+        }
+    }
+}
+
+TEST(CryptoBackend, signatures_match_across_backends)
+{
+    aws_sigv4::HeaderField headers[] = {{"Date", "Mon, 09 Sep 2011 23:36:00 GMT"}, {"Host", "host.foo.com"}};
+
+    for (size_t b = 0; aws_sigv4::CryptoBackend::available(b) != NULL; b++)
+    {
+        ActiveBackend active(*aws_sigv4::CryptoBackend::available(b));
+
+        aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", 1315611360);
+        signature.setKeyCache(NULL);
+
+        char out[512];
+        size_t length = signature.signRequest("GET", "/", "", headers, 2, "", out, sizeof(out));
+        EXPECT_EQ(std::string(out, length),
+                  "AWS4-HMAC-SHA256 Credential=AKIDEXAMPLE/20110909/us-east-1/host/aws4_request, "
+                  "SignedHeaders=date;host, Signature=b27ccfbfa7df52a200ff74193ca6e32d4b48b8856fab7ebf1c595d0670a7e470")
+            << aws_sigv4::CryptoBackend::available(b)->name();
+    }
+}
@@ -0,0 +1,249 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "awssigv4_incremental.h"
+#include "test_util.h"
+
+// Requests signed slice by slice, checked against Signature::signRequest,
+// and the latency of small requests on a coroutine scheduler that is also
+// signing a large body
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Single-threaded round robin over a fixed ring of coroutine handles
+class LocalScheduler
+{
+    public:
+        LocalScheduler() : m_head(0), m_count(0) {}
+
+        void schedule(std::coroutine_handle<> handle)
+        {
+            if (m_count == kCapacity)
+                std::terminate();
+            m_ready[(m_head + m_count) % kCapacity] = handle;
+            m_count++;
+        }
+
+        // Resumes ready coroutines until there are none
+        void run()
+        {
+            while (m_count > 0)
+            {
+                std::coroutine_handle<> handle = m_ready[m_head];
+                m_head = (m_head + 1) % kCapacity;
+                m_count--;
+                handle.resume();
+            }
+        }
+
+        // co_await scheduler.yield() goes to the back of the queue
+        struct Yield
+        {
+            LocalScheduler &scheduler;
+            bool await_ready() const { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { scheduler.schedule(handle); }
+            void await_resume() const {}
+        };
+
+        Yield yield() { return Yield{*this}; }
+
+    private:
+        static const size_t kCapacity = 64;
+        std::coroutine_handle<> m_ready[kCapacity];
+        size_t m_head;
+        size_t m_count;
+};
+
+// A coroutine that starts at once and frees itself when it returns
+struct Detached
+{
+    struct promise_type
+    {
+        Detached get_return_object() { return Detached(); }
+        std::suspend_never initial_suspend() noexcept { return std::suspend_never(); }
+        std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+struct SignResult
+{
+    std::string authorization;
+    size_t suspensions;
+    bool done;
+};
+
+static Detached SignOnScheduler(LocalScheduler &scheduler, aws_sigv4::IncrementalSigner &signer, SignResult &result)
+{
+    result.suspensions = 0;
+    result.done = false;
+    while (!signer.done())
+    {
+        bool done = co_await signer.step(scheduler);
+        if (!done)
+            result.suspensions++;
+    }
+    result.authorization = std::string(signer.authorization());
+    result.done = true;
+}
+
+TEST(IncrementalSigner, matches_inline_signing)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+
+    // Empty, within one slice, exactly one slice and several slices
+    const size_t kSlice = 4096;
+    size_t sizes[] = {0, 1000, kSlice, 3 * kSlice + 17};
+    size_t slices[] = {1, 1, 1, 4};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        std::string payload(sizes[i], (char)('a' + i));
+        std::string expected = SignInline(signature, time, PutRequest(payload));
+        ASSERT_NE(expected, "");
+
+        aws_sigv4::IncrementalSigner signer(signature, time, PutRequest(payload), kSlice);
+        size_t calls = 1;
+        while (!signer.hashSlice())
+        {
+            EXPECT_EQ(signer.authorization(), "");
+            EXPECT_EQ(signer.hashed(), calls * kSlice);
+            calls++;
+        }
+        EXPECT_EQ(calls, slices[i]) << sizes[i];
+        EXPECT_TRUE(signer.done());
+        EXPECT_EQ(signer.hashed(), sizes[i]);
+        EXPECT_EQ(signer.authorization(), expected) << sizes[i];
+
+        // Done stays done
+        EXPECT_TRUE(signer.hashSlice());
+        EXPECT_EQ(signer.authorization(), expected);
+
+        // Slice size 0 hashes it all at once
+        aws_sigv4::IncrementalSigner whole(signature, time, PutRequest(payload), 0);
+        EXPECT_TRUE(whole.hashSlice());
+        EXPECT_EQ(whole.authorization(), expected);
+    }
+}
+
+TEST(IncrementalSigner, rejected_request_is_done_and_empty)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+
+    std::vector<aws_sigv4::HeaderField> headers(aws_sigv4::Signature::kMaxHeaders + 1, kPutHeaders[0]);
+    aws_sigv4::SignRequest request = {"PUT", "/", "", headers.data(), headers.size(), "payload"};
+
+    aws_sigv4::IncrementalSigner signer(signature, time, request);
+    EXPECT_TRUE(signer.hashSlice());
+    EXPECT_EQ(signer.authorization(), "");
+}
+
+TEST(IncrementalSigner, coroutine_suspends_between_slices)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+    std::string payload(10 * 1000, 'c');
+
+    LocalScheduler scheduler;
+    aws_sigv4::IncrementalSigner signer(signature, time, PutRequest(payload), 1000);
+    SignResult result;
+    SignOnScheduler(scheduler, signer, result);
+
+    // The first slice runs before the coroutine first suspends
+    EXPECT_FALSE(result.done);
+    EXPECT_EQ(signer.hashed(), 1000u);
+
+    scheduler.run();
+    EXPECT_TRUE(result.done);
+    EXPECT_EQ(result.suspensions, 9u);
+    EXPECT_EQ(result.authorization, SignInline(signature, time, PutRequest(payload)));
+
+    // Without payload it never suspends
+    aws_sigv4::IncrementalSigner empty(signature, time, PutRequest(""), 1000);
+    SignOnScheduler(scheduler, empty, result);
+    EXPECT_TRUE(result.done);
+    EXPECT_EQ(result.suspensions, 0u);
+}
+
+struct SmallRequests
+{
+    size_t count;
+    std::vector<double> latencies;
+    // Large body bytes hashed while each small request waited
+    std::vector<size_t> large_hashed;
+    bool large_done_first;
+};
+
+// Header-only signatures one after another, each queued behind whatever
+// else the scheduler is running, as if it had just arrived
+static Detached SignSmallRequests(LocalScheduler &scheduler, const aws_sigv4::Signature &signature, const aws_sigv4::RequestTime &time,
+                                  const aws_sigv4::IncrementalSigner &large, SmallRequests &small)
+{
+    small.large_done_first = false;
+    for (size_t i = 0; i < small.count; i++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        size_t large_hashed = large.hashed();
+        co_await scheduler.yield();
+
+        aws_sigv4::IncrementalSigner signer(signature, time, PutRequest(""));
+        while (!signer.done())
+            co_await signer.step(scheduler);
+        EXPECT_NE(signer.authorization(), "");
+
+        small.latencies.push_back(ElapsedMs(start));
+        small.large_hashed.push_back(large.hashed() - large_hashed);
+        if (large.done())
+            small.large_done_first = true;
+    }
+}
+
+TEST(IncrementalSigner, small_requests_are_not_delayed_by_a_large_body)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+    std::string large_payload(32 << 20, 'x');
+
+    // What a small request would wait for without slicing
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::string expected = SignInline(signature, time, PutRequest(large_payload));
+    double large_ms = ElapsedMs(start);
+
+    LocalScheduler scheduler;
+    aws_sigv4::IncrementalSigner large(signature, time, PutRequest(large_payload));
+    SignResult large_result;
+    SmallRequests small;
+    small.count = 40;
+
+    SignOnScheduler(scheduler, large, large_result);
+    SignSmallRequests(scheduler, signature, time, large, small);
+    scheduler.run();
+
+    ASSERT_TRUE(large_result.done);
+    EXPECT_EQ(large_result.authorization, expected);
+    ASSERT_EQ(small.latencies.size(), small.count);
+    EXPECT_FALSE(small.large_done_first) << "the large body finished first";
+
+    // Each small request waits for one slice of the large body at most
+    for (size_t i = 0; i < small.count; i++)
+        EXPECT_LE(small.large_hashed[i], (size_t)aws_sigv4::IncrementalSigner::kDefaultSliceBytes) << i;
+
+    std::sort(small.latencies.begin(), small.latencies.end());
+    double p50 = small.latencies[small.latencies.size() / 2];
+    double p99 = small.latencies[small.latencies.size() * 99 / 100];
+    EXPECT_LT(p99, large_ms / 10) << "p50 " << p50 << " ms, p99 " << p99 << " ms, large body " << large_ms << " ms";
+}
@@ -0,0 +1,236 @@
+#include "gtest/gtest.h"
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "awssigv4_multipart.h"
+#include "awssigv4_text.h"
+#include "test_util.h"
+
+// Parts signed by MultipartSigner, checked against Signature::signRequest
+// for the same UploadPart requests one at a time
+
+static std::string TestObject(size_t length)
+{
+    std::string data(length, '\0');
+    for (size_t i = 0; i < length; i++)
+        data[i] = (char)(i * 131 + i / 251);
+    return data;
+}
+
+static std::string SignPart(const aws_sigv4::Signature &signature, const aws_sigv4::RequestTime &time, size_t part_number, std::string_view payload)
+{
+    aws_sigv4::Sha256 sha256;
+    sha256.update(payload.data(), payload.length());
+    unsigned char digest[aws_sigv4::kSha256DigestLength];
+    sha256.final(digest);
+    std::string payload_hash(2 * aws_sigv4::kSha256DigestLength, '\0');
+    aws_sigv4::TextKernels::best().hexEncode(digest, sizeof(digest), &payload_hash[0]);
+
+    aws_sigv4::HeaderField headers[] = {
+        {"Host", "examplebucket.s3.amazonaws.com"},
+        {"x-amz-content-sha256", payload_hash},
+        {"x-amz-date", time.amzdate},
+    };
+    std::string query = "partNumber=" + std::to_string(part_number) + "&uploadId=VXBsb2FkIElE.Zm9v-bar";
+
+    char out[1024];
+    size_t length = signature.signRequest(time, "PUT", "/photos/large object.bin", query, headers, 3, payload, out, sizeof(out));
+    return std::string(out, length);
+}
+
+// Smallest part size, as a value rather than the class constant
+static const size_t kMinPartSize = aws_sigv4::MultipartSigner::kMinPartSize;
+
+TEST(MultipartSigner, part_count)
+{
+    const size_t part_size = kMinPartSize + 4096;
+    EXPECT_EQ(aws_sigv4::MultipartSigner::partCount(0, part_size), 1u);
+    EXPECT_EQ(aws_sigv4::MultipartSigner::partCount(1, part_size), 1u);
+    EXPECT_EQ(aws_sigv4::MultipartSigner::partCount(part_size, part_size), 1u);
+    EXPECT_EQ(aws_sigv4::MultipartSigner::partCount(part_size + 1, part_size), 2u);
+    EXPECT_EQ(aws_sigv4::MultipartSigner::partCount((uint64_t)5 << 30), 640u);
+    EXPECT_EQ(aws_sigv4::MultipartSigner::partCount((uint64_t)5 << 30, 0), 640u);
+
+    // Sizes below the S3 minimum count as the minimum
+    EXPECT_EQ(aws_sigv4::MultipartSigner::partCount(kMinPartSize, 4096), 1u);
+    EXPECT_EQ(aws_sigv4::MultipartSigner::partCount(kMinPartSize + 1, 1), 2u);
+    EXPECT_EQ(aws_sigv4::MultipartSigner::partCount((uint64_t)aws_sigv4::MultipartSigner::kMaxParts * kMinPartSize, kMinPartSize),
+              (uint64_t)aws_sigv4::MultipartSigner::kMaxParts);
+}
+
+TEST(MultipartSigner, small_part_size_is_raised_to_minimum)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+    aws_sigv4::HeaderField host[] = {{"Host", "examplebucket.s3.amazonaws.com"}};
+    std::string data = TestObject(kMinPartSize + 10);
+
+    aws_sigv4::MultipartSigner multipart(signature, 4096, 2);
+    EXPECT_EQ(multipart.partSize(), kMinPartSize);
+    EXPECT_EQ(aws_sigv4::MultipartSigner(signature, 0).partSize(), (size_t)aws_sigv4::MultipartSigner::kDefaultPartSize);
+
+    std::vector<aws_sigv4::MultipartSigner::Part> parts;
+    ASSERT_TRUE(multipart.signParts(time, "/photos/large object.bin", "VXBsb2FkIElE.Zm9v-bar", host, 1, data, parts));
+    ASSERT_EQ(parts.size(), 2u);
+    EXPECT_EQ(parts[0].length, kMinPartSize);
+    EXPECT_EQ(parts[1].length, 10u);
+}
+
+TEST(MultipartSigner, matches_single_requests)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+    aws_sigv4::HeaderField host[] = {{"Host", "examplebucket.s3.amazonaws.com"}};
+    std::string data = TestObject(2 * kMinPartSize + 1808);
+
+    aws_sigv4::MultipartSigner multipart(signature, kMinPartSize, 3);
+    std::vector<aws_sigv4::MultipartSigner::Part> parts;
+    ASSERT_TRUE(multipart.signParts(time, "/photos/large object.bin", "VXBsb2FkIElE.Zm9v-bar", host, 1, data, parts));
+    ASSERT_EQ(parts.size(), 3u);
+
+    uint64_t offsets[] = {0, kMinPartSize, 2 * kMinPartSize};
+    uint64_t lengths[] = {kMinPartSize, kMinPartSize, 1808};
+    for (size_t i = 0; i < parts.size(); i++)
+    {
+        EXPECT_EQ(parts[i].part_number, i + 1);
+        EXPECT_EQ(parts[i].offset, offsets[i]);
+        EXPECT_EQ(parts[i].length, lengths[i]);
+        EXPECT_EQ(parts[i].authorization, SignPart(signature, time, i + 1, std::string_view(data).substr(offsets[i], lengths[i]))) << i;
+    }
+    EXPECT_NE(parts[0].payload_hash, parts[1].payload_hash);
+}
+
+TEST(MultipartSigner, same_parts_on_any_thread_count)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+    aws_sigv4::HeaderField host[] = {{"Host", "examplebucket.s3.amazonaws.com"}};
+    std::string data = TestObject(6 * kMinPartSize + 1000);
+
+    std::vector<aws_sigv4::MultipartSigner::Part> expected;
+    aws_sigv4::MultipartSigner serial(signature, kMinPartSize, 1);
+    ASSERT_TRUE(serial.signParts(time, "/photos/large object.bin", "VXBsb2FkIElE.Zm9v-bar", host, 1, data, expected));
+    ASSERT_EQ(expected.size(), 7u);
+
+    size_t thread_counts[] = {2, 4, 16, 200};
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++)
+    {
+        aws_sigv4::MultipartSigner multipart(signature, kMinPartSize, thread_counts[t]);
+        std::vector<aws_sigv4::MultipartSigner::Part> parts;
+        ASSERT_TRUE(multipart.signParts(time, "/photos/large object.bin", "VXBsb2FkIElE.Zm9v-bar", host, 1, data, parts));
+        ASSERT_EQ(parts.size(), expected.size());
+        for (size_t i = 0; i < parts.size(); i++)
+        {
+            EXPECT_EQ(parts[i].payload_hash, expected[i].payload_hash) << i;
+            EXPECT_EQ(parts[i].authorization, expected[i].authorization) << i;
+        }
+    }
+}
+
+TEST(MultipartSigner, empty_object_is_one_empty_part)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+    aws_sigv4::HeaderField host[] = {{"Host", "examplebucket.s3.amazonaws.com"}};
+
+    aws_sigv4::MultipartSigner multipart(signature, kMinPartSize, 4);
+    std::vector<aws_sigv4::MultipartSigner::Part> parts;
+    ASSERT_TRUE(multipart.signParts(time, "/photos/large object.bin", "VXBsb2FkIElE.Zm9v-bar", host, 1, "", parts));
+    ASSERT_EQ(parts.size(), 1u);
+    EXPECT_EQ(parts[0].length, 0u);
+    EXPECT_EQ(parts[0].payload_hash, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    EXPECT_EQ(parts[0].authorization, SignPart(signature, time, 1, ""));
+}
+
+TEST(MultipartSigner, too_many_parts)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+    aws_sigv4::HeaderField host[] = {{"Host", "examplebucket.s3.amazonaws.com"}};
+
+    // One byte more than kMaxParts parts of the smallest size. The count is
+    // checked before anything is read, so a sparse file will do.
+    char path[] = "/tmp/awssigv4_multipart_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(ftruncate(fd, (off_t)aws_sigv4::MultipartSigner::kMaxParts * kMinPartSize + 1), 0);
+    close(fd);
+
+    aws_sigv4::MultipartSigner multipart(signature, kMinPartSize, 2);
+    std::vector<aws_sigv4::MultipartSigner::Part> parts(1);
+    EXPECT_FALSE(multipart.signFile(time, "/photos/large object.bin", "VXBsb2FkIElE.Zm9v-bar", host, 1, path, parts));
+    EXPECT_TRUE(parts.empty());
+    unlink(path);
+}
+
+TEST(MultipartSigner, long_headers_are_signed_in_full)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+
+    // Signed header names adding up to well over 4 KiB
+    std::vector<std::string> names;
+    std::vector<aws_sigv4::HeaderField> headers;
+    headers.push_back(aws_sigv4::HeaderField{"Host", "examplebucket.s3.amazonaws.com"});
+    for (size_t i = 0; i < 50; i++)
+        names.push_back("x-amz-meta-" + std::string(100, 'a' + i % 26) + std::to_string(i));
+    for (size_t i = 0; i < names.size(); i++)
+        headers.push_back(aws_sigv4::HeaderField{names[i], "v"});
+
+    aws_sigv4::MultipartSigner multipart(signature, kMinPartSize, 1);
+    std::vector<aws_sigv4::MultipartSigner::Part> parts;
+    ASSERT_TRUE(multipart.signParts(time, "/photos/large object.bin", "VXBsb2FkIElE.Zm9v-bar", headers.data(), headers.size(), "part", parts));
+    ASSERT_EQ(parts.size(), 1u);
+
+    std::vector<aws_sigv4::HeaderField> part_headers = headers;
+    part_headers.push_back(aws_sigv4::HeaderField{"x-amz-content-sha256", parts[0].payload_hash});
+    part_headers.push_back(aws_sigv4::HeaderField{"x-amz-date", time.amzdate});
+    char out[16384];
+    size_t length = signature.signRequest(time, "PUT", "/photos/large object.bin", "partNumber=1&uploadId=VXBsb2FkIElE.Zm9v-bar",
+                                          part_headers.data(), part_headers.size(), "part", out, sizeof(out));
+    ASSERT_GT(length, 4096u);
+    EXPECT_EQ(parts[0].authorization, std::string(out, length));
+}
+
+TEST(MultipartSigner, file_matches_buffer)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::RequestTime time;
+    signature.requestTime(time);
+    aws_sigv4::HeaderField host[] = {{"Host", "examplebucket.s3.amazonaws.com"}};
+
+    // Parts larger than the read size, so each one takes several reads
+    size_t part_size = kMinPartSize + 12345;
+    std::string data = TestObject(3 * part_size + 777);
+
+    char path[] = "/tmp/awssigv4_multipart_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, data.data(), data.size()), (ssize_t)data.size());
+    close(fd);
+
+    aws_sigv4::MultipartSigner multipart(signature, part_size, 3);
+    std::vector<aws_sigv4::MultipartSigner::Part> from_buffer, from_file;
+    ASSERT_TRUE(multipart.signParts(time, "/photos/large object.bin", "VXBsb2FkIElE.Zm9v-bar", host, 1, data, from_buffer));
+    ASSERT_TRUE(multipart.signFile(time, "/photos/large object.bin", "VXBsb2FkIElE.Zm9v-bar", host, 1, path, from_file));
+    unlink(path);
+
+    ASSERT_EQ(from_file.size(), 4u);
+    ASSERT_EQ(from_file.size(), from_buffer.size());
+    for (size_t i = 0; i < from_file.size(); i++)
+    {
+        EXPECT_EQ(from_file[i].length, from_buffer[i].length);
+        EXPECT_EQ(from_file[i].payload_hash, from_buffer[i].payload_hash);
+        EXPECT_EQ(from_file[i].authorization, from_buffer[i].authorization);
+    }
+
+    EXPECT_FALSE(multipart.signFile(time, "/photos/large object.bin", "VXBsb2FkIElE.Zm9v-bar", host, 1, path, from_file));
+    EXPECT_TRUE(from_file.empty());
+}
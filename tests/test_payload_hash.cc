@@ -0,0 +1,158 @@
+#include "gtest/gtest.h"
+#include <map>
+#include <string>
+#include <vector>
+
+#include "awssigv4.h"
+#include "test_util.h"
+
+// Payload hash modes, checked against signing the payload itself
+
+static std::string Sign(const aws_sigv4::Signature &signature, const aws_sigv4::PayloadHash &payload_hash, std::string *canonical_request=NULL)
+{
+    aws_sigv4::HeaderField headers[] = {
+        {"Host", "examplebucket.s3.amazonaws.com"},
+        {"x-amz-date", "20110909T233600Z"},
+    };
+    char out[1024];
+    size_t length = signature.signRequest("PUT", "/photos/large.bin", "", headers, 2, payload_hash, out, sizeof(out), canonical_request);
+    return std::string(out, length);
+}
+
+static std::string SignPayload(const aws_sigv4::Signature &signature, std::string_view payload)
+{
+    aws_sigv4::HeaderField headers[] = {
+        {"Host", "examplebucket.s3.amazonaws.com"},
+        {"x-amz-date", "20110909T233600Z"},
+    };
+    char out[1024];
+    size_t length = signature.signRequest("PUT", "/photos/large.bin", "", headers, 2, payload, out, sizeof(out));
+    return std::string(out, length);
+}
+
+TEST(PayloadHash, modes)
+{
+    const char *kEmpty = "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+
+    aws_sigv4::PayloadHash computed = aws_sigv4::PayloadHash::computed("payload");
+    EXPECT_EQ(computed.mode(), aws_sigv4::PayloadHash::kComputed);
+    EXPECT_TRUE(computed.valid());
+    EXPECT_EQ(computed.payload(), "payload");
+    EXPECT_EQ(computed.value(), "");
+
+    aws_sigv4::PayloadHash empty = aws_sigv4::PayloadHash::empty();
+    EXPECT_EQ(empty.mode(), aws_sigv4::PayloadHash::kEmpty);
+    EXPECT_EQ(empty.value(), kEmpty);
+
+    aws_sigv4::PayloadHash unsigned_payload = aws_sigv4::PayloadHash::unsignedPayload();
+    EXPECT_EQ(unsigned_payload.mode(), aws_sigv4::PayloadHash::kUnsigned);
+    EXPECT_EQ(unsigned_payload.value(), "UNSIGNED-PAYLOAD");
+    EXPECT_EQ(unsigned_payload.payload(), "");
+
+    // Hex digits are lowercased
+    aws_sigv4::PayloadHash hex = aws_sigv4::PayloadHash::fromHex("E3B0C44298FC1C149AFBF4C8996FB92427AE41E4649B934CA495991B7852B855");
+    EXPECT_EQ(hex.mode(), aws_sigv4::PayloadHash::kPrecomputed);
+    EXPECT_TRUE(hex.valid());
+    EXPECT_EQ(hex.value(), kEmpty);
+
+    unsigned char digest[aws_sigv4::kSha256DigestLength];
+    aws_sigv4::Sha256::digest("", 0, digest);
+    EXPECT_EQ(aws_sigv4::PayloadHash::fromDigest(digest).value(), kEmpty);
+}
+
+TEST(PayloadHash, invalid_hex)
+{
+    const char *invalid[] = {
+        "",
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b85",
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b8555",
+        "g3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b85 ",
+        "UNSIGNED-PAYLOAD",
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        aws_sigv4::PayloadHash hash = aws_sigv4::PayloadHash::fromHex(invalid[i]);
+        EXPECT_FALSE(hash.valid()) << invalid[i];
+        EXPECT_EQ(hash.value(), "") << invalid[i];
+    }
+}
+
+TEST(PayloadHash, precomputed_matches_computed)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    std::string payload(100000, 'x');
+
+    unsigned char digest[aws_sigv4::kSha256DigestLength];
+    aws_sigv4::Sha256::digest(payload.data(), payload.length(), digest);
+    aws_sigv4::PayloadHash from_digest = aws_sigv4::PayloadHash::fromDigest(digest);
+    aws_sigv4::PayloadHash from_hex = aws_sigv4::PayloadHash::fromHex(from_digest.value());
+
+    std::string expected = SignPayload(signature, payload);
+    ASSERT_NE(expected, "");
+    EXPECT_EQ(Sign(signature, aws_sigv4::PayloadHash::computed(payload)), expected);
+    EXPECT_EQ(Sign(signature, from_digest), expected);
+    EXPECT_EQ(Sign(signature, from_hex), expected);
+
+    EXPECT_EQ(Sign(signature, aws_sigv4::PayloadHash::empty()), SignPayload(signature, ""));
+}
+
+TEST(PayloadHash, unsigned_payload)
+{
+    aws_sigv4::Signature signature = S3Signer();
+
+    std::string canonical_request;
+    std::string authorization = Sign(signature, aws_sigv4::PayloadHash::unsignedPayload(), &canonical_request);
+    ASSERT_NE(authorization, "");
+    EXPECT_EQ(canonical_request, "PUT\n/photos/large.bin\n\nhost:examplebucket.s3.amazonaws.com\nx-amz-date:20110909T233600Z\n\n"
+              "host;x-amz-date\nUNSIGNED-PAYLOAD");
+    EXPECT_NE(authorization, SignPayload(signature, ""));
+
+    // The map API signs the same
+    std::map<std::string, std::vector<std::string> > header_map;
+    header_map["Host"].push_back("examplebucket.s3.amazonaws.com");
+    header_map["x-amz-date"].push_back("20110909T233600Z");
+    std::string map_canonical_request;
+    EXPECT_EQ(signature.signRequest("PUT", "/photos/large.bin", "", header_map, aws_sigv4::PayloadHash::unsignedPayload(), &map_canonical_request), authorization);
+    EXPECT_EQ(map_canonical_request, canonical_request);
+    EXPECT_EQ(signature.createCanonicalRequest("PUT", "/photos/large.bin", "", header_map, aws_sigv4::PayloadHash::unsignedPayload()), canonical_request);
+}
+
+TEST(PayloadHash, prepared_request)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::HeaderField fixed[] = {{"Host", "examplebucket.s3.amazonaws.com"}};
+    std::string_view names[] = {"x-amz-date"};
+    std::string_view values[] = {"20110909T233600Z"};
+    aws_sigv4::PreparedRequest prepared(signature, "PUT", "/photos/large.bin", fixed, 1, names, 1);
+
+    aws_sigv4::PayloadHash modes[] = {
+        aws_sigv4::PayloadHash::unsignedPayload(),
+        aws_sigv4::PayloadHash::empty(),
+        aws_sigv4::PayloadHash::fromHex("2CF24DBA5FB0A30E26E83B2AC5B9E29E1B161E5C1FA7425E73043362938B9824"),
+    };
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+    {
+        char out[1024];
+        size_t length = prepared.sign(values, "", modes[i], out, sizeof(out));
+        EXPECT_EQ(std::string(out, length), Sign(signature, modes[i])) << i;
+    }
+}
+
+TEST(PayloadHash, invalid_hash_is_rejected)
+{
+    aws_sigv4::Signature signature = S3Signer();
+    aws_sigv4::PayloadHash invalid = aws_sigv4::PayloadHash::fromHex("not a hash");
+
+    EXPECT_EQ(Sign(signature, invalid), "");
+
+    std::map<std::string, std::vector<std::string> > header_map;
+    header_map["Host"].push_back("examplebucket.s3.amazonaws.com");
+    EXPECT_EQ(signature.signRequest("PUT", "/", "", header_map, invalid), "");
+    EXPECT_EQ(signature.createCanonicalRequest("PUT", "/", "", header_map, invalid), "");
+
+    aws_sigv4::HeaderField fixed[] = {{"Host", "examplebucket.s3.amazonaws.com"}};
+    aws_sigv4::PreparedRequest prepared(signature, "PUT", "/", fixed, 1, NULL, 0);
+    char out[1024];
+    EXPECT_EQ(prepared.sign(NULL, "", invalid, out, sizeof(out)), 0u);
+}
@@ -0,0 +1,167 @@
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+#include "awssigv4.h"
+#include "awssigv4_clock.h"
+#include "test_util.h"
+
+// Requests signed from a PreparedRequest, checked byte for byte against
+// Signature::signRequest over the same headers
+
+// Full signing of the fixed headers followed by the variable ones
+static std::string SignFull(
+    const aws_sigv4::Signature &signature,
+    std::string_view method,
+    std::string_view path,
+    const std::vector<aws_sigv4::HeaderField> &fixed,
+    const std::vector<std::string_view> &names,
+    const std::vector<std::string_view> &values,
+    std::string_view query,
+    std::string_view payload)
+{
+    std::vector<aws_sigv4::HeaderField> headers(fixed);
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        aws_sigv4::HeaderField field = {names[i], values[i]};
+        headers.push_back(field);
+    }
+    char out[1024];
+    size_t length = signature.signRequest(method, path, query, headers.data(), headers.size(), payload, out, sizeof(out));
+    return std::string(out, length);
+}
+
+static std::string SignPrepared(const aws_sigv4::PreparedRequest &prepared, const std::vector<std::string_view> &values, std::string_view query, std::string_view payload)
+{
+    char out[1024];
+    size_t length = prepared.sign(values.data(), query, payload, out, sizeof(out));
+    return std::string(out, length);
+}
+
+TEST(PreparedRequest, matches_full_signing)
+{
+    aws_sigv4::Signature signature = DynamoSigner();
+    std::vector<aws_sigv4::HeaderField> fixed = {
+        {"Content-Type", "application/x-amz-json-1.0"},
+        {"Host", "dynamodb.us-east-1.amazonaws.com"},
+        {"X-Amz-Target", "DynamoDB_20120810.PutItem"},
+    };
+    std::vector<std::string_view> names = {"X-Amz-Date"};
+    aws_sigv4::PreparedRequest prepared(signature, "POST", "/", fixed.data(), fixed.size(), names.data(), names.size());
+    ASSERT_TRUE(prepared.valid());
+    EXPECT_EQ(prepared.signedHeaders(), "content-type;host;x-amz-date;x-amz-target");
+
+    const char *payloads[] = {"", "{\"TableName\":\"t\",\"Item\":{\"k\":{\"S\":\"v\"}}}", "{\"TableName\":\"other\"}"};
+    for (size_t i = 0; i < 3; i++)
+    {
+        std::vector<std::string_view> values = {"20110909T233600Z"};
+        std::string expected = SignFull(signature, "POST", "/", fixed, names, values, "", payloads[i]);
+        ASSERT_FALSE(expected.empty());
+        EXPECT_EQ(SignPrepared(prepared, values, "", payloads[i]), expected);
+    }
+}
+
+TEST(PreparedRequest, header_layouts)
+{
+    aws_sigv4::Signature signature = DynamoSigner();
+
+    // Variable headers first, last, between fixed ones and next to each
+    // other; repeated and case-varied fixed names; values needing trimming
+    // and whitespace collapsing
+    std::vector<aws_sigv4::HeaderField> fixed = {
+        {"Host", "dynamodb.us-east-1.amazonaws.com"},
+        {"ZOO", "zoobar"},
+        {"zoo", "foobar"},
+        {"  My-Header ", "  a   b \t c  "},
+        {"X-Amz-Meta", ""},
+        {"Content-Type", "application/x-amz-json-1.0"},
+    };
+    std::vector<std::string_view> names = {"x-amz-date", "Accept", "Zulu", " Mid-Header", "X-Amz-Security-Token"};
+    aws_sigv4::PreparedRequest prepared(signature, "PUT", "/a/./b/../c d", fixed.data(), fixed.size(), names.data(), names.size());
+    ASSERT_TRUE(prepared.valid());
+    EXPECT_EQ(prepared.signedHeaders(), "accept;content-type;host;mid-header;my-header;x-amz-date;x-amz-meta;x-amz-security-token;zoo;zulu");
+
+    std::vector<std::vector<std::string_view> > value_sets = {
+        {"20110909T233600Z", "*/*", "z", "m", "token"},
+        {"20110909T233601Z", "  text/plain  ", "two  spaces", "", "a\n  folded"},
+        {"", "", "", "", ""},
+    };
+    const char *queries[] = {"", "b=2&a=1", "Action=ListUsers&Version=2010-05-08", "a b=c d&%41=%7e", "x"};
+    for (size_t v = 0; v < value_sets.size(); v++)
+    {
+        for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++)
+        {
+            std::string expected = SignFull(signature, "PUT", "/a/./b/../c d", fixed, names, value_sets[v], queries[q], "payload");
+            ASSERT_FALSE(expected.empty());
+            EXPECT_EQ(SignPrepared(prepared, value_sets[v], queries[q], "payload"), expected) << v << " " << queries[q];
+        }
+    }
+}
+
+TEST(PreparedRequest, no_variable_headers)
+{
+    aws_sigv4::Signature signature = TestSigner();
+    std::vector<aws_sigv4::HeaderField> fixed = {
+        {"Date", "Mon, 09 Sep 2011 23:36:00 GMT"},
+        {"Host", "host.foo.com"},
+    };
+    aws_sigv4::PreparedRequest prepared(signature, "GET", "/", fixed.data(), fixed.size(), NULL, 0);
+    ASSERT_TRUE(prepared.valid());
+
+    // The get-vanilla-query-order-value test suite request
+    std::string expected = SignFull(signature, "GET", "/", fixed, std::vector<std::string_view>(), std::vector<std::string_view>(), "foo=b&foo=a", "");
+    EXPECT_EQ(SignPrepared(prepared, std::vector<std::string_view>(), "foo=b&foo=a", ""), expected);
+    EXPECT_EQ(expected, "AWS4-HMAC-SHA256 Credential=AKIDEXAMPLE/20110909/us-east-1/host/aws4_request, SignedHeaders=date;host, "
+        "Signature=feb926e49e382bec75c9d7dcb2a1b6dc8aa50ca43c25d2bc51143768c0875acc");
+}
+
+TEST(PreparedRequest, signs_at_request_time)
+{
+    aws_sigv4::FixedClock clock(kTestSuiteTime);
+    aws_sigv4::TimestampCache timestamps(clock);
+    aws_sigv4::Signature signature("dynamodb", "dynamodb.us-east-1.amazonaws.com", "us-east-1", kTestSecretKey, kTestAccessKey, timestamps);
+    std::vector<aws_sigv4::HeaderField> fixed = {{"Host", "dynamodb.us-east-1.amazonaws.com"}};
+    std::vector<std::string_view> names = {"X-Amz-Date"};
+    aws_sigv4::PreparedRequest prepared(signature, "POST", "/", fixed.data(), fixed.size(), names.data(), names.size());
+
+    for (int day = 0; day < 2; day++)
+    {
+        clock.advance(day * 86400);
+        aws_sigv4::RequestTime time;
+        signature.requestTime(time);
+        std::vector<std::string_view> values = {time.amzdate};
+        std::vector<aws_sigv4::HeaderField> headers = {fixed[0], {"X-Amz-Date", time.amzdate}};
+
+        char full[512], out[512];
+        size_t full_length = signature.signRequest(time, "POST", "/", "", headers.data(), headers.size(), "{}", full, sizeof(full));
+        size_t length = prepared.sign(time, values.data(), "", "{}", out, sizeof(out));
+        EXPECT_EQ(std::string(out, length), std::string(full, full_length));
+        EXPECT_NE(std::string(out, length).find(time.datestamp), std::string::npos);
+    }
+}
+
+TEST(PreparedRequest, invalid_templates)
+{
+    aws_sigv4::Signature signature = DynamoSigner();
+    std::vector<aws_sigv4::HeaderField> fixed = {{"Host", "dynamodb.us-east-1.amazonaws.com"}};
+    char out[512];
+
+    std::vector<std::string_view> clash = {"host"};
+    aws_sigv4::PreparedRequest fixed_clash(signature, "POST", "/", fixed.data(), fixed.size(), clash.data(), clash.size());
+    EXPECT_FALSE(fixed_clash.valid());
+    EXPECT_EQ(fixed_clash.sign(clash.data(), "", "", out, sizeof(out)), 0u);
+
+    std::vector<std::string_view> twice = {"X-Amz-Date", "x-amz-date"};
+    aws_sigv4::PreparedRequest repeated(signature, "POST", "/", fixed.data(), fixed.size(), twice.data(), twice.size());
+    EXPECT_FALSE(repeated.valid());
+
+    // Limits as signRequest's
+    std::vector<std::string_view> names = {"X-Amz-Date"};
+    std::vector<std::string_view> values = {"20110909T233600Z"};
+    aws_sigv4::PreparedRequest prepared(signature, "POST", "/", fixed.data(), fixed.size(), names.data(), names.size());
+    EXPECT_EQ(prepared.sign(values.data(), "", "", out, 100), 0u);
+    std::string query;
+    for (size_t i = 0; i <= aws_sigv4::Signature::kMaxQueryParameters; i++)
+        query += "p" + std::to_string(i) + "=v&";
+    EXPECT_EQ(prepared.sign(values.data(), query, "", out, sizeof(out)), 0u);
+}
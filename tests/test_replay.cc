@@ -0,0 +1,168 @@
+#include "gtest/gtest.h"
+#include <atomic>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "awssigv4_replay.h"
+
+// Signatures recorded by time bucket, expired as request times move on
+
+static const time_t kNow = 1315611360; // 20110909T233600Z
+
+// A distinct, HMAC-like signature per index
+static void MakeSignature(uint64_t index, unsigned char signature[aws_sigv4::kSha256DigestLength])
+{
+    aws_sigv4::Sha256::digest(&index, sizeof(index), signature);
+}
+
+TEST(ReplayCache, detects_replays)
+{
+    aws_sigv4::ReplayCache cache(900, 1000, 4);
+    unsigned char a[32], b[32];
+    MakeSignature(1, a);
+    MakeSignature(2, b);
+
+    EXPECT_FALSE(cache.contains(a, kNow));
+    EXPECT_EQ(cache.insert(a, kNow), aws_sigv4::ReplayCache::kFirstSeen);
+    EXPECT_TRUE(cache.contains(a, kNow));
+    EXPECT_EQ(cache.insert(a, kNow), aws_sigv4::ReplayCache::kReplayed);
+    EXPECT_EQ(cache.insert(b, kNow), aws_sigv4::ReplayCache::kFirstSeen);
+    EXPECT_EQ(cache.insert(b, kNow), aws_sigv4::ReplayCache::kReplayed);
+    EXPECT_EQ(cache.insert(a, kNow), aws_sigv4::ReplayCache::kReplayed);
+
+    // Replays always carry the original request time
+    EXPECT_FALSE(cache.contains(a, kNow + 3600));
+}
+
+TEST(ReplayCache, expires_by_request_time)
+{
+    aws_sigv4::ReplayCache cache(900, 1000, 1);
+    unsigned char a[32], b[32];
+    MakeSignature(1, a);
+    MakeSignature(2, b);
+    EXPECT_EQ(cache.insert(a, kNow), aws_sigv4::ReplayCache::kFirstSeen);
+
+    // Still remembered across the whole window and beyond it
+    for (time_t later = 0; later <= 2 * 900; later += 10)
+    {
+        MakeSignature(100 + later, b);
+        EXPECT_EQ(cache.insert(b, kNow + later), aws_sigv4::ReplayCache::kFirstSeen);
+    }
+    EXPECT_TRUE(cache.contains(a, kNow));
+    EXPECT_EQ(cache.insert(a, kNow), aws_sigv4::ReplayCache::kReplayed);
+
+    // Until newer requests need the bucket
+    for (time_t later = 2 * 900; later <= 4 * 900; later += 10)
+    {
+        MakeSignature(100 + later, b);
+        cache.insert(b, kNow + later);
+    }
+    EXPECT_FALSE(cache.contains(a, kNow));
+
+    // and what was forgotten can no longer be recorded
+    EXPECT_EQ(cache.insert(a, kNow), aws_sigv4::ReplayCache::kNotRecorded);
+}
+
+TEST(ReplayCache, times_before_1970)
+{
+    aws_sigv4::ReplayCache cache(900, 1000, 4);
+    unsigned char a[32], b[32];
+    MakeSignature(1, a);
+    MakeSignature(2, b);
+
+    // Negative times, across the zero boundary, behave like any others
+    time_t times[] = {-1, -113, -900, -3600 - 7, -kNow};
+    for (size_t i = 0; i < sizeof(times) / sizeof(times[0]); i++)
+    {
+        aws_sigv4::ReplayCache fresh(900, 1000, 4);
+        EXPECT_FALSE(fresh.contains(a, times[i])) << times[i];
+        EXPECT_EQ(fresh.insert(a, times[i]), aws_sigv4::ReplayCache::kFirstSeen) << times[i];
+        EXPECT_TRUE(fresh.contains(a, times[i])) << times[i];
+        EXPECT_EQ(fresh.insert(a, times[i]), aws_sigv4::ReplayCache::kReplayed) << times[i];
+    }
+
+    // Just before and just after 1970 share nothing
+    EXPECT_EQ(cache.insert(a, -1), aws_sigv4::ReplayCache::kFirstSeen);
+    EXPECT_EQ(cache.insert(b, 0), aws_sigv4::ReplayCache::kFirstSeen);
+    EXPECT_FALSE(cache.contains(a, 0));
+    EXPECT_FALSE(cache.contains(b, -1));
+    EXPECT_EQ(cache.insert(a, -1), aws_sigv4::ReplayCache::kReplayed);
+
+    // and expire as request times move past 1970
+    for (time_t later = 0; later <= 4 * 900; later += 10)
+    {
+        MakeSignature(100 + later, b);
+        cache.insert(b, later);
+    }
+    EXPECT_FALSE(cache.contains(a, -1));
+}
+
+TEST(ReplayCache, bounded_memory)
+{
+    aws_sigv4::ReplayCache cache(60, 100, 1);
+    size_t bytes = cache.memoryBytes();
+    EXPECT_GT(bytes, 0u);
+
+    // Flooding one second fills its bucket and stops there
+    size_t first_seen = 0, not_recorded = 0;
+    for (uint64_t i = 0; i < 10000; i++)
+    {
+        unsigned char signature[32];
+        MakeSignature(i, signature);
+        aws_sigv4::ReplayCache::Result result = cache.insert(signature, kNow);
+        first_seen += result == aws_sigv4::ReplayCache::kFirstSeen;
+        not_recorded += result == aws_sigv4::ReplayCache::kNotRecorded;
+    }
+    EXPECT_GT(first_seen, 0u);
+    EXPECT_LT(first_seen, 100u);
+    EXPECT_EQ(first_seen + not_recorded, 10000u);
+    EXPECT_EQ(cache.memoryBytes(), bytes);
+
+    // Other seconds have their own room
+    unsigned char signature[32];
+    MakeSignature(20000, signature);
+    EXPECT_EQ(cache.insert(signature, kNow + 30), aws_sigv4::ReplayCache::kFirstSeen);
+
+    // Capacity is spread over the window
+    size_t spread = 0;
+    for (uint64_t i = 0; i < 200; i++)
+    {
+        MakeSignature(30000 + i, signature);
+        spread += cache.insert(signature, kNow + 60 + (time_t)i % 120) == aws_sigv4::ReplayCache::kFirstSeen;
+    }
+    EXPECT_GE(spread, 100u);
+}
+
+TEST(ReplayCache, one_first_seen_across_threads)
+{
+    static const size_t kThreads = 8;
+    static const uint64_t kSignatures = 2000;
+    aws_sigv4::ReplayCache cache(900, 100000, 16);
+    std::atomic<size_t> first_seen(0), replayed(0);
+
+    // Every thread tries every signature, in a different order
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kThreads; t++)
+    {
+        threads.push_back(std::thread([&cache, &first_seen, &replayed, t]() {
+            for (uint64_t i = 0; i < kSignatures; i++)
+            {
+                uint64_t index = (i * 7 + t * 131) % kSignatures;
+                unsigned char signature[32];
+                MakeSignature(index, signature);
+                switch (cache.insert(signature, kNow + (time_t)(index % 600)))
+                {
+                    case aws_sigv4::ReplayCache::kFirstSeen: first_seen++; break;
+                    case aws_sigv4::ReplayCache::kReplayed: replayed++; break;
+                    case aws_sigv4::ReplayCache::kNotRecorded: break;
+                }
+            }
+        }));
+    }
+    for (size_t t = 0; t < kThreads; t++)
+        threads[t].join();
+
+    EXPECT_EQ(first_seen.load(), kSignatures);
+    EXPECT_EQ(replayed.load(), kSignatures * (kThreads - 1));
+}
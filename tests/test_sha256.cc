@@ -0,0 +1,221 @@
+#include "gtest/gtest.h"
+#include "fstream"
+#include <sstream>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef AWSSIGV4_NO_OPENSSL
+#include "openssl/sha.h"
+#endif
+#include "awssigv4_sha256.h"
+
+typedef unsigned char Digest[aws_sigv4::MultiBufferSha256::kDigestLength];
+
+static const aws_sigv4::MultiBufferSha256::Kernel kKernels[] = {
+    aws_sigv4::MultiBufferSha256::kScalar,
+    aws_sigv4::MultiBufferSha256::kAvx2,
+    aws_sigv4::MultiBufferSha256::kAvx512
+};
+
+static const char *kTestSuiteVectors[] = {
+    "get-header-key-duplicate", "get-header-value-order", "get-header-value-trim", "get-relative",
+    "get-relative-relative", "get-slash", "get-slash-dot-slash", "get-slashes", "get-slash-pointless-dot",
+    "get-space", "get-unreserved", "get-utf8", "get-vanilla", "get-vanilla-empty-query-key",
+    "get-vanilla-query", "get-vanilla-query-order-key", "get-vanilla-query-order-key-case",
+    "get-vanilla-query-order-value", "get-vanilla-query-unreserved", "get-vanilla-ut8-query",
+    "post-header-key-case", "post-header-key-sort", "post-header-value-case", "post-vanilla",
+    "post-vanilla-empty-query-value", "post-vanilla-query", "post-vanilla-query-nonunreserved",
+    "post-vanilla-query-space", "post-x-www-form-urlencoded", "post-x-www-form-urlencoded-parameters"
+};
+
+static std::string ReadTestSuiteFile(std::string file_name)
+{
+    std::ifstream file(file_name.c_str(), std::ios::in|std::ios::binary);
+    std::stringstream stream;
+    stream << file.rdbuf();
+
+    std::string contents = stream.str();
+    contents.erase(std::remove(contents.begin(), contents.end(), '\r'), contents.end());
+    return contents;
+}
+
+static std::string Hex(const unsigned char *digest)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    for (size_t i = 0; i < aws_sigv4::kSha256DigestLength; i++)
+    {
+        hex += digits[digest[i] >> 4];
+        hex += digits[digest[i] & 0xf];
+    }
+    return hex;
+}
+
+TEST(MultiBufferSha256, scalar_always_supported)
+{
+    EXPECT_TRUE(aws_sigv4::MultiBufferSha256::supported(aws_sigv4::MultiBufferSha256::kScalar));
+    EXPECT_TRUE(aws_sigv4::MultiBufferSha256::supported(aws_sigv4::MultiBufferSha256::bestKernel()));
+
+    aws_sigv4::MultiBufferSha256 scalar(aws_sigv4::MultiBufferSha256::kScalar);
+    EXPECT_EQ(scalar.lanes(), 1u);
+}
+
+// Checks every supported kernel against reference on lengths around the
+// padding boundaries (55, 56, 64) and spanning several blocks, in uneven
+// lanes
+static void CheckKernelsAcrossLengths(void (*reference)(const std::string &, unsigned char *))
+{
+    std::vector<std::string> payloads;
+    for (size_t length = 0; length <= 300; length++)
+    {
+        std::string payload(length, '\0');
+        for (size_t i = 0; i < length; i++)
+            payload[i] = (char)(i * 31 + length);
+        payloads.push_back(payload);
+    }
+
+    std::vector<std::string_view> messages(payloads.begin(), payloads.end());
+    std::unique_ptr<Digest[]> digests(new Digest[messages.size()]);
+
+    for (size_t k = 0; k < sizeof(kKernels) / sizeof(kKernels[0]); k++)
+    {
+        if (!aws_sigv4::MultiBufferSha256::supported(kKernels[k]))
+            continue;
+
+        aws_sigv4::MultiBufferSha256 hasher(kKernels[k]);
+        hasher.hash(messages.data(), messages.size(), digests.get());
+
+        for (size_t i = 0; i < payloads.size(); i++)
+        {
+            unsigned char expected[aws_sigv4::kSha256DigestLength];
+            reference(payloads[i], expected);
+            EXPECT_EQ(Hex(digests[i]), Hex(expected)) << aws_sigv4::MultiBufferSha256::kernelName(kKernels[k]) << " length " << i;
+        }
+    }
+}
+
+static void BuiltinSha256(const std::string &payload, unsigned char *digest)
+{
+    aws_sigv4::CryptoBackend::find("builtin")->sha256(payload.data(), payload.length(), digest);
+}
+
+TEST(MultiBufferSha256, matches_builtin_across_lengths)
+{
+    CheckKernelsAcrossLengths(BuiltinSha256);
+}
+
+#ifndef AWSSIGV4_NO_OPENSSL
+// Independent of the backends the library can be built with
+static void OpensslSha256(const std::string &payload, unsigned char *digest)
+{
+    SHA256((const unsigned char *)payload.data(), payload.length(), digest);
+}
+
+TEST(MultiBufferSha256, matches_openssl_across_lengths)
+{
+    CheckKernelsAcrossLengths(OpensslSha256);
+}
+#endif
+
+TEST(MultiBufferSha256, continues_from_midstate)
+{
+    std::string prefix(64, 'k');
+    aws_sigv4::Sha256 sha256;
+    sha256.update(prefix);
+    aws_sigv4::Sha256Midstate midstate = sha256.midstate();
+
+    std::vector<std::string> payloads;
+    for (size_t length = 0; length < 130; length += 7)
+        payloads.push_back(std::string(length, 'm'));
+    std::vector<std::string_view> messages(payloads.begin(), payloads.end());
+    std::unique_ptr<Digest[]> digests(new Digest[messages.size()]);
+
+    for (size_t k = 0; k < sizeof(kKernels) / sizeof(kKernels[0]); k++)
+    {
+        if (!aws_sigv4::MultiBufferSha256::supported(kKernels[k]))
+            continue;
+
+        aws_sigv4::MultiBufferSha256 hasher(kKernels[k]);
+        hasher.hash(midstate, messages.data(), messages.size(), digests.get());
+
+        for (size_t i = 0; i < payloads.size(); i++)
+        {
+            std::string whole = prefix + payloads[i];
+            unsigned char expected[aws_sigv4::kSha256DigestLength];
+            aws_sigv4::CryptoBackend::find("builtin")->sha256(whole.data(), whole.length(), expected);
+            EXPECT_EQ(Hex(digests[i]), Hex(expected)) << aws_sigv4::MultiBufferSha256::kernelName(kKernels[k]) << " message " << i;
+        }
+    }
+}
+
+TEST(MultiBufferSha256, large_message_among_small_ones)
+{
+    // One upload sized message in a batch of small ones, spread over more
+    // messages than are ordered by length at a time
+    std::vector<std::string> payloads;
+    for (size_t i = 0; i < 100; i++)
+        payloads.push_back(std::string(i % 5 * 40, (char)('a' + i % 26)));
+    payloads[3] = std::string(1 << 20, 'L');
+    payloads[70] = std::string(3000, 'M');
+    std::vector<std::string_view> messages(payloads.begin(), payloads.end());
+    std::unique_ptr<Digest[]> digests(new Digest[messages.size()]);
+
+    std::string prefix(64, 'k');
+    aws_sigv4::Sha256 sha256;
+    sha256.update(prefix);
+    aws_sigv4::Sha256Midstate midstate = sha256.midstate();
+
+    for (size_t k = 0; k < sizeof(kKernels) / sizeof(kKernels[0]); k++)
+    {
+        if (!aws_sigv4::MultiBufferSha256::supported(kKernels[k]))
+            continue;
+
+        aws_sigv4::MultiBufferSha256 hasher(kKernels[k]);
+        hasher.hash(messages.data(), messages.size(), digests.get());
+        for (size_t i = 0; i < payloads.size(); i++)
+        {
+            unsigned char expected[aws_sigv4::kSha256DigestLength];
+            BuiltinSha256(payloads[i], expected);
+            EXPECT_EQ(Hex(digests[i]), Hex(expected)) << aws_sigv4::MultiBufferSha256::kernelName(kKernels[k]) << " message " << i;
+        }
+
+        hasher.hash(midstate, messages.data(), messages.size(), digests.get());
+        for (size_t i = 0; i < payloads.size(); i++)
+        {
+            unsigned char expected[aws_sigv4::kSha256DigestLength];
+            BuiltinSha256(prefix + payloads[i], expected);
+            EXPECT_EQ(Hex(digests[i]), Hex(expected)) << aws_sigv4::MultiBufferSha256::kernelName(kKernels[k]) << " message " << i << " from midstate";
+        }
+    }
+}
+
+TEST(MultiBufferSha256, canonical_requests_match_test_suite)
+{
+    // The last line of each string to sign is the hash of its canonical request
+    std::vector<std::string> canonical_requests, expected;
+    for (size_t i = 0; i < sizeof(kTestSuiteVectors) / sizeof(kTestSuiteVectors[0]); i++)
+    {
+        std::string base = std::string("aws4_testsuite/") + kTestSuiteVectors[i];
+        canonical_requests.push_back(ReadTestSuiteFile(base + ".creq"));
+
+        std::string string_to_sign = ReadTestSuiteFile(base + ".sts");
+        expected.push_back(string_to_sign.substr(string_to_sign.rfind('\n') + 1));
+    }
+
+    std::vector<std::string_view> messages(canonical_requests.begin(), canonical_requests.end());
+    std::unique_ptr<Digest[]> digests(new Digest[messages.size()]);
+
+    for (size_t k = 0; k < sizeof(kKernels) / sizeof(kKernels[0]); k++)
+    {
+        if (!aws_sigv4::MultiBufferSha256::supported(kKernels[k]))
+            continue;
+
+        aws_sigv4::MultiBufferSha256 hasher(kKernels[k]);
+        hasher.hash(messages.data(), messages.size(), digests.get());
+
+        for (size_t i = 0; i < messages.size(); i++)
+            EXPECT_EQ(Hex(digests[i]), expected[i]) << aws_sigv4::MultiBufferSha256::kernelName(kKernels[k]) << " " << kTestSuiteVectors[i];
+    }
+}
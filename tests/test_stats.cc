@@ -0,0 +1,127 @@
+#include "gtest/gtest.h"
+#include <map>
+#include <string>
+#include <vector>
+
+#include "awssigv4_stats.h"
+#include "test_util.h"
+
+// Per-stage statistics of the signer: recorded with AWSSIGV4_STATS, and
+// nothing at all without it
+
+static void SignSome(size_t count)
+{
+    aws_sigv4::Signature signature = TestSigner();
+    signature.setKeyCache(NULL);
+    aws_sigv4::HeaderField headers[] = {{"Host", "host.foo.com"}, {"X-Amz-Date", "20110909T233600Z"}};
+    char out[512];
+    for (size_t i = 0; i < count; i++)
+        signature.signRequest("POST", "/", "a=b", headers, 2, "payload", out, sizeof(out));
+}
+
+TEST(SigningStats, histogram_buckets)
+{
+    aws_sigv4::SigningStats &stats = aws_sigv4::SigningStats::global();
+    stats.reset();
+    stats.record(aws_sigv4::kStageSignature, 0, 0);
+    stats.record(aws_sigv4::kStageSignature, 0, 1);
+    stats.record(aws_sigv4::kStageSignature, 0, 2);
+    stats.record(aws_sigv4::kStageSignature, 0, 1000);
+    stats.record(aws_sigv4::kStageSignature, 0, 1023);
+    stats.record(aws_sigv4::kStageSignature, 0, 1024);
+    stats.record(aws_sigv4::kStageSignature, 32, UINT64_MAX / 2);
+    stats.recordKeyLookup(true);
+    stats.recordKeyLookup(false);
+    stats.recordKeyLookup(false);
+
+    aws_sigv4::SigningStats::Snapshot snapshot;
+    stats.snapshot(snapshot);
+    const aws_sigv4::SigningStats::StageStats &signature = snapshot.stages[aws_sigv4::kStageSignature];
+    EXPECT_EQ(signature.calls, 7u);
+    EXPECT_EQ(signature.bytes, 32u);
+    EXPECT_EQ(signature.latency[0], 2u);
+    EXPECT_EQ(signature.latency[1], 1u);
+    EXPECT_EQ(signature.latency[9], 2u);
+    EXPECT_EQ(signature.latency[10], 1u);
+    EXPECT_EQ(signature.latency[aws_sigv4::SigningStats::kLatencyBuckets - 1], 1u);
+    EXPECT_EQ(snapshot.key_cache_hits, 1u);
+    EXPECT_EQ(snapshot.key_cache_misses, 2u);
+
+    // Flattened, with cumulative buckets
+    std::map<std::string, uint64_t> metrics;
+    aws_sigv4::SigningStats::visit(snapshot, [&metrics](const aws_sigv4::SigningStats::Metric &metric) {
+        std::string key = metric.name;
+        if (metric.stage != NULL)
+            key = std::string(metric.stage) + "." + key;
+        if (metric.bucket_limit_ns != 0)
+            key += "<" + std::to_string(metric.bucket_limit_ns);
+        metrics[key] = metric.value;
+    });
+    EXPECT_EQ(metrics["signature.calls"], 7u);
+    EXPECT_EQ(metrics["signature.latency_bucket<2"], 2u);
+    EXPECT_EQ(metrics["signature.latency_bucket<1024"], 5u);
+    EXPECT_EQ(metrics["signature.latency_bucket<2048"], 6u);
+    EXPECT_EQ(metrics["signature.latency_bucket<" + std::to_string(UINT64_MAX)], 7u);
+    EXPECT_EQ(metrics["payload_hash.calls"], 0u);
+    EXPECT_EQ(metrics["key_cache_misses"], 2u);
+    EXPECT_EQ(metrics.size(), aws_sigv4::kStageCount * (3 + aws_sigv4::SigningStats::kLatencyBuckets) + 2);
+
+    stats.reset();
+    stats.snapshot(snapshot);
+    EXPECT_EQ(snapshot.stages[aws_sigv4::kStageSignature].calls, 0u);
+    EXPECT_EQ(snapshot.key_cache_misses, 0u);
+}
+
+#ifdef AWSSIGV4_STATS
+
+TEST(SigningStats, signer_records_stages)
+{
+    aws_sigv4::SigningStats &stats = aws_sigv4::SigningStats::global();
+    stats.reset();
+    SignSome(10);
+
+    aws_sigv4::SigningStats::Snapshot snapshot;
+    stats.snapshot(snapshot);
+    EXPECT_EQ(snapshot.stages[aws_sigv4::kStageSignRequest].calls, 10u);
+    EXPECT_EQ(snapshot.stages[aws_sigv4::kStageSignRequest].bytes, 70u);
+    EXPECT_EQ(snapshot.stages[aws_sigv4::kStagePayloadHash].calls, 10u);
+    EXPECT_EQ(snapshot.stages[aws_sigv4::kStagePayloadHash].bytes, 70u);
+    EXPECT_EQ(snapshot.stages[aws_sigv4::kStageCanonicalize].calls, 10u);
+    EXPECT_EQ(snapshot.stages[aws_sigv4::kStageSignature].calls, 10u);
+
+    // The canonical request is hashed as it is written
+    std::string canonical_request =
+        "POST\n/\na=b\nhost:host.foo.com\nx-amz-date:20110909T233600Z\n\nhost;x-amz-date\n"
+        "239f59ed55e737c77147cf55ad0c1b030b6d7ee748a7426952f9b852d5a935e5";
+    EXPECT_EQ(snapshot.stages[aws_sigv4::kStageCanonicalRequestHash].bytes, 10 * canonical_request.length());
+
+    // One derivation, then the signer's own key
+    EXPECT_EQ(snapshot.stages[aws_sigv4::kStageKeyDerivation].calls, 1u);
+    EXPECT_EQ(snapshot.key_cache_misses, 1u);
+    EXPECT_EQ(snapshot.key_cache_hits, 9u);
+
+    uint64_t latencies = 0;
+    for (size_t i = 0; i < aws_sigv4::SigningStats::kLatencyBuckets; i++)
+        latencies += snapshot.stages[aws_sigv4::kStageSignRequest].latency[i];
+    EXPECT_EQ(latencies, 10u);
+    EXPECT_GE(snapshot.stages[aws_sigv4::kStageSignRequest].total_ns, snapshot.stages[aws_sigv4::kStageSignature].total_ns);
+}
+
+#else
+
+TEST(SigningStats, compiled_out)
+{
+    EXPECT_FALSE(aws_sigv4::SigningStats::enabled());
+
+    aws_sigv4::SigningStats &stats = aws_sigv4::SigningStats::global();
+    stats.reset();
+    SignSome(10);
+
+    aws_sigv4::SigningStats::Snapshot snapshot;
+    stats.snapshot(snapshot);
+    for (size_t stage = 0; stage < aws_sigv4::kStageCount; stage++)
+        EXPECT_EQ(snapshot.stages[stage].calls, 0u);
+    EXPECT_EQ(snapshot.key_cache_hits + snapshot.key_cache_misses, 0u);
+}
+
+#endif
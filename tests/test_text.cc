@@ -0,0 +1,169 @@
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+#include "awssigv4_text.h"
+
+// Every text kernel the CPU supports, against straightforward reference
+// implementations, over lengths that cover the block sizes and their tails
+
+static bool IsWhitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+static std::string ReferenceLowercase(const std::string &s)
+{
+    std::string out = s;
+    for (size_t i = 0; i < out.length(); i++)
+        if (out[i] >= 'A' && out[i] <= 'Z')
+            out[i] += 'a' - 'A';
+    return out;
+}
+
+static std::string ReferenceTrim(const std::string &s)
+{
+    size_t begin = 0, end = s.length();
+    while (begin < end && IsWhitespace(s[begin]))
+        begin++;
+    while (end > begin && IsWhitespace(s[end - 1]))
+        end--;
+    return s.substr(begin, end - begin);
+}
+
+static std::string ReferenceCollapse(const std::string &s)
+{
+    std::string out;
+    for (size_t i = 0; i < s.length(); i++)
+    {
+        if (!IsWhitespace(s[i]))
+            out += s[i];
+        else if (i == 0 || !IsWhitespace(s[i - 1]))
+            out += ' ';
+    }
+    return out;
+}
+
+// Deterministic mix of letters, whitespace and bytes outside ASCII
+static std::string MakeText(size_t length, uint32_t seed)
+{
+    static const char alphabet[] = "AZaz@[`{09 \t\n\v\f\r \x80\xc1\xff  Mm";
+    std::string text(length, ' ');
+    for (size_t i = 0; i < length; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        text[i] = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+    }
+    return text;
+}
+
+static std::vector<aws_sigv4::TextKernels::Kernel> SupportedKernels()
+{
+    const aws_sigv4::TextKernels::Kernel all[] = {
+        aws_sigv4::TextKernels::kScalar, aws_sigv4::TextKernels::kSse2,
+        aws_sigv4::TextKernels::kAvx2, aws_sigv4::TextKernels::kNeon
+    };
+    std::vector<aws_sigv4::TextKernels::Kernel> kernels;
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++)
+        if (aws_sigv4::TextKernels::supported(all[i]))
+            kernels.push_back(all[i]);
+    return kernels;
+}
+
+TEST(TextKernels, lowercase)
+{
+    std::vector<aws_sigv4::TextKernels::Kernel> kernels = SupportedKernels();
+    for (size_t k = 0; k < kernels.size(); k++)
+    {
+        aws_sigv4::TextKernels text(kernels[k]);
+        for (size_t length = 0; length < 100; length++)
+        {
+            std::string in = MakeText(length, length);
+            std::string out(length, '?');
+            text.lowercase(in.data(), length, &out[0]);
+            EXPECT_EQ(out, ReferenceLowercase(in)) << text.kernelName(text.kernel()) << " " << length;
+
+            // In place
+            text.lowercase(in.data(), length, &in[0]);
+            EXPECT_EQ(in, out);
+        }
+    }
+}
+
+TEST(TextKernels, trim)
+{
+    std::vector<aws_sigv4::TextKernels::Kernel> kernels = SupportedKernels();
+    for (size_t k = 0; k < kernels.size(); k++)
+    {
+        aws_sigv4::TextKernels text(kernels[k]);
+        for (size_t length = 0; length < 100; length++)
+        {
+            // Long whitespace runs at either end, and strings of nothing else
+            std::string core = MakeText(length % 7, length);
+            std::string in = std::string(length / 2, ' ') + core + std::string(length - length / 2, '\t');
+            EXPECT_EQ(std::string(text.trim(in)), ReferenceTrim(in)) << text.kernelName(text.kernel()) << " " << length;
+
+            in = MakeText(length, length * 31);
+            EXPECT_EQ(std::string(text.trim(in)), ReferenceTrim(in)) << text.kernelName(text.kernel()) << " " << length;
+        }
+    }
+}
+
+TEST(TextKernels, collapse_whitespace)
+{
+    std::vector<aws_sigv4::TextKernels::Kernel> kernels = SupportedKernels();
+    for (size_t k = 0; k < kernels.size(); k++)
+    {
+        aws_sigv4::TextKernels text(kernels[k]);
+        for (size_t length = 0; length < 120; length++)
+        {
+            std::string in = length % 3 ? MakeText(length, length) : std::string(length, 'x') + "  " + std::string(length, 'y');
+            std::string expected = ReferenceCollapse(in);
+
+            size_t clean = text.findCollapsible(in.data(), in.length());
+            EXPECT_EQ(clean == in.length(), expected == in) << text.kernelName(text.kernel()) << " " << length;
+            EXPECT_EQ(in.substr(0, clean), expected.substr(0, clean));
+
+            std::string out(in.length(), '?');
+            bool previous_space = false;
+            out.resize(text.collapseWhitespace(in.data(), in.length(), &out[0], previous_space));
+            EXPECT_EQ(out, expected) << text.kernelName(text.kernel()) << " " << length;
+
+            // The same value in uneven pieces
+            std::string pieces;
+            previous_space = false;
+            for (size_t offset = 0, piece = 1; offset < in.length(); offset += piece, piece = piece % 5 + 1)
+            {
+                size_t take = std::min(piece, in.length() - offset);
+                char buffer[8];
+                pieces.append(buffer, text.collapseWhitespace(in.data() + offset, take, buffer, previous_space));
+            }
+            EXPECT_EQ(pieces, expected) << text.kernelName(text.kernel()) << " " << length;
+        }
+    }
+}
+
+TEST(TextKernels, hex_encode)
+{
+    std::vector<aws_sigv4::TextKernels::Kernel> kernels = SupportedKernels();
+    for (size_t k = 0; k < kernels.size(); k++)
+    {
+        aws_sigv4::TextKernels text(kernels[k]);
+        for (size_t length = 0; length < 100; length++)
+        {
+            std::vector<unsigned char> in(length);
+            std::string expected;
+            for (size_t i = 0; i < length; i++)
+            {
+                in[i] = (unsigned char)(i * 37 + length);
+                char hex[3];
+                snprintf(hex, sizeof(hex), "%02x", in[i]);
+                expected += hex;
+            }
+
+            std::string out(2 * length, '?');
+            text.hexEncode(in.data(), length, &out[0]);
+            EXPECT_EQ(out, expected) << text.kernelName(text.kernel()) << " " << length;
+        }
+    }
+}
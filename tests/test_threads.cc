@@ -0,0 +1,199 @@
+#include "gtest/gtest.h"
+#include <atomic>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "awssigv4.h"
+#include "test_util.h"
+
+// One Signature shared by many threads, each checking its results against
+// the same requests signed on a single thread
+
+static const size_t kThreads = 8;
+static const size_t kIterations = 300;
+
+struct SharedRequest
+{
+    std::string method, canonical_uri, querystring, payload;
+    std::map<std::string, std::vector<std::string> > header_map;
+    std::vector<aws_sigv4::HeaderField> fields;
+    std::string expected;
+};
+
+static std::vector<SharedRequest> MakeRequests(const aws_sigv4::Signature &signature)
+{
+    std::vector<SharedRequest> requests(4);
+
+    requests[0].method = "GET";
+    requests[0].canonical_uri = "/";
+    requests[0].header_map["Date"].push_back("Mon, 09 Sep 2011 23:36:00 GMT");
+    requests[0].header_map["Host"].push_back("host.foo.com");
+
+    requests[1].method = "POST";
+    requests[1].canonical_uri = "/";
+    requests[1].querystring = "foo=bar&a=b";
+    requests[1].header_map["Date"].push_back("Mon, 09 Sep 2011 23:36:00 GMT");
+    requests[1].header_map["Host"].push_back("host.foo.com");
+    requests[1].header_map["ZOO"].push_back("zoobar");
+
+    requests[2].method = "POST";
+    requests[2].canonical_uri = "/";
+    requests[2].header_map["Content-Type"].push_back("application/x-www-form-urlencoded");
+    requests[2].header_map["Date"].push_back("Mon, 09 Sep 2011 23:36:00 GMT");
+    requests[2].header_map["Host"].push_back("host.foo.com");
+    requests[2].payload = "foo=bar";
+
+    requests[3].method = "PUT";
+    requests[3].canonical_uri = "/bucket/key";
+    requests[3].header_map["Host"].push_back("host.foo.com");
+    requests[3].header_map["X-Amz-Meta-Tag"].push_back("one");
+    requests[3].payload = std::string(3000, 'p');
+
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        SharedRequest &request = requests[i];
+        for (std::map<std::string, std::vector<std::string> >::const_iterator it = request.header_map.begin(); it != request.header_map.end(); it++)
+        {
+            aws_sigv4::HeaderField field = {it->first, it->second[0]};
+            request.fields.push_back(field);
+        }
+        request.expected = signature.signRequest(request.method, request.canonical_uri, request.querystring, request.header_map, request.payload);
+    }
+
+    return requests;
+}
+
+static void RunThreads(size_t thread_count, const std::function<void(size_t)> &body)
+{
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_count; t++)
+        threads.push_back(std::thread(body, t));
+    for (size_t t = 0; t < thread_count; t++)
+        threads[t].join();
+}
+
+TEST(Threads, shared_signer_matches_single_thread)
+{
+    aws_sigv4::Signature reference = TestSigner();
+    const std::vector<SharedRequest> requests = MakeRequests(reference);
+    EXPECT_EQ(requests[0].expected,
+              "AWS4-HMAC-SHA256 Credential=AKIDEXAMPLE/20110909/us-east-1/host/aws4_request, "
+              "SignedHeaders=date;host, Signature=b27ccfbfa7df52a200ff74193ca6e32d4b48b8856fab7ebf1c595d0670a7e470");
+
+    // A private cache, so the threads race to derive the key too
+    aws_sigv4::SigningKeyCache cache(4);
+    aws_sigv4::Signature shared_signature = TestSigner();
+    shared_signature.setKeyCache(&cache);
+    const aws_sigv4::Signature &signature = shared_signature;
+
+    std::atomic<size_t> mismatches(0);
+    RunThreads(kThreads, [&](size_t t) {
+        char out[512];
+        std::vector<aws_sigv4::SignRequest> batch(requests.size());
+        std::vector<std::string> batch_headers(requests.size());
+
+        for (size_t i = 0; i < kIterations; i++)
+        {
+            const SharedRequest &request = requests[(i + t) % requests.size()];
+            std::string header;
+
+            switch (i % 3)
+            {
+                case 0:
+                    header = signature.signRequest(request.method, request.canonical_uri, request.querystring, request.header_map, request.payload);
+                    break;
+                case 1:
+                    header.assign(out, signature.signRequest(request.method, request.canonical_uri, request.querystring,
+                                                             request.fields.data(), request.fields.size(), request.payload, out, sizeof(out)));
+                    break;
+                default:
+                    for (size_t r = 0; r < requests.size(); r++)
+                    {
+                        aws_sigv4::SignRequest sign_request = {requests[r].method, requests[r].canonical_uri, requests[r].querystring,
+                                                               requests[r].fields.data(), requests[r].fields.size(), requests[r].payload};
+                        batch[r] = sign_request;
+                    }
+                    signature.signBatch(batch.data(), batch.size(), batch_headers.data());
+                    for (size_t r = 0; r < requests.size(); r++)
+                        if (batch_headers[r] != requests[r].expected)
+                            mismatches++;
+                    continue;
+            }
+
+            if (header != request.expected)
+                mismatches++;
+        }
+    });
+
+    EXPECT_EQ(mismatches.load(), 0u);
+}
+
+TEST(Threads, signers_share_key_cache)
+{
+    // More scopes than the cache has slots, so stores from different
+    // threads keep evicting each other
+    const char *regions[] = {"us-east-1", "us-west-2", "eu-west-1", "ap-south-1", "sa-east-1", "ca-central-1"};
+    const size_t region_count = sizeof(regions) / sizeof(regions[0]);
+
+    std::vector<std::string> expected;
+    aws_sigv4::HeaderField headers[] = {{"Host", "host.foo.com"}};
+    for (size_t r = 0; r < region_count; r++)
+    {
+        aws_sigv4::Signature signature = TestSigner("host", "host.foo.com", regions[r]);
+        signature.setKeyCache(NULL);
+        char out[512];
+        expected.push_back(std::string(out, signature.signRequest("GET", "/", "", headers, 1, "", out, sizeof(out))));
+    }
+
+    aws_sigv4::SigningKeyCache cache(2);
+    std::atomic<size_t> mismatches(0);
+    RunThreads(kThreads, [&](size_t t) {
+        char out[512];
+        for (size_t i = 0; i < kIterations; i++)
+        {
+            size_t r = (i * 7 + t) % region_count;
+            aws_sigv4::Signature signature = TestSigner("host", "host.foo.com", regions[r]);
+            signature.setKeyCache(&cache);
+            if (std::string(out, signature.signRequest("GET", "/", "", headers, 1, "", out, sizeof(out))) != expected[r])
+                mismatches++;
+        }
+    });
+
+    EXPECT_EQ(mismatches.load(), 0u);
+}
+
+TEST(Threads, backend_switch_while_signing)
+{
+    aws_sigv4::Signature signature = TestSigner();
+    const std::vector<SharedRequest> requests = MakeRequests(signature);
+    const aws_sigv4::CryptoBackend &previous = aws_sigv4::CryptoBackend::active();
+
+    std::atomic<bool> done(false);
+    std::thread switcher([&]() {
+        for (size_t i = 0; !done.load(); i++)
+        {
+            const aws_sigv4::CryptoBackend *backend = aws_sigv4::CryptoBackend::available(i % 4);
+            aws_sigv4::CryptoBackend::setActive(backend != NULL ? *backend : previous);
+            std::this_thread::yield();
+        }
+    });
+
+    std::atomic<size_t> mismatches(0);
+    RunThreads(kThreads / 2, [&](size_t t) {
+        for (size_t i = 0; i < kIterations; i++)
+        {
+            const SharedRequest &request = requests[(i + t) % requests.size()];
+            if (signature.signRequest(request.method, request.canonical_uri, request.querystring, request.header_map, request.payload) != request.expected)
+                mismatches++;
+        }
+    });
+
+    done = true;
+    switcher.join();
+    aws_sigv4::CryptoBackend::setActive(previous);
+
+    EXPECT_EQ(mismatches.load(), 0u);
+}
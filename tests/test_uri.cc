@@ -0,0 +1,266 @@
+#include "gtest/gtest.h"
+#include <string>
+
+#include "awssigv4.h"
+#include "awssigv4_uri.h"
+
+static std::string Encode(const std::string &in, bool encode_slash=true)
+{
+    std::string out;
+    aws_sigv4::appendUriEncoded(out, in, encode_slash);
+    return out;
+}
+
+static std::string Decode(const std::string &in, bool plus_is_space=false)
+{
+    std::string out;
+    aws_sigv4::appendUriDecoded(out, in, plus_is_space);
+    return out;
+}
+
+static std::string CanonicalQuery(const std::string &query)
+{
+    aws_sigv4::CanonicalQueryBuilder builder;
+    builder.parse(query);
+    return builder.str();
+}
+
+TEST(UriEncoding, encode)
+{
+    EXPECT_EQ(Encode(""), "");
+    EXPECT_EQ(Encode("AZaz09-_.~"), "AZaz09-_.~");
+    EXPECT_EQ(Encode("a b+c=d&e"), "a%20b%2Bc%3Dd%26e");
+    EXPECT_EQ(Encode("photos/2011 09/a.jpg"), "photos%2F2011%2009%2Fa.jpg");
+    EXPECT_EQ(Encode("photos/2011 09/a.jpg", false), "photos/2011%2009/a.jpg");
+    EXPECT_EQ(Encode("\xe1\x88\xb4"), "%E1%88%B4");
+    EXPECT_EQ(Encode(std::string("\0\x7f\xff", 3)), "%00%7F%FF");
+
+    // Every byte value, against the per-character definition
+    for (int c = 0; c < 256; c++)
+    {
+        std::string in(1, (char)c);
+        bool unreserved = isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~';
+        char escape[4];
+        snprintf(escape, sizeof(escape), "%%%02X", c);
+        EXPECT_EQ(Encode(in), unreserved ? in : std::string(escape)) << c;
+    }
+}
+
+TEST(UriEncoding, decode)
+{
+    EXPECT_EQ(Decode("a%20b%2Bc"), "a b+c");
+    EXPECT_EQ(Decode("%e1%88%B4"), "\xe1\x88\xb4");
+    EXPECT_EQ(Decode("a+b"), "a+b");
+    EXPECT_EQ(Decode("a+b", true), "a b");
+
+    // Malformed escapes are kept
+    EXPECT_EQ(Decode("100%"), "100%");
+    EXPECT_EQ(Decode("%4"), "%4");
+    EXPECT_EQ(Decode("%zz%41"), "%zzA");
+}
+
+TEST(UriEncoding, is_encoded)
+{
+    EXPECT_TRUE(aws_sigv4::isUriEncoded(""));
+    EXPECT_TRUE(aws_sigv4::isUriEncoded("abc-_.~"));
+    EXPECT_TRUE(aws_sigv4::isUriEncoded("a%20b%2F"));
+    EXPECT_FALSE(aws_sigv4::isUriEncoded("a%2f"));
+    EXPECT_FALSE(aws_sigv4::isUriEncoded("a b"));
+    EXPECT_FALSE(aws_sigv4::isUriEncoded("a+b"));
+    EXPECT_FALSE(aws_sigv4::isUriEncoded("a%2"));
+    EXPECT_FALSE(aws_sigv4::isUriEncoded("a/b"));
+    EXPECT_FALSE(aws_sigv4::isUriEncoded("%41"));
+}
+
+TEST(CanonicalQueryBuilder, sorts_and_encodes)
+{
+    EXPECT_EQ(CanonicalQuery(""), "");
+    EXPECT_EQ(CanonicalQuery("foo=Zoo&foo=aha"), "foo=Zoo&foo=aha");
+    EXPECT_EQ(CanonicalQuery("b=1&a=2&&a=1"), "a=1&a=2&b=1");
+    EXPECT_EQ(CanonicalQuery("foo"), "foo=");
+    EXPECT_EQ(CanonicalQuery("prefix=photos/&delimiter=/"), "delimiter=%2F&prefix=photos%2F");
+    EXPECT_EQ(CanonicalQuery("a=b=c"), "a=b%3Dc");
+
+    // Escapes are normalised, never encoded twice
+    EXPECT_EQ(CanonicalQuery("key=a%2fb%20c"), "key=a%2Fb%20c");
+    EXPECT_EQ(CanonicalQuery("key=a%2Fb%20c"), "key=a%2Fb%20c");
+    EXPECT_EQ(CanonicalQuery("key=100%"), "key=100%25");
+    EXPECT_EQ(CanonicalQuery("%41=%7E"), "A=~");
+
+    // Sorted by encoded name: '%' sorts before letters
+    EXPECT_EQ(CanonicalQuery("z=1&\xe1\x88\xb4=bar&A=2"), "%E1%88%B4=bar&A=2&z=1");
+}
+
+TEST(CanonicalQueryBuilder, form_urlencoded_body)
+{
+    EXPECT_EQ(CanonicalQuery("Action=SendMessage&MessageBody=hello+world%21&Version=2012-11-05"),
+        "Action=SendMessage&MessageBody=hello%20world%21&Version=2012-11-05");
+    EXPECT_EQ(CanonicalQuery("q=1%2B1+%3D+2"), "q=1%2B1%20%3D%202");
+}
+
+TEST(CanonicalQueryBuilder, add_raw_parameters)
+{
+    aws_sigv4::CanonicalQueryBuilder builder;
+    builder.add("prefix", "photos/2011 09/");
+    builder.add("a b", "+");
+    builder.add("max-keys", "");
+    EXPECT_EQ(builder.size(), 3u);
+    EXPECT_EQ(builder.str(), "a%20b=%2B&max-keys=&prefix=photos%2F2011%2009%2F");
+
+    // The same parameters parsed from their encoded form
+    aws_sigv4::CanonicalQueryBuilder parsed;
+    parsed.parse(builder.str());
+    EXPECT_EQ(parsed.str(), builder.str());
+
+    builder.clear();
+    EXPECT_EQ(builder.size(), 0u);
+    builder.add("x", "1");
+    EXPECT_EQ(builder.str(), "x=1");
+}
+
+TEST(CanonicalQueryBuilder, many_parameters)
+{
+    std::string query, expected;
+    for (int i = 999; i >= 0; i--)
+    {
+        char pair[32];
+        snprintf(pair, sizeof(pair), "%sp%04d=v %d", i == 999 ? "" : "&", i, i);
+        query += pair;
+    }
+    for (int i = 0; i < 1000; i++)
+    {
+        char pair[32];
+        snprintf(pair, sizeof(pair), "%sp%04d=v%%20%d", i == 0 ? "" : "&", i, i);
+        expected += pair;
+    }
+    EXPECT_EQ(CanonicalQuery(query), expected);
+}
+
+TEST(signRequest, encodes_query_string)
+{
+    aws_sigv4::Signature signature("host", "host.foo.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", 1315611360);
+    aws_sigv4::HeaderField headers[] = {{"Host", "host.foo.com"}};
+    char raw[512], encoded[512];
+
+    // A query that needs encoding signs the same as its canonical form,
+    // through the view API and the string one
+    std::string raw_query = "prefix=photos/2011 09/&a=b=c";
+    std::string canonical_query = CanonicalQuery(raw_query);
+    EXPECT_EQ(canonical_query, "a=b%3Dc&prefix=photos%2F2011%2009%2F");
+
+    size_t raw_length = signature.signRequest("GET", "/", raw_query, headers, 1, "", raw, sizeof(raw));
+    size_t encoded_length = signature.signRequest("GET", "/", canonical_query, headers, 1, "", encoded, sizeof(encoded));
+    ASSERT_GT(raw_length, 0u);
+    EXPECT_EQ(std::string(raw, raw_length), std::string(encoded, encoded_length));
+
+    std::map<std::string, std::vector<std::string> > header_map;
+    header_map["Host"].push_back("host.foo.com");
+    EXPECT_EQ(signature.signRequest("GET", "/", raw_query, header_map, ""), std::string(encoded, encoded_length));
+}
+
+static std::string CanonicalUri(const std::string &path, aws_sigv4::UriNormalization mode)
+{
+    std::string out(aws_sigv4::maxCanonicalUriLength(path.length(), mode), '?');
+    out.resize(aws_sigv4::canonicalizeUri(path, mode, &out[0]));
+
+    // Exactly the paths that come out unchanged are reported canonical
+    EXPECT_EQ(aws_sigv4::isCanonicalUri(path, mode), out == path) << path;
+    return out;
+}
+
+TEST(CanonicalUri, normalize)
+{
+    const aws_sigv4::UriNormalization mode = aws_sigv4::kUriNormalize;
+    EXPECT_EQ(CanonicalUri("", mode), "/");
+    EXPECT_EQ(CanonicalUri("/", mode), "/");
+    EXPECT_EQ(CanonicalUri("foo", mode), "/foo");
+    EXPECT_EQ(CanonicalUri("/foo/..", mode), "/");
+    EXPECT_EQ(CanonicalUri("/foo/bar/../..", mode), "/");
+    EXPECT_EQ(CanonicalUri("/foo/bar/../baz", mode), "/foo/baz");
+    EXPECT_EQ(CanonicalUri("/../../foo", mode), "/foo");
+    EXPECT_EQ(CanonicalUri("//", mode), "/");
+    EXPECT_EQ(CanonicalUri("/./", mode), "/");
+    EXPECT_EQ(CanonicalUri("/./foo", mode), "/foo");
+    EXPECT_EQ(CanonicalUri("/foo/.", mode), "/foo/");
+    EXPECT_EQ(CanonicalUri("//foo//", mode), "/foo/");
+    EXPECT_EQ(CanonicalUri("/a//b///c/", mode), "/a/b/c/");
+    EXPECT_EQ(CanonicalUri("/.../..a/a..", mode), "/.../..a/a..");
+
+    // Each segment encoded once, whether or not it was already
+    EXPECT_EQ(CanonicalUri("/%20/foo", mode), "/%20/foo");
+    EXPECT_EQ(CanonicalUri("/ /foo", mode), "/%20/foo");
+    EXPECT_EQ(CanonicalUri("/%e1%88%b4", mode), "/%E1%88%B4");
+    EXPECT_EQ(CanonicalUri("/\xe1\x88\xb4", mode), "/%E1%88%B4");
+    EXPECT_EQ(CanonicalUri("/a%2Fb/c", mode), "/a%2Fb/c");
+    EXPECT_EQ(CanonicalUri("/%41%7e", mode), "/A~");
+    EXPECT_EQ(CanonicalUri("/%41", mode), "/A");
+    EXPECT_EQ(CanonicalUri("/100%/a+b", mode), "/100%25/a%2Bb");
+}
+
+TEST(CanonicalUri, encode_once_keeps_object_keys)
+{
+    // S3 signs the key as it is: dots and empty segments are part of it
+    const aws_sigv4::UriNormalization mode = aws_sigv4::kUriEncodeOnce;
+    EXPECT_EQ(CanonicalUri("", mode), "/");
+    EXPECT_EQ(CanonicalUri("/bucket/a/../b//c/./d", mode), "/bucket/a/../b//c/./d");
+    EXPECT_EQ(CanonicalUri("/bucket/photos/2011 09/a+b.jpg", mode), "/bucket/photos/2011%2009/a%2Bb.jpg");
+    EXPECT_EQ(CanonicalUri("/bucket/photos/2011%2009/a%2Bb.jpg", mode), "/bucket/photos/2011%2009/a%2Bb.jpg");
+    EXPECT_EQ(CanonicalUri("/bucket/%e1%88%b4", mode), "/bucket/%E1%88%B4");
+}
+
+TEST(CanonicalUri, double_encode)
+{
+    const aws_sigv4::UriNormalization mode = aws_sigv4::kUriNormalizeDoubleEncode;
+    EXPECT_EQ(CanonicalUri("/foo/bar", mode), "/foo/bar");
+    EXPECT_EQ(CanonicalUri("/a b/../c d", mode), "/c%2520d");
+    EXPECT_EQ(CanonicalUri("/c%20d", mode), "/c%2520d");
+    EXPECT_EQ(CanonicalUri("/%E1%88%B4", mode), "/%25E1%2588%25B4");
+}
+
+TEST(CanonicalUri, unchanged)
+{
+    EXPECT_EQ(CanonicalUri("/a//b/../c d", aws_sigv4::kUriUnchanged), "/a//b/../c d");
+    EXPECT_EQ(CanonicalUri("", aws_sigv4::kUriUnchanged), "");
+}
+
+TEST(CanonicalUri, deep_object_keys)
+{
+    std::string key = "/bucket", normalized = "/bucket";
+    for (int i = 0; i < 200; i++)
+    {
+        key += "/dir " + std::to_string(i) + "//./x/..";
+        normalized += "/dir%20" + std::to_string(i);
+    }
+    EXPECT_EQ(CanonicalUri(key, aws_sigv4::kUriNormalize), normalized + "/");
+
+    std::string appended = "prefix";
+    aws_sigv4::appendCanonicalUri(appended, key, aws_sigv4::kUriNormalize);
+    EXPECT_EQ(appended, "prefix" + normalized + "/");
+}
+
+TEST(CanonicalUri, per_service)
+{
+    EXPECT_EQ(aws_sigv4::uriNormalizationFor("s3"), aws_sigv4::kUriEncodeOnce);
+    EXPECT_EQ(aws_sigv4::uriNormalizationFor("host"), aws_sigv4::kUriNormalize);
+    EXPECT_EQ(aws_sigv4::uriNormalizationFor("dynamodb"), aws_sigv4::kUriNormalize);
+
+    aws_sigv4::Signature s3("s3", "examplebucket.s3.amazonaws.com", "us-east-1", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "AKIDEXAMPLE", 1315611360);
+    EXPECT_EQ(s3.uriNormalization(), aws_sigv4::kUriEncodeOnce);
+
+    std::map<std::string, std::vector<std::string> > header_map;
+    header_map["Host"].push_back("examplebucket.s3.amazonaws.com");
+    std::string canonical_request = s3.createCanonicalRequest("GET", "/a/./b c", "", header_map, "");
+    EXPECT_EQ(canonical_request.substr(0, canonical_request.find('\n', 4)), "GET\n/a/./b%20c");
+
+    s3.setUriNormalization(aws_sigv4::kUriNormalize);
+    canonical_request = s3.createCanonicalRequest("GET", "/a/./b c", "", header_map, "");
+    EXPECT_EQ(canonical_request.substr(0, canonical_request.find('\n', 4)), "GET\n/a/b%20c");
+
+    // The view API canonicalises the same way
+    aws_sigv4::HeaderField headers[] = {{"Host", "examplebucket.s3.amazonaws.com"}};
+    char raw[512], canonical[512];
+    size_t raw_length = s3.signRequest("GET", "/a/./b c", "", headers, 1, "", raw, sizeof(raw));
+    size_t canonical_length = s3.signRequest("GET", "/a/b%20c", "", headers, 1, "", canonical, sizeof(canonical));
+    EXPECT_EQ(std::string(raw, raw_length), std::string(canonical, canonical_length));
+    EXPECT_EQ(s3.signRequest("GET", "/a/./b c", "", header_map, ""), std::string(canonical, canonical_length));
+}
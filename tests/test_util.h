@@ -0,0 +1,52 @@
+// Credentials, signers and requests shared by the test files, after the
+// AWS Signature Version 4 test suite
+
+#ifndef AWSSIGV4_TEST_UTIL_H
+#define AWSSIGV4_TEST_UTIL_H
+
+#include <string>
+
+#include "awssigv4.h"
+
+static const time_t kTestSuiteTime = 1315611360; // 20110909T233600Z
+static const char kTestAccessKey[] = "AKIDEXAMPLE";
+static const char kTestSecretKey[] = "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY";
+
+// Signer with the test suite credentials, fixed at kTestSuiteTime
+inline aws_sigv4::Signature TestSigner(const std::string &service="host", const std::string &host="host.foo.com", const std::string &region="us-east-1")
+{
+    return aws_sigv4::Signature(service, host, region, kTestSecretKey, kTestAccessKey, kTestSuiteTime);
+}
+
+inline aws_sigv4::Signature S3Signer()
+{
+    return TestSigner("s3", "examplebucket.s3.amazonaws.com");
+}
+
+inline aws_sigv4::Signature DynamoSigner()
+{
+    return TestSigner("dynamodb", "dynamodb.us-east-1.amazonaws.com");
+}
+
+// An S3 PUT of payload to examplebucket at kTestSuiteTime
+inline const aws_sigv4::HeaderField kPutHeaders[] = {
+    {"Host", "examplebucket.s3.amazonaws.com"},
+    {"x-amz-date", "20110909T233600Z"},
+};
+
+inline aws_sigv4::SignRequest PutRequest(std::string_view payload)
+{
+    aws_sigv4::SignRequest request = {"PUT", "/photos/large.bin", "", kPutHeaders, 2, payload};
+    return request;
+}
+
+// Signature::signRequest of request at time, or an empty string if it is
+// rejected
+inline std::string SignInline(const aws_sigv4::Signature &signature, const aws_sigv4::RequestTime &time, const aws_sigv4::SignRequest &request)
+{
+    char out[4096];
+    size_t length = signature.signRequest(time, request.method, request.canonical_uri, request.querystring, request.headers, request.header_count, request.payload, out, sizeof(out));
+    return std::string(out, length);
+}
+
+#endif